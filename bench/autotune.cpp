@@ -0,0 +1,56 @@
+// Empirically tunes tile sizes, loop order and unrolling of one of the sample
+// kernels and reports the fastest schedule against the untiled kernel.
+//
+//   autotune [add|transpose|matmul] [size]
+//
+// `size` sets every size parameter (N, M, K); it defaults to the full
+// 1024 x 1024 tensors, or 256 for matmul to keep the search short. The
+// compiler is taken from $CXX (default c++).
+
+#include "Autotuner.hpp"
+#include "IRBuilder.hpp"
+#include "IRContext.hpp"
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <string>
+
+int main(int argc, char **argv) {
+  const std::map<std::string, std::string> programs = {
+      {"add", "LOOPS: i=0:N:1, j=0:M:1\nBODY: C[i, j] = C[i, j] + A[i, j]"},
+      {"transpose", "LOOPS: i=0:N:1, j=0:M:1\nBODY: C[i, j] = A[j, i]"},
+      {"matmul", "LOOPS: i=0:N:1, j=0:M:1, k=0:K:1\n"
+                 "BODY: C[i, j] = C[i, j] + (A[i, k] * B[k, j])"},
+  };
+
+  const std::string kernel = argc > 1 ? argv[1] : "transpose";
+  auto program = programs.find(kernel);
+  if (program == programs.end()) {
+    std::cerr << "usage: " << argv[0] << " [add|transpose|matmul] [size]\n";
+    return 1;
+  }
+  const int64_t size =
+      argc > 2 ? std::atoll(argv[2]) : (kernel == "matmul" ? 256 : 1024);
+
+  try {
+    IRContext ctx(/*hash_consing=*/true);
+    IRNode *untiled = buildUntiledIR(ctx, program->second);
+
+    TunerOptions options;
+    options.params_ = {{"N", size}, {"M", size}, {"K", size}};
+    Autotuner tuner(ctx, untiled, options);
+
+    std::cout << "Tuning " << kernel << " at size " << size << "...\n";
+    AutotuneReport report = tuner.tune();
+    report.print(std::cout);
+
+    if (const Measurement *best = report.best()) {
+      std::cout << "\nBest schedule:\n";
+      printIR(ctx, tuner.apply(best->schedule_));
+    }
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,312 @@
+// Compares building and tiling IR trees in an arena-backed IRContext against
+// the previous layout, where every node was an individual unique_ptr
+// allocation. Both sides build the same 2D add nest and tile it with the same
+// fixed tile size, so only the allocation path is timed: no cache model and
+// no dependence analysis. The boxed side deep-copies the nest like the
+// original tilingPass, while the arena side shares the untouched body. A
+// third run enables hash-consing to show how much of each tree is shared, and
+// a last run measures the memory cost of trying many tiling candidates with
+// checkpoint/rollback.
+
+#include "IR.hpp"
+#include "IRBuilder.hpp"
+#include "IRContext.hpp"
+#include "TilingPass.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Tile size of both sides.
+constexpr int64_t kTileSize = 73;
+
+namespace boxed {
+
+// --- Replica of the unique_ptr-owned IR, kept only for comparison ---
+
+class Node {
+public:
+  virtual ~Node() = default;
+  virtual IRNodeType getType() const = 0;
+};
+
+using NodePtr = std::unique_ptr<Node>;
+
+class Const : public Node {
+public:
+  Const(ConstValue val, DType type) : value_(val), dtype_(type) {}
+  IRNodeType getType() const override { return IRNodeType::Const; }
+  ConstValue value_;
+  DType dtype_;
+};
+
+class Variable : public Node {
+public:
+  Variable(std::string name) : name_(std::move(name)) {}
+  IRNodeType getType() const override { return IRNodeType::Variable; }
+  std::string name_;
+};
+
+template <IRNodeType Kind> class Binary : public Node {
+public:
+  Binary(NodePtr one, NodePtr two)
+      : operand_one_(std::move(one)), operand_two_(std::move(two)) {}
+  IRNodeType getType() const override { return Kind; }
+  NodePtr operand_one_;
+  NodePtr operand_two_;
+};
+
+using Add = Binary<IRNodeType::Add>;
+using Min = Binary<IRNodeType::Min>;
+
+template <IRNodeType Kind> class Access : public Node {
+public:
+  Access(Tensor &t, std::vector<NodePtr> indices)
+      : tensor_(t), indices_(std::move(indices)) {}
+  IRNodeType getType() const override { return Kind; }
+  Tensor &tensor_;
+  std::vector<NodePtr> indices_;
+};
+
+using Load = Access<IRNodeType::Load>;
+using Store = Access<IRNodeType::Store>;
+
+class Assign : public Node {
+public:
+  Assign(NodePtr target, NodePtr value)
+      : target_(std::move(target)), value_(std::move(value)) {}
+  IRNodeType getType() const override { return IRNodeType::Assign; }
+  NodePtr target_;
+  NodePtr value_;
+};
+
+class Loop : public Node {
+public:
+  Loop(std::string i, NodePtr lb, NodePtr ub, NodePtr step)
+      : index_(std::move(i)), lower_bound_(std::move(lb)),
+        upper_bound_(std::move(ub)), step_(std::move(step)) {}
+  IRNodeType getType() const override { return IRNodeType::Loop; }
+  std::string index_;
+  NodePtr lower_bound_;
+  NodePtr upper_bound_;
+  NodePtr step_;
+  std::vector<NodePtr> body_;
+};
+
+NodePtr deepCopy(const Node *nd);
+
+std::vector<NodePtr> deepCopyVector(const std::vector<NodePtr> &nodes) {
+  std::vector<NodePtr> out;
+  out.reserve(nodes.size());
+  for (const auto &n : nodes) {
+    out.push_back(deepCopy(n.get()));
+  }
+  return out;
+}
+
+NodePtr deepCopy(const Node *nd) {
+  switch (nd->getType()) {
+  case IRNodeType::Const: {
+    auto *c = static_cast<const Const *>(nd);
+    return std::make_unique<Const>(c->value_, c->dtype_);
+  }
+  case IRNodeType::Variable:
+    return std::make_unique<Variable>(
+        static_cast<const Variable *>(nd)->name_);
+  case IRNodeType::Add: {
+    auto *a = static_cast<const Add *>(nd);
+    return std::make_unique<Add>(deepCopy(a->operand_one_.get()),
+                                 deepCopy(a->operand_two_.get()));
+  }
+  case IRNodeType::Min: {
+    auto *m = static_cast<const Min *>(nd);
+    return std::make_unique<Min>(deepCopy(m->operand_one_.get()),
+                                 deepCopy(m->operand_two_.get()));
+  }
+  case IRNodeType::Load: {
+    auto *l = static_cast<const Load *>(nd);
+    return std::make_unique<Load>(l->tensor_, deepCopyVector(l->indices_));
+  }
+  case IRNodeType::Store: {
+    auto *s = static_cast<const Store *>(nd);
+    return std::make_unique<Store>(s->tensor_, deepCopyVector(s->indices_));
+  }
+  case IRNodeType::Assign: {
+    auto *a = static_cast<const Assign *>(nd);
+    return std::make_unique<Assign>(deepCopy(a->target_.get()),
+                                    deepCopy(a->value_.get()));
+  }
+  case IRNodeType::Loop: {
+    auto *l = static_cast<const Loop *>(nd);
+    auto loop = std::make_unique<Loop>(
+        l->index_, deepCopy(l->lower_bound_.get()),
+        deepCopy(l->upper_bound_.get()), deepCopy(l->step_.get()));
+    loop->body_ = deepCopyVector(l->body_);
+    return loop;
+  }
+  default:
+    return nullptr;
+  }
+}
+
+std::vector<NodePtr> indices(const char *a, const char *b) {
+  std::vector<NodePtr> idx;
+  idx.push_back(std::make_unique<Variable>(a));
+  idx.push_back(std::make_unique<Variable>(b));
+  return idx;
+}
+
+NodePtr buildAddNest() {
+  auto value = std::make_unique<Add>(
+      std::make_unique<Load>(TensorC, indices("i", "j")),
+      std::make_unique<Load>(TensorA, indices("i", "j")));
+  auto assign = std::make_unique<Assign>(
+      std::make_unique<Store>(TensorC, indices("i", "j")), std::move(value));
+  auto loop_j = std::make_unique<Loop>(
+      "j", std::make_unique<Const>(0, DType::Int32),
+      std::make_unique<Variable>("M"),
+      std::make_unique<Const>(1, DType::Int32));
+  loop_j->body_.push_back(std::move(assign));
+  auto loop_i = std::make_unique<Loop>(
+      "i", std::make_unique<Const>(0, DType::Int32),
+      std::make_unique<Variable>("N"),
+      std::make_unique<Const>(1, DType::Int32));
+  loop_i->body_.push_back(std::move(loop_j));
+  return loop_i;
+}
+
+// Same node-for-node allocation pattern as the original tilingPass.
+NodePtr tilingPass(Node *nd) {
+  Loop *og_i = static_cast<Loop *>(nd);
+  Loop *og_j = static_cast<Loop *>(og_i->body_.front().get());
+  NodePtr cpy = deepCopy(nd);
+  Loop *loop_i = static_cast<Loop *>(cpy.get());
+  Loop *loop_j = static_cast<Loop *>(loop_i->body_.front().get());
+
+  NodePtr var_ii = std::make_unique<Variable>("ii");
+  NodePtr var_jj = std::make_unique<Variable>("jj");
+  NodePtr t = std::make_unique<Const>(kTileSize, DType::Int32);
+
+  loop_i->upper_bound_ = std::make_unique<Min>(
+      std::make_unique<Add>(deepCopy(var_ii.get()), deepCopy(t.get())),
+      deepCopy(og_i->upper_bound_.get()));
+  loop_j->upper_bound_ = std::make_unique<Min>(
+      std::make_unique<Add>(deepCopy(var_jj.get()), deepCopy(t.get())),
+      deepCopy(og_j->upper_bound_.get()));
+  loop_i->lower_bound_ = deepCopy(var_ii.get());
+  loop_j->lower_bound_ = deepCopy(var_jj.get());
+
+  auto loop_jj = std::make_unique<Loop>(
+      "jj", deepCopy(og_j->lower_bound_.get()),
+      deepCopy(og_j->upper_bound_.get()), deepCopy(t.get()));
+  auto loop_ii = std::make_unique<Loop>(
+      "ii", deepCopy(og_i->lower_bound_.get()),
+      deepCopy(og_i->upper_bound_.get()), deepCopy(t.get()));
+  loop_jj->body_.push_back(std::move(cpy));
+  loop_ii->body_.push_back(std::move(loop_jj));
+  return loop_ii;
+}
+
+} // namespace boxed
+
+// --- Arena-backed equivalent ---
+
+std::vector<IRNode *> indices(IRContext &ctx, const char *a, const char *b) {
+  return {ctx.makeVariable(a), ctx.makeVariable(b)};
+}
+
+IRNode *buildAddNest(IRContext &ctx) {
+  IRNode *value =
+      ctx.create<Add>(ctx.create<Load>(TensorC, indices(ctx, "i", "j")),
+                      ctx.create<Load>(TensorA, indices(ctx, "i", "j")));
+  IRNode *assign = ctx.create<Assign>(
+      ctx.create<Store>(TensorC, indices(ctx, "i", "j")), value);
+  Loop *loop_j = ctx.create<Loop>(
+      ctx.symbols().intern("j"), ctx.makeConst(0, DType::Int32),
+      ctx.makeVariable("M"), ctx.makeConst(1, DType::Int32));
+  loop_j->body_.push_back(assign);
+  Loop *loop_i = ctx.create<Loop>(
+      ctx.symbols().intern("i"), ctx.makeConst(0, DType::Int32),
+      ctx.makeVariable("N"), ctx.makeConst(1, DType::Int32));
+  loop_i->body_.push_back(loop_j);
+  return loop_i;
+}
+
+template <typename Fn> double timeNs(Fn &&fn) {
+  auto start = std::chrono::steady_clock::now();
+  fn();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+int main(int argc, char **argv) {
+  const int kernels = argc > 1 ? std::atoi(argv[1]) : 200000;
+  // Number of kernels that share one context before it is released.
+  const int batch = 1000;
+
+  size_t sink = 0;
+
+  double boxed_ns = timeNs([&] {
+    std::vector<boxed::NodePtr> live;
+    live.reserve(batch);
+    for (int k = 0; k < kernels; ++k) {
+      boxed::NodePtr root = boxed::buildAddNest();
+      live.push_back(boxed::tilingPass(root.get()));
+      if (live.size() == static_cast<size_t>(batch)) {
+        sink += live.size();
+        live.clear();
+      }
+    }
+  });
+
+  auto run_arena = [&](bool hash_consing, double &nodes_per_kernel) {
+    return timeNs([&] {
+      IRContext ctx(hash_consing);
+      for (int k = 0; k < kernels; ++k) {
+        IRNode *root = buildAddNest(ctx);
+        tileBand(ctx, root, {kTileSize, kTileSize});
+        if ((k + 1) % batch == 0) {
+          nodes_per_kernel = static_cast<double>(ctx.numNodes()) / batch;
+          sink += ctx.numNodes();
+          ctx.release();
+        }
+      }
+    });
+  };
+
+  double nodes_per_kernel = 0;
+  double consed_nodes_per_kernel = 0;
+  double arena_ns = run_arena(false, nodes_per_kernel);
+  double consed_ns = run_arena(true, consed_nodes_per_kernel);
+
+  std::cout << "kernels built+tiled : " << kernels << " (released every "
+            << batch << ")\n";
+  std::cout << "unique_ptr trees    : " << boxed_ns / kernels << " ns/kernel\n";
+  std::cout << "IRContext arena     : " << arena_ns / kernels << " ns/kernel, "
+            << nodes_per_kernel << " nodes/kernel\n";
+  std::cout << "  + hash-consing    : " << consed_ns / kernels << " ns/kernel, "
+            << consed_nodes_per_kernel << " nodes/kernel\n";
+  std::cout << "speedup             : " << boxed_ns / arena_ns << "x\n";
+
+  // Tuning-style exploration: each candidate is discarded after evaluation.
+  IRContext ctx;
+  IRNode *root = buildAddNest(ctx);
+  size_t base_bytes = ctx.bytesUsed();
+  size_t peak_bytes = base_bytes;
+  double candidate_ns = timeNs([&] {
+    for (int k = 0; k < kernels; ++k) {
+      IRContext::Checkpoint cp = ctx.checkpoint();
+      tileBand(ctx, root, {kTileSize, kTileSize});
+      peak_bytes = std::max(peak_bytes, ctx.bytesUsed());
+      ctx.rollback(cp);
+    }
+  });
+  std::cout << "candidates+rollback : " << candidate_ns / kernels
+            << " ns/candidate, " << peak_bytes - base_bytes
+            << " bytes/candidate, " << ctx.bytesUsed() - base_bytes
+            << " bytes retained\n";
+  return sink == 0;
+}
@@ -0,0 +1,198 @@
+// Round-trips the sample kernels through the binary IR file format: each one
+// is built, scheduled, flattened and written to one file, which is then
+// mmapped and every kernel unflattened into a fresh context. A kernel passes
+// if its structural hash, its deep structure and its generated code all match
+// the original. Also times rebuilding each kernel against reloading it, and
+// checks that a kernel is refused once a tensor's layout has changed.
+//
+//   ir_file_bench [path] [repeats]
+//
+// The kernels cover the default, recursive and Hilbert-ordered tilings, a
+// kernel over padded and blocked tensors, and a packed matmul whose local
+// buffers have to be recreated on load. Exits with 1 if any kernel differs.
+
+#include "CodeGenerator.hpp"
+#include "FlatIR.hpp"
+#include "IR.hpp"
+#include "IRBuilder.hpp"
+#include "IRContext.hpp"
+#include "IRFile.hpp"
+#include "OperandPacking.hpp"
+#include "PassManager.hpp"
+#include "RegisterBlocking.hpp"
+#include "ScalarReplacement.hpp"
+#include "StructuralHash.hpp"
+#include "TilingPass.hpp"
+#include "TypeInference.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Tensors with non-default layouts: P pads every row to 1040 elements, Q is
+// stored as 32x32 blocks.
+Tensor TensorP("P", DType::Float32, 2, {1024, 1024},
+               TensorLayout::rowMajor({1024, 1024}, 1040, 64));
+Tensor TensorQ("Q", DType::Float32, 2, {1024, 1024},
+               TensorLayout::blocked({1024, 1024}, {32, 32}, 64));
+
+const char *kAddProgram =
+    "LOOPS: i=0:N:1, j=0:M:1\nBODY: C[i, j] = C[i, j] + A[i, j]";
+const char *kTransposeProgram =
+    "LOOPS: i=0:N:1, j=0:M:1\nBODY: C[i, j] = A[j, i]";
+const char *kLayoutProgram =
+    "LOOPS: i=0:N:1, j=0:M:1\nBODY: C[i, j] = P[i, j] + Q[j, i]";
+const char *kMatmulProgram = "LOOPS: i=0:N:1, j=0:M:1, k=0:K:1\n"
+                             "BODY: C[i, j] = C[i, j] + (A[i, k] * B[k, j])";
+
+// One sample kernel: how to build and schedule it in a context.
+struct Sample {
+  const char *name;
+  std::function<IRNode *(IRContext &)> build;
+};
+
+std::vector<Sample> samples() {
+  return {
+      {"add", [](IRContext &ctx) {
+         return tilingPass(ctx, buildUntiledIR(ctx, kAddProgram));
+       }},
+      {"transpose-recursive", [](IRContext &ctx) {
+         return tilingPass(ctx, buildUntiledIR(ctx, kTransposeProgram),
+                           TilingMode::Recursive);
+       }},
+      {"add-hilbert", [](IRContext &ctx) {
+         return tilingPass(ctx, buildUntiledIR(ctx, kAddProgram),
+                           TilingMode::Fixed, CurveOrder::Hilbert);
+       }},
+      {"padded-blocked", [](IRContext &ctx) {
+         return tilingPass(ctx, buildUntiledIR(ctx, kLayoutProgram));
+       }},
+      {"matmul-packed", [](IRContext &ctx) {
+         // Same pipeline as the matmul sample in main.cpp.
+         PassManager pm(ctx);
+         pm.add<LoopTilingPass>(std::vector<int64_t>{32, 32, 32});
+         pm.add<OperandPackingPass>(4, 4);
+         pm.add<FullTileSplitPass>();
+         pm.add<RegisterBlockingPass>(4, 4);
+         pm.add<ScalarReplacementPass>();
+         pm.add<TypeInferencePass>();
+         return pm.run(buildUntiledIR(ctx, kMatmulProgram));
+       }},
+  };
+}
+
+std::string kernelCode(const IRContext &ctx, const IRNode *root) {
+  std::ostringstream os;
+  generateKernel(ctx, root, "kernel", os);
+  return os.str();
+}
+
+template <typename Fn> double timeNs(Fn &&fn) {
+  auto start = std::chrono::steady_clock::now();
+  fn();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const std::string path = argc > 1 ? argv[1] : "ir_file_bench.tirb";
+  const int repeats = argc > 2 ? std::atoi(argv[2]) : 100;
+  TensorMap["P"] = &TensorP;
+  TensorMap["Q"] = &TensorQ;
+
+  try {
+    const std::vector<Sample> kernels = samples();
+
+    // Build every kernel once and write them all to one file.
+    IRContext ctx(/*hash_consing=*/true);
+    std::vector<IRNode *> roots;
+    std::vector<std::unique_ptr<FlatIR>> flats;
+    std::vector<IRFileEntry> entries;
+    for (const Sample &sample : kernels) {
+      roots.push_back(sample.build(ctx));
+      flats.push_back(std::make_unique<FlatIR>(flatten(ctx, roots.back())));
+      entries.push_back(
+          {structuralHash(ctx, roots.back()), flats.back().get()});
+    }
+    writeIRFile(path, entries);
+
+    MappedIRFile file(path);
+    std::cout << path << ": version " << file.version() << ", "
+              << file.numKernels() << " kernels\n\n";
+    std::cout << std::left << std::setw(22) << "kernel" << std::setw(8)
+              << "result" << std::right << std::setw(14) << "build ns"
+              << std::setw(14) << "load ns" << "\n";
+
+    bool all_ok = true;
+    for (size_t k = 0; k < kernels.size(); ++k) {
+      std::optional<size_t> index = file.find(entries[k].key);
+      std::string result = "ok";
+      if (!index) {
+        result = "missing";
+      } else {
+        IRContext loaded;
+        IRNode *root =
+            unflatten(loaded, file.kernel(*index, resolveInto(loaded)));
+        if (structuralHash(loaded, root) != entries[k].key) {
+          result = "hash";
+        } else if (!structurallyEqual(ctx, roots[k], loaded, root)) {
+          result = "struct";
+        } else if (kernelCode(ctx, roots[k]) != kernelCode(loaded, root)) {
+          result = "code";
+        }
+      }
+      all_ok = all_ok && result == "ok";
+
+      // Rebuilding runs the parser and every pass; loading only unflattens.
+      double build_ns = timeNs([&] {
+        IRContext scratch;
+        for (int r = 0; r < repeats; ++r) {
+          IRContext::Checkpoint cp = scratch.checkpoint();
+          kernels[k].build(scratch);
+          scratch.rollback(cp);
+        }
+      });
+      double load_ns = !index ? 0 : timeNs([&] {
+        IRContext scratch;
+        for (int r = 0; r < repeats; ++r) {
+          IRContext::Checkpoint cp = scratch.checkpoint();
+          unflatten(scratch, file.kernel(*index, resolveInto(scratch)));
+          scratch.rollback(cp);
+        }
+      });
+      std::cout << std::left << std::setw(22) << kernels[k].name
+                << std::setw(8) << result << std::right << std::setw(14)
+                << std::fixed << std::setprecision(0) << build_ns / repeats
+                << std::setw(14) << load_ns / repeats << "\n";
+    }
+
+    // The padded kernel addresses P with a pitch of 1040; it must not load
+    // once P is packed.
+    const TensorLayout padded = TensorP.layout_;
+    TensorP.layout_ = TensorLayout::rowMajor(TensorP.extents_);
+    bool refused = false;
+    try {
+      IRContext loaded;
+      unflatten(loaded, file.kernel(*file.find(entries[3].key),
+                                    resolveInto(loaded)));
+    } catch (const std::exception &) {
+      refused = true;
+    }
+    TensorP.layout_ = padded;
+    std::cout << "\nstale layout          " << (refused ? "refused" : "loaded")
+              << "\n";
+    return all_ok && refused ? 0 : 1;
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+}
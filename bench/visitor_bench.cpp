@@ -0,0 +1,264 @@
+// Measures the per-node cost of walking the IR with the CRTP IRVisitor
+// against two run-time dispatch baselines: a classic visitor interface with
+// one virtual call per node, and the dynamic_cast chain the old printers used.
+// A last run times deepCopy, which is built on IRRewriter.
+
+#include "IR.hpp"
+#include "IRBuilder.hpp"
+#include "IRContext.hpp"
+#include "IRVisitor.hpp"
+#include "TilingPass.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+namespace {
+
+// --- CRTP: one switch, direct calls ---
+
+class CrtpCounter : public RecursiveIRVisitor<CrtpCounter> {
+public:
+  void visitConst(const Const *) { ++count_; }
+  void visitVariable(const Variable *) { ++count_; }
+  void visitBinary(const IRNode *node, const IRNode *one, const IRNode *two) {
+    ++count_;
+    RecursiveIRVisitor::visitBinary(node, one, two);
+  }
+  void visitLoad(const Load *node) {
+    ++count_;
+    RecursiveIRVisitor::visitLoad(node);
+  }
+  void visitStore(const Store *node) {
+    ++count_;
+    RecursiveIRVisitor::visitStore(node);
+  }
+  void visitAssign(const Assign *node) {
+    ++count_;
+    RecursiveIRVisitor::visitAssign(node);
+  }
+  void visitLoop(const Loop *node) {
+    ++count_;
+    RecursiveIRVisitor::visitLoop(node);
+  }
+
+  size_t count_ = 0;
+};
+
+// --- Baseline 1: visitor interface with virtual handlers ---
+
+class VirtualVisitor {
+public:
+  virtual ~VirtualVisitor() = default;
+  virtual void visitConst(const Const *) = 0;
+  virtual void visitVariable(const Variable *) = 0;
+  virtual void visitBinary(const IRNode *, const IRNode *, const IRNode *) = 0;
+  virtual void visitLoad(const Load *) = 0;
+  virtual void visitStore(const Store *) = 0;
+  virtual void visitAssign(const Assign *) = 0;
+  virtual void visitLoop(const Loop *) = 0;
+
+  void visit(const IRNode *node) {
+    if (!node) {
+      return;
+    }
+    switch (node->getType()) {
+    case IRNodeType::Const:
+      return visitConst(static_cast<const Const *>(node));
+    case IRNodeType::Variable:
+      return visitVariable(static_cast<const Variable *>(node));
+    case IRNodeType::Add:
+    case IRNodeType::Mul:
+    case IRNodeType::Min:
+    case IRNodeType::Div: {
+      const Add *b = static_cast<const Add *>(node);
+      return visitBinary(node, b->operand_one_, b->operand_two_);
+    }
+    case IRNodeType::Load:
+      return visitLoad(static_cast<const Load *>(node));
+    case IRNodeType::Store:
+      return visitStore(static_cast<const Store *>(node));
+    case IRNodeType::Assign:
+      return visitAssign(static_cast<const Assign *>(node));
+    case IRNodeType::Loop:
+      return visitLoop(static_cast<const Loop *>(node));
+    case IRNodeType::Block: // Not produced by the benchmark kernel.
+    case IRNodeType::RecursiveNest:
+    case IRNodeType::CurveNest:
+      return;
+    }
+  }
+};
+
+class VirtualCounter : public VirtualVisitor {
+public:
+  void visitConst(const Const *) override { ++count_; }
+  void visitVariable(const Variable *) override { ++count_; }
+  void visitBinary(const IRNode *, const IRNode *one,
+                   const IRNode *two) override {
+    ++count_;
+    visit(one);
+    visit(two);
+  }
+  void visitLoad(const Load *node) override {
+    ++count_;
+    for (const IRNode *index : node->indices_) {
+      visit(index);
+    }
+  }
+  void visitStore(const Store *node) override {
+    ++count_;
+    for (const IRNode *index : node->indices_) {
+      visit(index);
+    }
+  }
+  void visitAssign(const Assign *node) override {
+    ++count_;
+    visit(node->target_);
+    visit(node->value_);
+  }
+  void visitLoop(const Loop *node) override {
+    ++count_;
+    visit(node->lower_bound_);
+    visit(node->upper_bound_);
+    visit(node->step_);
+    for (const IRNode *child : node->body_) {
+      visit(child);
+    }
+  }
+
+  size_t count_ = 0;
+};
+
+// --- Baseline 2: dynamic_cast chain ---
+
+void countByCast(const IRNode *node, size_t &count) {
+  if (!node) {
+    return;
+  }
+  ++count;
+  if (const Loop *l = dynamic_cast<const Loop *>(node)) {
+    countByCast(l->lower_bound_, count);
+    countByCast(l->upper_bound_, count);
+    countByCast(l->step_, count);
+    for (const IRNode *child : l->body_) {
+      countByCast(child, count);
+    }
+  } else if (const Assign *a = dynamic_cast<const Assign *>(node)) {
+    countByCast(a->target_, count);
+    countByCast(a->value_, count);
+  } else if (const Load *ld = dynamic_cast<const Load *>(node)) {
+    for (const IRNode *index : ld->indices_) {
+      countByCast(index, count);
+    }
+  } else if (const Store *st = dynamic_cast<const Store *>(node)) {
+    for (const IRNode *index : st->indices_) {
+      countByCast(index, count);
+    }
+  } else if (const Add *add = dynamic_cast<const Add *>(node)) {
+    countByCast(add->operand_one_, count);
+    countByCast(add->operand_two_, count);
+  } else if (const Mul *mul = dynamic_cast<const Mul *>(node)) {
+    countByCast(mul->operand_one_, count);
+    countByCast(mul->operand_two_, count);
+  } else if (const Min *min = dynamic_cast<const Min *>(node)) {
+    countByCast(min->operand_one_, count);
+    countByCast(min->operand_two_, count);
+  }
+}
+
+// Builds `num_loops` sibling 2D nests, each with one statement whose right
+// hand side sums `terms` loads of the form T[i + k, j * k].
+IRNode *buildWideNest(IRContext &ctx, int num_loops, int terms) {
+  Symbol outer = ctx.symbols().intern("n");
+  Loop *root = ctx.create<Loop>(outer, ctx.makeConst(0, DType::Int32),
+                                ctx.makeConst(num_loops, DType::Int32),
+                                ctx.makeConst(1, DType::Int32));
+  Symbol i = ctx.symbols().intern("i");
+  Symbol j = ctx.symbols().intern("j");
+  for (int l = 0; l < num_loops; ++l) {
+    IRNode *value = nullptr;
+    for (int k = 0; k < terms; ++k) {
+      IRNode *row =
+          ctx.makeAdd(ctx.makeVariable(i), ctx.makeConst(k, DType::Int32));
+      IRNode *col =
+          ctx.makeMul(ctx.makeVariable(j), ctx.makeConst(k + 1, DType::Int32));
+      IRNode *load = ctx.create<Load>(TensorA, std::vector<IRNode *>{row, col});
+      value = value ? ctx.makeAdd(value, load) : load;
+    }
+    IRNode *store = ctx.create<Store>(
+        TensorC,
+        std::vector<IRNode *>{ctx.makeVariable(i), ctx.makeVariable(j)});
+    Loop *loop_j = ctx.create<Loop>(j, ctx.makeConst(0, DType::Int32),
+                                    ctx.makeConst(1024, DType::Int32),
+                                    ctx.makeConst(1, DType::Int32));
+    loop_j->body_.push_back(ctx.create<Assign>(store, value));
+    Loop *loop_i = ctx.create<Loop>(i, ctx.makeConst(0, DType::Int32),
+                                    ctx.makeConst(1024, DType::Int32),
+                                    ctx.makeConst(1, DType::Int32));
+    loop_i->body_.push_back(loop_j);
+    root->body_.push_back(loop_i);
+  }
+  return root;
+}
+
+template <typename F> double timeNs(int reps, F &&body) {
+  auto start = std::chrono::steady_clock::now();
+  for (int r = 0; r < reps; ++r) {
+    body();
+  }
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const int num_loops = argc > 1 ? std::atoi(argv[1]) : 2000;
+  const int reps = argc > 2 ? std::atoi(argv[2]) : 50;
+
+  // No hash-consing, so every visited node is a distinct allocation.
+  IRContext ctx;
+  IRNode *root = buildWideNest(ctx, num_loops, 8);
+
+  CrtpCounter probe;
+  probe.visit(root);
+  const size_t nodes = probe.count_;
+
+  size_t sink = 0;
+  double crtp_ns = timeNs(reps, [&] {
+    CrtpCounter counter;
+    counter.visit(root);
+    sink += counter.count_;
+  });
+  double virtual_ns = timeNs(reps, [&] {
+    VirtualCounter counter;
+    VirtualVisitor &visitor = counter;
+    visitor.visit(root);
+    sink += counter.count_;
+  });
+  double cast_ns = timeNs(reps, [&] {
+    size_t count = 0;
+    countByCast(root, count);
+    sink += count;
+  });
+
+  IRContext copy_ctx;
+  double copy_ns = timeNs(reps, [&] {
+    IRContext::Checkpoint cp = copy_ctx.checkpoint();
+    sink += deepCopy(copy_ctx, root) != nullptr;
+    copy_ctx.rollback(cp);
+  });
+
+  const double visits = static_cast<double>(nodes) * reps;
+  std::cout << "Nodes per walk:        " << nodes << " (" << reps
+            << " walks)\n";
+  std::cout << "CRTP visitor:          " << crtp_ns / visits << " ns/node\n";
+  std::cout << "Virtual visitor:       " << virtual_ns / visits
+            << " ns/node\n";
+  std::cout << "dynamic_cast chain:    " << cast_ns / visits << " ns/node\n";
+  std::cout << "deepCopy (IRRewriter): " << copy_ns / visits << " ns/node\n";
+  std::cout << "Virtual / CRTP:        " << virtual_ns / crtp_ns << "x\n";
+  std::cout << "(checksum " << sink << ")\n";
+  return 0;
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "IR.hpp"
+#include "IRContext.hpp"
+#include "PassManager.hpp"
+#include "SymbolTable.hpp"
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Canonical affine form `c0 + c1*s1 + ... + cn*sn` over integer
+ * symbols (loop indices and size parameters such as N).
+ *
+ * Terms are kept sorted by Symbol with no zero coefficients, so two affine
+ * expressions are equal iff their term vectors and constants are equal, and
+ * addition/subtraction are a single linear merge. Coefficients are 64-bit and
+ * assumed not to overflow.
+ */
+class AffineExpr {
+public:
+  using Term = std::pair<Symbol, int64_t>;
+
+  AffineExpr() = default;
+  explicit AffineExpr(int64_t constant) : constant_(constant) {}
+
+  static AffineExpr symbol(Symbol sym, int64_t coefficient = 1);
+
+  int64_t constant() const { return constant_; }
+  const std::vector<Term> &terms() const { return terms_; }
+  bool isConstant() const { return terms_.empty(); }
+
+  // Returns 0 for symbols that do not appear.
+  int64_t coefficient(Symbol sym) const;
+
+  /**
+   * @brief Replaces every occurrence of `sym` with `value`.
+   */
+  AffineExpr substitute(Symbol sym, const AffineExpr &value) const;
+
+  AffineExpr operator+(const AffineExpr &other) const;
+  AffineExpr operator-(const AffineExpr &other) const;
+  AffineExpr operator*(int64_t factor) const;
+  AffineExpr operator-() const { return *this * -1; }
+
+  bool operator==(const AffineExpr &other) const {
+    return constant_ == other.constant_ && terms_ == other.terms_;
+  }
+  bool operator!=(const AffineExpr &other) const { return !(*this == other); }
+
+  std::string toString(const IRContext &ctx) const;
+
+private:
+  // Merges `b` scaled by `scale` into `a` (both sorted).
+  static AffineExpr combine(const AffineExpr &a, const AffineExpr &b,
+                            int64_t scale);
+
+  std::vector<Term> terms_;
+  int64_t constant_ = 0;
+};
+
+/**
+ * @brief Converts an integer expression built from Const, Variable, Add and
+ * Mul into affine form.
+ * @return std::nullopt if the expression is not affine (e.g. contains a Min,
+ * a Load, a floating-point constant or a product of two symbols).
+ */
+std::optional<AffineExpr> toAffine(const IRNode *node);
+
+/**
+ * @brief Builds the canonical IR for an affine expression: terms in Symbol
+ * order as `s` or `(s * c)`, followed by the constant if it is non-zero.
+ * Nodes go through the context factories, so they are hash-consed when
+ * enabled.
+ */
+IRNode *fromAffine(IRContext &ctx, const AffineExpr &expr);
+
+/**
+ * @brief Returns a canonical, simplified form of an index or bound expression.
+ *
+ * Affine subtrees are rebuilt through fromAffine, and Min(a, b) folds to the
+ * smaller operand when a - b is a known constant. Subtrees that are already
+ * canonical are returned as-is, so the result shares structure with the input.
+ */
+IRNode *simplifyExpr(IRContext &ctx, IRNode *node);
+
+/**
+ * @brief Replaces every use of the loop index `index` under `node` by
+ * `value`. Access indices that change are put back in canonical form, so
+ * substituting i + 1 into A[2 * i] gives A[2 * i + 2] rather than
+ * A[(i + 1) * 2].
+ */
+IRNode *substituteIndex(IRContext &ctx, const IRNode *node, Symbol index,
+                        IRNode *value);
+
+/**
+ * @brief Builds the simplified bound `lb + (ub - lb) / chunk * chunk`: the
+ * end of the longest prefix of [lb, ub) made of whole `chunk`-sized pieces.
+ * Used to split a loop into a part whose trip count is a multiple of
+ * `chunk` and a remainder.
+ */
+IRNode *alignedEnd(IRContext &ctx, IRNode *lb, IRNode *ub, int64_t chunk);
+
+/**
+ * @brief Applies simplifyExpr to every loop bound, step and access index.
+ */
+class AffineSimplifyPass : public Pass {
+public:
+  const char *name() const override { return "affine-simplify"; }
+  bool run(IRContext &ctx, IRNode *&root, AnalysisManager &am) override;
+};
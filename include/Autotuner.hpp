@@ -0,0 +1,120 @@
+#pragma once
+
+#include "DependenceAnalysis.hpp"
+#include "IR.hpp"
+#include "IRContext.hpp"
+#include "PassManager.hpp"
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief One point of the autotuner's search space.
+ */
+struct Schedule {
+  // Tile size per band loop, outermost first; 0 leaves the loop untiled.
+  std::vector<int64_t> tile_sizes_;
+  // Order of the tile loops and of the point loops, as a permutation of band
+  // positions; empty keeps the band order.
+  std::vector<size_t> order_;
+  // Unroll hint for the innermost loop (0 or 1: none).
+  unsigned unroll_ = 0;
+
+  // e.g. "tile 32x0x64 order 0,2,1 unroll 4"
+  std::string toString() const;
+};
+
+struct Measurement {
+  Schedule schedule_;
+  double ms_ = 0;          // Fastest of the timed runs.
+  double model_score_ = 0; // Predicted misses per iteration; lower is better.
+  bool correct_ = true;    // Output matched the untiled kernel.
+};
+
+struct AutotuneReport {
+  double baseline_ms_ = 0;            // The untiled kernel.
+  size_t enumerated_ = 0;             // Candidates before pruning.
+  std::vector<Measurement> measured_; // Correct candidates, fastest first.
+  std::vector<Measurement> rejected_; // Candidates with wrong output.
+
+  // nullptr if nothing was measured.
+  const Measurement *best() const;
+  // Baseline time over the best time (1 if nothing was measured).
+  double speedup() const;
+
+  void print(std::ostream &os, size_t top = 10) const;
+};
+
+struct TunerOptions {
+  // Candidate tile sizes; sizes that are not below a loop's trip count or not
+  // a multiple of its step are skipped. Leaving a loop untiled is always a
+  // candidate.
+  std::vector<int64_t> tile_sizes_ = {8, 16, 32, 64, 128, 256};
+  std::vector<unsigned> unroll_factors_ = {1, 4};
+  // Try loop permutations; orders that would reverse a dependence are
+  // skipped.
+  bool reorder_ = true;
+  // Tilings and orders that survive the model-based pruning.
+  size_t keep_tilings_ = 8;
+  size_t keep_orders_ = 2;
+  size_t repetitions_ = 5;
+  // Values of the size parameters (N, M, ...). Missing ones are inferred from
+  // the extent of a tensor dimension the bounded loop addresses.
+  std::map<std::string, int64_t> params_;
+  // Defaults to $CXX, or "c++".
+  std::string compiler_;
+  std::string flags_ = "-O2";
+  // Defaults to a fresh directory under the system temporary directory,
+  // removed after tuning unless keep_files_ is set.
+  std::string work_dir_;
+  bool keep_files_ = false;
+};
+
+/**
+ * @brief Empirical search over tile sizes, loop orders and unroll factors for
+ * the outermost band of a kernel.
+ *
+ * Only schedules the DependenceAnalysis allows are considered. The rest are
+ * pruned twice before anything is compiled: tilings are ranked by the cache
+ * model (see CacheModel.hpp) and loop orders by their strides (see
+ * loopOrderCost in LoopInterchange.hpp). The survivors are generated with
+ * generateKernel, compiled together with the local C++ compiler into one
+ * timing harness, and run on synthetic data against the untiled kernel; a
+ * candidate whose output differs is rejected.
+ */
+class Autotuner {
+public:
+  Autotuner(IRContext &ctx, IRNode *untiled, TunerOptions options = {});
+
+  /**
+   * @brief The candidates that survive pruning, best predicted first.
+   */
+  std::vector<Measurement> candidates() const;
+
+  /**
+   * @brief Compiles and times every candidate.
+   * @throws std::runtime_error if the harness does not compile or run.
+   */
+  AutotuneReport tune();
+
+  /**
+   * @brief Applies a schedule to the untiled kernel.
+   * @throws std::invalid_argument if the band cannot be tiled that way.
+   */
+  IRNode *apply(const Schedule &schedule) const;
+
+private:
+  std::string harnessSource(const std::vector<Measurement> &candidates) const;
+
+  IRContext &ctx_;
+  IRNode *untiled_;
+  TunerOptions options_;
+  std::vector<const Loop *> band_;
+  DependenceInfo dependences_;
+  std::vector<int64_t> trips_;
+  std::vector<std::pair<Symbol, int64_t>> params_;
+  // Footprint model of the untiled band, shared by every candidate.
+  mutable AnalysisManager analyses_;
+};
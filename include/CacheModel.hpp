@@ -0,0 +1,171 @@
+#pragma once
+
+#include "AffineExpr.hpp"
+#include "IR.hpp"
+#include "IRContext.hpp"
+#include "LoopAnalysis.hpp"
+#include "TilingPass.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief One data (or unified) cache level.
+ */
+struct CacheLevel {
+  unsigned level_ = 0;
+  size_t size_ = 0;       // Bytes.
+  size_t line_size_ = 64; // Bytes.
+  size_t associativity_ = 8;
+
+  size_t numSets() const {
+    size_t way_bytes = line_size_ * associativity_;
+    return way_bytes ? std::max<size_t>(size_ / way_bytes, 1) : 1;
+  }
+};
+
+/**
+ * @brief The data cache hierarchy of a CPU, L1 first.
+ */
+class CacheTopology {
+public:
+  /**
+   * @brief Reads every Data/Unified cache under `sysfs_dir` (one indexN
+   * directory per cache, as in /sys/devices/system/cpu/cpu0/cache). Falls back
+   * to defaults() if nothing can be read.
+   */
+  static CacheTopology detect(
+      const std::string &sysfs_dir = "/sys/devices/system/cpu/cpu0/cache");
+
+  // 32 KiB 8-way L1, 1 MiB 16-way L2, 32 MiB 16-way L3, 64-byte lines.
+  static CacheTopology defaults();
+
+  // The topology of this machine, detected once.
+  static const CacheTopology &host();
+
+  // Returns nullptr if the level does not exist.
+  const CacheLevel *level(unsigned n) const;
+
+  std::vector<CacheLevel> levels_;
+};
+
+/**
+ * @brief Cache behaviour of one tile of a loop band.
+ */
+struct TileFootprint {
+  size_t lines_ = 0; // Distinct cache lines touched by all accesses.
+  size_t bytes_ = 0; // lines_ * line size.
+  // Worst number of lines competing for one cache set. The tile only stays
+  // resident if this is at most the associativity.
+  size_t set_pressure_ = 0;
+};
+
+/**
+ * @brief Trip count of `loop`, estimated from tensor extents when its bounds
+ * are symbolic.
+ */
+int64_t estimateTripCount(const Loop *loop, const AccessInfo &accesses);
+
+/**
+ * @brief Tile footprints of one band for any number of candidate sizes.
+ *
+ * Everything that does not depend on the tile sizes (affine forms, strides,
+ * trip counts, deduplication) is done once on construction, so evaluate() is
+ * cheap; see tileFootprint for the model itself. Cached per root as
+ * FootprintAnalysis.
+ */
+class FootprintModel {
+public:
+  // Models the outermost `depth` loops of the band at `root` (all by default).
+  FootprintModel(const IRContext &ctx, const IRNode *root,
+                 size_t depth = SIZE_MAX);
+
+  const std::vector<const Loop *> &band() const { return band_; }
+  const std::vector<int64_t> &trips() const { return trips_; }
+
+  // Footprint of one tile; sizes of 0 (or missing) span the whole loop.
+  TileFootprint evaluate(const std::vector<int64_t> &sizes,
+                         const CacheLevel &cache) const;
+
+private:
+  struct Access {
+    const Tensor *tensor_ = nullptr;
+    size_t elem_ = 0;
+    // Linear part of each index (nullopt if not affine).
+    std::vector<std::optional<AffineExpr>> indices_;
+  };
+
+  static bool sameLines(const Access &a, const Access &b);
+
+  // Iterations a tile makes of the loop with index `sym`, 1 for symbols that
+  // are not loop indices (size parameters).
+  int64_t rangeOf(Symbol sym, const std::vector<int64_t> &sizes) const;
+
+  // Lines of one access within a tile, and the most lines of it that map to
+  // a single cache set.
+  void accessLines(const Access &access, const std::vector<int64_t> &sizes,
+                   const CacheLevel &cache, size_t &lines,
+                   size_t &pressure) const;
+
+  std::vector<const Loop *> band_;
+  std::vector<int64_t> trips_;
+  std::unordered_map<Symbol, int64_t> inner_trips_;
+  std::vector<Access> accesses_;
+};
+
+// --- Analyses (see AnalysisManager in PassManager.hpp) ---
+
+struct FootprintAnalysis {
+  using Result = FootprintModel;
+  static const char *name() { return "footprint"; }
+  static Result run(const IRContext &ctx, const IRNode *root);
+};
+
+/**
+ * @brief Estimates the data touched by one tile of the band rooted at `root`.
+ *
+ * Index expressions are put in affine form; along each tensor dimension a
+ * tile spans 1 + sum_d |coef_d| * (R_d - 1) elements, where R_d is the tile
+ * size of band loop d (or the trip count of loops outside the band). Element
+ * ranges are turned into cache lines through each tensor's layout strides and
+ * dtype: the unit-stride dimension is contiguous, every other dimension adds
+ * rows. Accesses with the same tensor and linear part (e.g. the load and
+ * store of C[i, j]) are counted once.
+ *
+ * Rows whose stride is a multiple of the cache's way size map to the same
+ * sets; this is reported as set_pressure_ so that power-of-two pitches do not
+ * pass as resident when they would thrash.
+ */
+TileFootprint tileFootprint(const IRContext &ctx, const IRNode *root,
+                            const std::vector<int64_t> &tile_sizes,
+                            const CacheLevel &cache);
+
+/**
+ * @brief True if a tile with this footprint stays resident in `cache`: it
+ * fits in all but one way and no set is oversubscribed.
+ */
+bool fitsInCache(const TileFootprint &footprint, const CacheLevel &cache);
+
+/**
+ * @brief Picks the largest tile sizes (by tile volume, preferring long
+ * contiguous rows) for the outermost `depth` loops of the band at `root`
+ * whose footprint fits in `cache` without exceeding its associativity.
+ * Sizes are powers of two (or the whole trip count) and never exceed
+ * `max_sizes` when given.
+ */
+std::vector<int64_t>
+selectTileSizes(const IRContext &ctx, const IRNode *root, size_t depth,
+                const CacheLevel &cache,
+                const std::vector<int64_t> &max_sizes = {});
+
+/**
+ * @brief Builds a tiling hierarchy with one level per cache (coarsest first,
+ * named "L3", "L2", "L1"). Every level is nested in the previous one; levels
+ * that would not shrink the tile are dropped.
+ */
+std::vector<TileLevel> selectTileLevels(const IRContext &ctx,
+                                        const IRNode *root, size_t depth,
+                                        const CacheTopology &topology);
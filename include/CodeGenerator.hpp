@@ -1,34 +1,62 @@
 #pragma once
 
 #include "IR.hpp"
+#include "IRContext.hpp"
 #include <iostream>
 #include <string>
 
 /**
  * @brief Recursively generates C++ code from the IR tree into an output stream.
  *
+ * @param ctx The context owning the tree (used to resolve symbol names).
  * @param root A pointer to the root of the IRNode subtree to generate code for.
  * @param depth The current indentation level.
  * @param os The output stream to write the generated C++ code to.
  */
-void codeGeneration(const IRNode *root, int depth, std::ostream &os);
+void codeGeneration(const IRContext &ctx, const IRNode *root, int depth,
+                    std::ostream &os);
 
 /**
  * @brief Recursively generates the C++ code for an expression (Const, Variable,
  * Add, Mul, Min, Load).
  *
+ * @param ctx The context owning the expression (used to resolve symbol names).
  * @param node A pointer to the root of the expression IRNode.
  * @return A string containing the C++ representation of the expression.
  */
-std::string generateExpression(const IRNode *node);
+std::string generateExpression(const IRContext &ctx, const IRNode *node);
+
+/**
+ * @brief Options for generateKernel.
+ */
+struct CodeGenOptions {
+  // Emit `#pragma GCC unroll N` before every innermost loop (0 or 1: none).
+  unsigned unroll_ = 0;
+  // Local buffers (e.g. packed tiles) beyond this many bytes in total are
+  // heap-allocated per call instead of placed on the stack; the kernel calls
+  // std::abort if such an allocation fails.
+  size_t max_stack_bytes_ = 64 * 1024;
+};
+
+/**
+ * @brief Generates one kernel as a standalone C++ function named `name`.
+ * Parameters are one pointer per accessed tensor followed by the free size
+ * symbols, each sorted by name (see KernelTypes), so every schedule of the
+ * same program has the same signature and kernels are interchangeable.
+ */
+void generateKernel(const IRContext &ctx, const IRNode *root,
+                    const std::string &name, std::ostream &os,
+                    const CodeGenOptions &options = {});
 
 /**
  * @brief Top-level function to generate C++ code into files/console for
  * benchmarking.
  *
+ * @param ctx The context owning both trees.
  * @param untiled_root The root of the original, untiled IR.
  * @param tiled_root The root of the transformed, tiled IR.
  * @param kernel_type The name/type of the kernel (e.g., "add", "transpose").
  */
-void generateCodeFiles(const IRNode *untiled_root, const IRNode *tiled_root,
+void generateCodeFiles(const IRContext &ctx, const IRNode *untiled_root,
+                       const IRNode *tiled_root,
                        const std::string &kernel_type);
\ No newline at end of file
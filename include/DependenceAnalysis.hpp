@@ -0,0 +1,103 @@
+#pragma once
+
+#include "IR.hpp"
+#include "IRContext.hpp"
+#include "LoopAnalysis.hpp"
+#include <cstdint>
+#include <optional>
+#include <ostream>
+#include <vector>
+
+/**
+ * @brief Sign of one component of a dependence: how the sink's iteration of a
+ * loop compares to the source's.
+ */
+enum class DepDirection : uint8_t {
+  Lt, // '<': the sink runs in a later iteration.
+  Eq, // '=': same iteration.
+  Gt, // '>': earlier iteration (only after a '<' in an outer loop).
+};
+
+enum class DependenceKind : uint8_t {
+  Flow,   // Write then read.
+  Anti,   // Read then write.
+  Output, // Write then write.
+};
+
+/**
+ * @brief One direction vector of a dependence between two accesses to the same
+ * tensor. A pair of accesses may have several.
+ */
+struct Dependence {
+  DependenceKind kind_ = DependenceKind::Flow;
+  size_t source_ = 0; // Index into DependenceInfo::accesses_.
+  size_t sink_ = 0;
+  // Loops enclosing both accesses, outermost first, one component each.
+  std::vector<const Loop *> loops_;
+  std::vector<DepDirection> direction_;
+  // Sink index minus source index, where it is a known constant.
+  std::vector<std::optional<int64_t>> distance_;
+  // Both ends belong to one update `X[f] = X[f] op y` (e.g. the matmul
+  // accumulation into C[i, j]).
+  bool reduction_ = false;
+
+  // Position of the first '<' component, or loops_.size() for a dependence
+  // within one iteration of every common loop.
+  size_t level() const;
+  bool carriedBy(const Loop *loop) const;
+};
+
+/**
+ * @brief The data dependences between the accesses under one root.
+ */
+struct DependenceInfo {
+  AccessInfo accesses_;
+  std::vector<Dependence> dependences_;
+  // Loops around an assignment to a scalar local (a Variable target, see
+  // KernelTypes::locals_). Locals are not tensor accesses and have no
+  // dependences of their own, so these loops are never reported parallel and
+  // are kept in their current order.
+  std::vector<const Loop *> scalar_loops_;
+
+  /**
+   * @brief True if no dependence is carried by `loop`, so its iterations can
+   * run in any order. With `allow_reductions`, dependences of reductions are
+   * ignored (the iterations still race on the accumulator).
+   */
+  bool isParallel(const Loop *loop, bool allow_reductions = false) const;
+
+  /**
+   * @brief True if the loops of `band` (outermost first, perfectly nested)
+   * can be put in any order: every dependence not already carried by a loop
+   * outside the band has only '<' and '=' components on the band.
+   */
+  bool isPermutable(const std::vector<const Loop *> &band) const;
+
+  /**
+   * @brief True if `band` can be tiled (tiling requires a fully permutable
+   * band).
+   */
+  bool isTilable(const std::vector<const Loop *> &band) const {
+    return isPermutable(band);
+  }
+
+  /**
+   * @brief True if running the loops of `band` in `order` (a permutation of
+   * band positions, outermost first) keeps every dependence.
+   */
+  bool isLegalOrder(const std::vector<const Loop *> &band,
+                    const std::vector<size_t> &order) const;
+
+  // One line per dependence, e.g.
+  //   flow C[i, j] -> C[i, j] (=, =, <) distance (0, 0, 1) reduction
+  void print(const IRContext &ctx, std::ostream &os) const;
+
+private:
+  bool touchesScalars(const std::vector<const Loop *> &band) const;
+};
+
+struct DependenceAnalysis {
+  using Result = DependenceInfo;
+  static const char *name() { return "dependences"; }
+  static Result run(const IRContext &ctx, const IRNode *root);
+};
@@ -0,0 +1,152 @@
+#pragma once
+
+#include "IR.hpp"
+#include "IRContext.hpp"
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief Index of a node inside a FlatIR.
+ */
+using NodeId = uint32_t;
+constexpr NodeId kNullNode = std::numeric_limits<NodeId>::max();
+
+/**
+ * @brief Compact encoding of one kernel: every node lives in contiguous,
+ * struct-of-arrays storage and refers to other nodes by 32-bit NodeId.
+ *
+ * Nodes are stored in post-order (children before parents, root last), so a
+ * forward walk over the arrays is a bottom-up traversal. Variable-length child
+ * lists (Loop/Block::body_, Load/Store::indices_) are inline ranges into
+ * `children_`. All arrays hold trivially copyable data, so copying a kernel
+ * is a handful of memcpys.
+ *
+ * Slot usage per node kind:
+ *
+ * | Kind          | op0          | op1         | op2     | op3   | range   |
+ * | :------------ | :----------- | :---------- | :------ | :---- | :------ |
+ * | Const         | bits lo      | bits hi     | variant | DType |         |
+ * | Variable      | symbol       |             |         |       |         |
+ * | Add, Mul, Min | operand one  | operand two |         |       |         |
+ * | Div           | operand one  | operand two |         |       |         |
+ * | Load, Store   | tensor       |             |         |       | indices |
+ * | Assign        | target       | value       |         |       |         |
+ * | Loop          | index symbol | lower bound | upper   | step  | body    |
+ * | Block         |              |             |         |       | body    |
+ * | RecursiveNest | band         |             |         |       | sizes   |
+ * | CurveNest     | band         | CurveOrder  |         |       |         |
+ *
+ * A RecursiveNest's base sizes are Int64 Const nodes in its range.
+ *
+ * Symbols and tensors are local to the FlatIR (`symbol_names_`, `tensors_`),
+ * so a kernel can be unflattened into any IRContext.
+ */
+struct FlatIRView;
+
+class FlatIR {
+public:
+  NodeId root() const { return root_; }
+  size_t size() const { return kind_.size(); }
+
+  IRNodeType kind(NodeId id) const {
+    return static_cast<IRNodeType>(kind_[id]);
+  }
+
+  /**
+   * @brief Returns the [begin, end) span of a node's inline child range.
+   */
+  const NodeId *childrenBegin(NodeId id) const {
+    return children_.data() + range_begin_[id];
+  }
+  const NodeId *childrenEnd(NodeId id) const {
+    return childrenBegin(id) + range_size_[id];
+  }
+
+  /**
+   * @brief Appends a node and returns its id. `children` is copied into the
+   * node's inline range.
+   */
+  NodeId addNode(IRNodeType kind, uint32_t op0 = 0, uint32_t op1 = 0,
+                 uint32_t op2 = 0, uint32_t op3 = 0,
+                 const std::vector<NodeId> &children = {});
+
+  void setRoot(NodeId id) { root_ = id; }
+
+  // Read-only view over this kernel's arrays (valid while it is unchanged).
+  FlatIRView view() const;
+
+  // --- Struct-of-arrays node storage (indexed by NodeId) ---
+  std::vector<uint8_t> kind_;
+  std::vector<uint32_t> op0_;
+  std::vector<uint32_t> op1_;
+  std::vector<uint32_t> op2_;
+  std::vector<uint32_t> op3_;
+  std::vector<uint32_t> range_begin_;
+  std::vector<uint32_t> range_size_;
+
+  // Backing store for all inline child ranges.
+  std::vector<NodeId> children_;
+
+  // Kernel-local symbol and tensor tables.
+  std::vector<std::string> symbol_names_;
+  std::vector<Tensor *> tensors_;
+
+private:
+  NodeId root_ = kNullNode;
+};
+
+/**
+ * @brief Read-only FlatIR that does not own its node arrays, e.g. a kernel
+ * read straight out of a memory-mapped file (see IRFile.hpp).
+ */
+struct FlatIRView {
+  NodeId root_ = kNullNode;
+  size_t size_ = 0;
+  size_t num_children_ = 0;
+
+  const uint8_t *kind_ = nullptr;
+  const uint32_t *op0_ = nullptr;
+  const uint32_t *op1_ = nullptr;
+  const uint32_t *op2_ = nullptr;
+  const uint32_t *op3_ = nullptr;
+  const uint32_t *range_begin_ = nullptr;
+  const uint32_t *range_size_ = nullptr;
+  const NodeId *children_ = nullptr;
+
+  std::vector<std::string_view> symbol_names_;
+  std::vector<Tensor *> tensors_;
+
+  IRNodeType kind(NodeId id) const {
+    return static_cast<IRNodeType>(kind_[id]);
+  }
+  const NodeId *childrenBegin(NodeId id) const {
+    return children_ + range_begin_[id];
+  }
+  const NodeId *childrenEnd(NodeId id) const {
+    return childrenBegin(id) + range_size_[id];
+  }
+};
+
+/**
+ * @brief Encodes an IR tree (or DAG) into a FlatIR. Shared subtrees are
+ * encoded once and stay shared.
+ */
+FlatIR flatten(const IRContext &ctx, const IRNode *root);
+
+/**
+ * @brief Rebuilds the pointer-based IR from a FlatIR inside `ctx`. Expression
+ * nodes go through the context factories, so they are hash-consed when the
+ * context has interning enabled.
+ * @return The root node, owned by ctx.
+ */
+IRNode *unflatten(IRContext &ctx, const FlatIR &flat);
+
+/**
+ * @brief Same as above, reading from a view. Node references, symbols,
+ * tensor ids and constant dtypes are checked, so a corrupt view throws instead
+ * of crashing.
+ */
+IRNode *unflatten(IRContext &ctx, const FlatIRView &flat);
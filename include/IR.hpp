@@ -1,8 +1,20 @@
 #pragma once
 
+#include "SymbolTable.hpp"
+#include "TensorLayout.hpp"
 #include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <variant>
 #include <vector>
 
+// NOTE: IR nodes are allocated through an IRContext (see IRContext.hpp), which
+// owns the memory of every node it creates. All child pointers inside the tree
+// are therefore non-owning; a whole tree is freed at once by releasing its
+// context. Passes share untouched subtrees between their input and output, so
+// a tree must be deepCopy'd before it is mutated in place.
+
 using ConstValue = std::variant<int,       // Int32
                                 long long, // Int64
                                 float,     // Float32
@@ -16,6 +28,9 @@ enum class DType {
   Int64,
 };
 
+// Last DType; stored dtypes above it are corrupt.
+constexpr DType kLastDType = DType::Int64;
+
 enum class IRNodeType {
   // Structural Nodes
   Loop,
@@ -30,33 +45,51 @@ enum class IRNodeType {
   Const,    // For constants like 0, N, T, etc.
   Variable, // For loop indices i, j, ii, jj
   Min,      // Ex MIN(ii + T, N) in tiling bounds
+  Div,      // Integer division, truncating (full-tile bounds: N / T * T)
+  Block,    // Statement sequence, e.g. a full-tile nest and its remainder
+  // Loop band run by recursive bisection (cache-oblivious tiling)
+  RecursiveNest,
+  // Two loops run along a space-filling curve (e.g. tiles in Z-order)
+  CurveNest,
 };
 
 class IRNode {
 public:
+  explicit IRNode(IRNodeType type) : type_(type) {}
   virtual ~IRNode() = default;
-  virtual IRNodeType getType() const = 0;
+
+  // The kind is stored in the node, so traversals dispatch on it with a
+  // single switch instead of a virtual call.
+  IRNodeType getType() const { return type_; }
+
+  /**
+   * @brief Drops the cached structural hash (see StructuralHash.hpp). Must be
+   * called on a node, and on every ancestor that was already hashed, after
+   * mutating it in place.
+   */
+  void invalidateHash() const { structural_hash_ = 0; }
+
+  const IRNodeType type_;
+
+  // Lazily computed by structuralHash(); 0 means "not computed yet".
+  mutable uint64_t structural_hash_ = 0;
 };
 
 class Tensor {
 public:
+  // An empty `layout` means packed row-major.
   Tensor(std::string n, DType d, size_t dims,
-         const std::vector<size_t> &extents)
-      : name(std::move(n)), dtype_(d), dims_(dims), extents_(extents) {
+         const std::vector<size_t> &extents, TensorLayout layout = {})
+      : name(std::move(n)), dtype_(d), dims_(dims), extents_(extents),
+        layout_(std::move(layout)) {
     if (dims != extents.size()) {
       throw std::invalid_argument("dims must match the size of extents");
     }
 
-    strides_.resize(dims_);
-
-    size_t current_stride = 1;
-
-    for (int i = dims_ - 1; i >= 0; --i) {
-      strides_[i] = current_stride;
-      // The stride for the next (previous index) dimension
-      // is the current stride multiplied by the extent of the current
-      // dimension.
-      current_stride *= extents_[i];
+    if (layout_.dims() == 0) {
+      layout_ = TensorLayout::rowMajor(extents_);
+    } else if (layout_.dims() != dims_) {
+      throw std::invalid_argument("layout must match the number of dims");
     }
   }
 
@@ -64,14 +97,16 @@ public:
   DType dtype_;
   size_t dims_;
   std::vector<size_t> extents_;
-  std::vector<size_t> strides_;
+  TensorLayout layout_;
+  // Scratch storage of one kernel (see IRContext::makeBuffer): codegen
+  // declares it inside the kernel instead of taking it as a parameter.
+  bool local_ = false;
 };
 
 class Const : public IRNode {
 public:
-  Const(ConstValue val, DType type) : value_(std::move(val)), dtype_(type) {}
-
-  IRNodeType getType() const override { return IRNodeType::Const; }
+  Const(ConstValue val, DType type)
+      : IRNode(IRNodeType::Const), value_(std::move(val)), dtype_(type) {}
 
   const ConstValue &getValue() const { return value_; }
   DType getDType() const { return dtype_; }
@@ -81,95 +116,136 @@ public:
   DType dtype_;
 };
 
+// Names are interned in the owning IRContext's SymbolTable; the node only
+// stores the Symbol ID.
 class Variable : public IRNode {
 public:
-  Variable(std::string name) : name_(std::move(name)) {}
-
-  IRNodeType getType() const override { return IRNodeType::Variable; }
+  Variable(Symbol sym) : IRNode(IRNodeType::Variable), symbol_(sym) {}
 
-  const std::string &getName() const { return name_; }
+  Symbol getSymbol() const { return symbol_; }
 
-  std::string name_;
+  Symbol symbol_;
 };
 
 class Min : public IRNode {
 public:
-  Min(std::unique_ptr<IRNode> one, std::unique_ptr<IRNode> two)
-      : operand_one_(std::move(one)), operand_two_(std::move(two)) {}
+  Min(IRNode *one, IRNode *two)
+      : IRNode(IRNodeType::Min), operand_one_(one), operand_two_(two) {}
 
-  IRNodeType getType() const override { return IRNodeType::Min; }
+  IRNode *operand_one_;
+  IRNode *operand_two_;
+};
 
-  std::unique_ptr<IRNode> operand_one_;
-  std::unique_ptr<IRNode> operand_two_;
+// Integer division with C++ semantics (truncates toward zero). Only used for
+// index arithmetic with a positive divisor.
+class Div : public IRNode {
+public:
+  Div(IRNode *one, IRNode *two)
+      : IRNode(IRNodeType::Div), operand_one_(one), operand_two_(two) {}
+
+  IRNode *operand_one_;
+  IRNode *operand_two_;
 };
 
 class Add : public IRNode {
 public:
-  Add(std::unique_ptr<IRNode> one, std::unique_ptr<IRNode> two)
-      : operand_one_(std::move(one)), operand_two_(std::move(two)) {}
-
-  IRNodeType getType() const override { return IRNodeType::Add; }
+  Add(IRNode *one, IRNode *two)
+      : IRNode(IRNodeType::Add), operand_one_(one), operand_two_(two) {}
 
-  std::unique_ptr<IRNode> operand_one_;
-  std::unique_ptr<IRNode> operand_two_;
+  IRNode *operand_one_;
+  IRNode *operand_two_;
 };
 
 class Mul : public IRNode {
 public:
-  Mul(std::unique_ptr<IRNode> one, std::unique_ptr<IRNode> two)
-      : operand_one_(std::move(one)), operand_two_(std::move(two)) {}
-
-  IRNodeType getType() const override { return IRNodeType::Mul; }
+  Mul(IRNode *one, IRNode *two)
+      : IRNode(IRNodeType::Mul), operand_one_(one), operand_two_(two) {}
 
-  std::unique_ptr<IRNode> operand_one_;
-  std::unique_ptr<IRNode> operand_two_;
+  IRNode *operand_one_;
+  IRNode *operand_two_;
 };
 
 class Load : public IRNode {
 public:
-  Load(Tensor &t, std::vector<std::unique_ptr<IRNode>> indices)
-      : tensor_(t), indices_(std::move(indices)) {}
-
-  IRNodeType getType() const override { return IRNodeType::Load; }
+  Load(Tensor &t, std::vector<IRNode *> indices)
+      : IRNode(IRNodeType::Load), tensor_(t), indices_(std::move(indices)) {}
 
   Tensor &tensor_;
-  std::vector<std::unique_ptr<IRNode>> indices_;
+  std::vector<IRNode *> indices_;
 };
 
 class Store : public IRNode {
 public:
-  Store(Tensor &t, std::vector<std::unique_ptr<IRNode>> indices)
-      : tensor_(t), indices_(std::move(indices)) {}
-
-  IRNodeType getType() const override { return IRNodeType::Store; }
+  Store(Tensor &t, std::vector<IRNode *> indices)
+      : IRNode(IRNodeType::Store), tensor_(t), indices_(std::move(indices)) {}
 
   Tensor &tensor_;
-  std::vector<std::unique_ptr<IRNode>> indices_;
+  std::vector<IRNode *> indices_;
 };
 
 class Loop : public IRNode {
 public:
-  Loop(std::string i, std::unique_ptr<IRNode> lb, std::unique_ptr<IRNode> ub,
-       std::unique_ptr<IRNode> step)
-      : index_(std::move(i)), lower_bound_(std::move(lb)),
-        upper_bound_(std::move(ub)), step_(std::move(step)) {}
+  Loop(Symbol i, IRNode *lb, IRNode *ub, IRNode *step)
+      : IRNode(IRNodeType::Loop), index_(i), lower_bound_(lb),
+        upper_bound_(ub), step_(step) {}
+
+  Symbol index_;
+  IRNode *lower_bound_;
+  IRNode *upper_bound_;
+  IRNode *step_;
+  std::vector<IRNode *> body_;
+};
 
-  IRNodeType getType() const override { return IRNodeType::Loop; }
+// Statements executed in order. Loop bodies are already sequences; a Block is
+// needed where a transform turns one statement into several, e.g. at the root.
+class Block : public IRNode {
+public:
+  Block() : IRNode(IRNodeType::Block) {}
+  explicit Block(std::vector<IRNode *> body)
+      : IRNode(IRNodeType::Block), body_(std::move(body)) {}
 
-  std::string index_;
-  std::unique_ptr<IRNode> lower_bound_;
-  std::unique_ptr<IRNode> upper_bound_;
-  std::unique_ptr<IRNode> step_;
-  std::vector<std::unique_ptr<IRNode>> body_;
+  std::vector<IRNode *> body_;
 };
 
-class Assign : public IRNode {
+// Runs the outermost base_sizes_.size() loops of the perfect band band_ over
+// the same iterations in a different order: the iteration box is halved
+// along its longest dimension until every extent is at most its base size,
+// and each base box runs the band with its bounds narrowed to the box.
+class RecursiveNest : public IRNode {
 public:
-  Assign(std::unique_ptr<IRNode> target, std::unique_ptr<IRNode> value)
-      : target_(std::move(target)), value_(std::move(value)) {}
+  RecursiveNest(IRNode *band, std::vector<int64_t> base_sizes)
+      : IRNode(IRNodeType::RecursiveNest), band_(band),
+        base_sizes_(std::move(base_sizes)) {}
+
+  IRNode *band_;
+  std::vector<int64_t> base_sizes_;
+};
 
-  IRNodeType getType() const override { return IRNodeType::Assign; }
+// Order in which a CurveNest visits the points of its 2D iteration space.
+enum class CurveOrder {
+  RowMajor, // The plain loop nest
+  Morton,   // Z-order: quadrants recursively, each in row-major order
+  Hilbert,  // Quadrants recursively, rotated so each step moves to a neighbor
+};
+
+// Runs the two outermost loops of the perfect band band_ over the same
+// (o, i) pairs in curve_ order: the grid of pairs is covered by power-of-two
+// squares, each square's curve positions are decoded into pairs, and pairs
+// past the end of either loop are skipped. The loops' bodies run unchanged.
+class CurveNest : public IRNode {
+public:
+  CurveNest(IRNode *band, CurveOrder curve)
+      : IRNode(IRNodeType::CurveNest), band_(band), curve_(curve) {}
+
+  IRNode *band_;
+  CurveOrder curve_;
+};
+
+class Assign : public IRNode {
+public:
+  Assign(IRNode *target, IRNode *value)
+      : IRNode(IRNodeType::Assign), target_(target), value_(value) {}
 
-  std::unique_ptr<IRNode> target_;
-  std::unique_ptr<IRNode> value_;
+  IRNode *target_;
+  IRNode *value_;
 };
@@ -1,8 +1,8 @@
 #pragma once
 
 #include "IR.hpp"
+#include "IRContext.hpp"
 #include <map>
-#include <memory>
 #include <string>
 
 // --- I. Global Setup (External Declarations) ---
@@ -16,16 +16,18 @@ extern std::map<std::string, Tensor *> TensorMap;
 
 /**
  * @brief Parses an input program string into a complete IR tree.
+ * @param ctx The context that will own every node of the tree.
  * @param input_program The source code string (LOOPS:..., BODY:...).
- * @return A unique_ptr to the root IRNode (usually a Loop).
+ * @return A pointer to the root IRNode (usually a Loop), owned by ctx.
  */
-std::unique_ptr<IRNode> buildUntiledIR(const std::string &input_program);
+IRNode *buildUntiledIR(IRContext &ctx, const std::string &input_program);
 
 // --- III. Verification/Debugging Interface ---
 
 /**
  * @brief Traverses and prints the IR tree structure.
+ * @param ctx The context owning the tree (used to resolve symbol names).
  * @param node The root node to start printing from.
  * @param depth The current indentation level.
  */
-void printIR(const IRNode *node, int depth = 0);
\ No newline at end of file
+void printIR(const IRContext &ctx, const IRNode *node, int depth = 0);
\ No newline at end of file
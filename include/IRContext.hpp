@@ -0,0 +1,252 @@
+#pragma once
+
+#include "IR.hpp"
+#include "SymbolTable.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <new>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief A bump-pointer allocator. Memory is carved out of large slabs and is
+ * never returned piecemeal; reset() releases every slab at once.
+ */
+class Arena {
+public:
+  static constexpr size_t kDefaultSlabSize = 64 * 1024;
+
+  explicit Arena(size_t slab_size = kDefaultSlabSize)
+      : slab_size_(slab_size) {}
+  ~Arena() { reset(); }
+
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+
+  /**
+   * @brief Returns `size` bytes aligned to `align`. Only falls back to the
+   * system allocator when the current slab is exhausted.
+   */
+  void *allocate(size_t size, size_t align) {
+    size_t offset = padding(cur_, align);
+    if (cur_ == nullptr || offset + size > static_cast<size_t>(end_ - cur_)) {
+      newSlab(size + align);
+      offset = padding(cur_, align);
+    }
+    char *ptr = cur_ + offset;
+    cur_ = ptr + size;
+    bytes_used_ += size;
+    return ptr;
+  }
+
+  /**
+   * @brief Position in the arena that rollback() can return to.
+   */
+  struct Mark {
+    size_t slabs = 0;
+    char *cur = nullptr;
+    char *end = nullptr;
+    size_t bytes_used = 0;
+  };
+
+  Mark mark() const { return {slabs_.size(), cur_, end_, bytes_used_}; }
+
+  /**
+   * @brief Frees everything allocated since `m` was taken.
+   */
+  void rollback(const Mark &m);
+
+  /**
+   * @brief Frees every slab owned by the arena.
+   */
+  void reset();
+
+  size_t bytesUsed() const { return bytes_used_; }
+  size_t numSlabs() const { return slabs_.size(); }
+
+private:
+  static size_t padding(const char *p, size_t align) {
+    return (align - reinterpret_cast<uintptr_t>(p) % align) % align;
+  }
+
+  void newSlab(size_t min_size);
+
+  size_t slab_size_;
+  std::vector<char *> slabs_;
+  char *cur_ = nullptr;
+  char *end_ = nullptr;
+  size_t bytes_used_ = 0;
+};
+
+/**
+ * @brief Owns every IRNode of one or more IR trees.
+ *
+ * Nodes are placement-constructed inside an Arena, so creating a node costs
+ * roughly a pointer bump, and the tree itself only holds non-owning pointers.
+ * release() (or the destructor) tears down all nodes created through the
+ * context in one sweep; no pointer obtained from create() may be used after.
+ *
+ * Expression leaves and operators (Const, Variable, Add, Mul, Min, Div) should
+ * be built through the make*() factories. With hash-consing enabled, those
+ * return the existing node for any structurally identical expression, turning
+ * expression trees into DAGs: two interned expressions are equal iff their
+ * pointers are equal. Interned nodes are shared and must never be mutated.
+ *
+ * Transforms treat the IR as persistent: they rebuild only the path from the
+ * root to the nodes they change and share every untouched subtree with their
+ * input, so memory grows with the size of the edits rather than the tree.
+ * When exploring many candidates, take a checkpoint() before applying one and
+ * rollback() afterwards to reclaim everything the candidate allocated.
+ */
+class IRContext {
+public:
+  explicit IRContext(bool hash_consing = false) : hash_consing_(hash_consing) {}
+  ~IRContext() { release(); }
+
+  IRContext(const IRContext &) = delete;
+  IRContext &operator=(const IRContext &) = delete;
+
+  /**
+   * @brief Allocates and constructs a node of type T inside the arena.
+   * @return A non-owning pointer that stays valid until release().
+   */
+  template <typename T, typename... Args> T *create(Args &&...args) {
+    static_assert(std::is_base_of_v<IRNode, T>,
+                  "IRContext can only allocate IRNode subclasses");
+    void *mem = arena_.allocate(sizeof(T), alignof(T));
+    T *node = new (mem) T(std::forward<Args>(args)...);
+    nodes_.push_back(node);
+    return node;
+  }
+
+  // --- Expression factories (hash-consed when enabled) ---
+  Const *makeConst(ConstValue value, DType dtype);
+  Variable *makeVariable(Symbol sym);
+  Variable *makeVariable(const std::string &name) {
+    return makeVariable(symbols_.intern(name));
+  }
+  Add *makeAdd(IRNode *one, IRNode *two);
+  Mul *makeMul(IRNode *one, IRNode *two);
+  Min *makeMin(IRNode *one, IRNode *two);
+  Div *makeDiv(IRNode *one, IRNode *two);
+
+  /**
+   * @brief Creates a local_ tensor, e.g. a packed copy of an operand tile.
+   * Unlike nodes, buffers are not undone by rollback(); they stay valid until
+   * release().
+   */
+  Tensor *makeBuffer(const std::string &name, DType dtype,
+                     const std::vector<size_t> &extents, TensorLayout layout);
+
+  /**
+   * @brief A result memoized for one subtree (see memoize()).
+   */
+  struct MemoEntry {
+    const IRNode *subtree = nullptr;
+    std::vector<int64_t> value;
+  };
+
+  /**
+   * @brief Remembers `value` for `subtree` under `key`, which should be
+   * derived from the subtree's structuralHash plus any other inputs. The
+   * entry lives as long as the subtree: rollback() drops it with the nodes it
+   * refers to. At most kMemoLimit entries are kept; beyond that the memo
+   * starts over.
+   */
+  void memoize(uint64_t key, const IRNode *subtree,
+               std::vector<int64_t> value) const;
+
+  /**
+   * @brief Every entry stored under `key`. Keys can collide, so callers
+   * confirm a hit with structurallyEqual against MemoEntry::subtree.
+   */
+  std::vector<const MemoEntry *> memoized(uint64_t key) const;
+
+  static constexpr size_t kMemoLimit = 4096;
+
+  /**
+   * @brief Snapshot of the context's allocation state.
+   */
+  struct Checkpoint {
+    size_t nodes = 0;
+    Arena::Mark arena;
+  };
+
+  Checkpoint checkpoint() const { return {nodes_.size(), arena_.mark()}; }
+
+  /**
+   * @brief Destroys every node created since `cp` and returns its memory. Any
+   * pointer to such a node becomes dangling; nodes created before `cp` (and
+   * therefore any subtree they share) are untouched. Symbols interned since
+   * `cp` stay valid.
+   */
+  void rollback(const Checkpoint &cp);
+
+  /**
+   * @brief Destroys every node created through this context and returns the
+   * arena memory in bulk.
+   */
+  void release();
+
+  SymbolTable &symbols() { return symbols_; }
+  const SymbolTable &symbols() const { return symbols_; }
+  const std::string &name(Symbol sym) const { return symbols_.name(sym); }
+
+  bool hashConsing() const { return hash_consing_; }
+  size_t numNodes() const { return nodes_.size(); }
+  // Bumped by every rollback() and release(). Caches keyed by node pointers
+  // must drop their entries when it changes, since freed addresses are reused.
+  uint64_t epoch() const { return epoch_; }
+  size_t bytesUsed() const { return arena_.bytesUsed(); }
+
+private:
+  // Operator nodes are keyed by kind and operand identity. Operands are
+  // themselves interned, so a shallow key is a structural key.
+  using BinaryKey = std::tuple<IRNodeType, const IRNode *, const IRNode *>;
+
+  struct BinaryKeyHash {
+    size_t operator()(const BinaryKey &k) const {
+      size_t h = std::hash<int>()(static_cast<int>(std::get<0>(k)));
+      h = h * 31 + std::hash<const IRNode *>()(std::get<1>(k));
+      return h * 31 + std::hash<const IRNode *>()(std::get<2>(k));
+    }
+  };
+
+  struct ConstKeyHash {
+    size_t operator()(const std::pair<ConstValue, DType> &k) const {
+      return std::hash<ConstValue>()(k.first) * 31 +
+             static_cast<size_t>(k.second);
+    }
+  };
+
+  template <typename T>
+  T *makeBinary(IRNodeType kind, IRNode *one, IRNode *two);
+
+  // Removes `node` from the hash-consing tables if it is the interned copy.
+  void forget(const IRNode *node);
+
+  // Drops the memo entries of `node`.
+  void forgetMemo(const IRNode *node);
+
+  bool hash_consing_;
+  uint64_t epoch_ = 0;
+  SymbolTable symbols_;
+  std::unordered_map<std::pair<ConstValue, DType>, Const *, ConstKeyHash>
+      consts_;
+  std::vector<Variable *> variables_; // Indexed by Symbol.
+  std::unordered_map<BinaryKey, IRNode *, BinaryKeyHash> binaries_;
+  std::deque<Tensor> buffers_; // Stable addresses for Load/Store::tensor_.
+  // Memoized results by key, and the keys each subtree is stored under.
+  mutable std::unordered_multimap<uint64_t, MemoEntry> memo_;
+  mutable std::unordered_multimap<const IRNode *, uint64_t> memo_keys_;
+
+  Arena arena_;
+  // Creation order; nodes are destroyed in reverse so that members such as
+  // Loop::body_ vectors are torn down before the memory goes away.
+  std::vector<IRNode *> nodes_;
+};
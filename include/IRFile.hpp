@@ -0,0 +1,134 @@
+#pragma once
+
+#include "FlatIR.hpp"
+#include "IR.hpp"
+#include "IRContext.hpp"
+#include "TensorLayout.hpp"
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// --- Versioned binary container for FlatIR kernels ---
+//
+// File layout (all integers little-endian, every section 8-byte aligned):
+//
+//   FileHeader   magic "TIRB", version, kernel count, directory offset
+//   Directory    one {key, offset, size} entry per kernel, sorted by key
+//   Kernel blobs KernelHeader followed by the FlatIR arrays, verbatim
+//
+// Inside a kernel, Load/Store refer to tensors by id into the kernel's tensor
+// table (name, dtype, extents, layout, whether it is a kernel-local buffer);
+// the loader maps ids back to Tensor objects.
+// Loading mmaps the file and points a FlatIRView at the arrays in place, so
+// nothing is parsed or copied until a kernel is unflattened.
+
+constexpr uint32_t kIRFileMagic = 0x42524954; // "TIRB"
+// Version 2 added tensor layouts (strides, blocks, size, alignment).
+constexpr uint32_t kIRFileVersion = 2;
+
+/**
+ * @brief A kernel to be written, identified by a caller-chosen key (e.g. the
+ * structuralHash of the untiled kernel combined with the pass options).
+ */
+struct IRFileEntry {
+  uint64_t key;
+  const FlatIR *kernel;
+};
+
+/**
+ * @brief Writes `entries` to `path`, replacing the file.
+ * @throws std::runtime_error on I/O failure or duplicate keys.
+ */
+void writeIRFile(const std::string &path,
+                 const std::vector<IRFileEntry> &entries);
+
+/**
+ * @brief Tensor description stored in the file. Points into the mapping.
+ */
+struct TensorDesc {
+  std::string_view name;
+  DType dtype;
+  uint32_t dims;
+  const uint64_t *extents;
+  // Layout vectors, `dims` entries each; block and block_strides are nullptr
+  // for unblocked layouts.
+  const uint64_t *strides;
+  const uint64_t *block;
+  const uint64_t *block_strides;
+  uint64_t layout_size;
+  uint64_t alignment;
+  // Tensor::local_: scratch storage of the kernel, not in TensorMap.
+  bool local;
+
+  // Rebuilds the stored layout.
+  TensorLayout layout() const;
+};
+
+/**
+ * @brief Maps a stored tensor description to a live Tensor, or returns
+ * nullptr if it cannot be resolved.
+ */
+using TensorResolver = std::function<Tensor *(const TensorDesc &)>;
+
+/**
+ * @brief Resolves tensors through the global TensorMap by name, checking that
+ * dtype, extents and layout match: a kernel generated for a padded or blocked
+ * tensor must not be reused on a differently laid out one. Local tensors are
+ * not in TensorMap and resolve to nullptr.
+ */
+Tensor *resolveFromTensorMap(const TensorDesc &desc);
+
+/**
+ * @brief Resolver for kernels unflattened into `ctx`: local tensors (e.g. the
+ * packed tiles of OperandPackingPass) are recreated with ctx.makeBuffer, all
+ * others go through resolveFromTensorMap. `ctx` must outlive the resolver.
+ */
+TensorResolver resolveInto(IRContext &ctx);
+
+/**
+ * @brief A read-only memory mapping of a file written by writeIRFile.
+ *
+ * Opening only validates the header and the section bounds of each kernel;
+ * node arrays are read directly from the mapping. Views returned by kernel()
+ * stay valid as long as this object is alive.
+ */
+class MappedIRFile {
+public:
+  /**
+   * @throws std::runtime_error if the file cannot be mapped, has the wrong
+   * magic or version, any section lies outside the file, or a tensor record
+   * has an unknown dtype or flag.
+   */
+  explicit MappedIRFile(const std::string &path);
+  ~MappedIRFile();
+
+  MappedIRFile(const MappedIRFile &) = delete;
+  MappedIRFile &operator=(const MappedIRFile &) = delete;
+
+  uint32_t version() const;
+  size_t numKernels() const;
+  uint64_t key(size_t index) const;
+
+  // Binary search over the sorted directory.
+  std::optional<size_t> find(uint64_t key) const;
+
+  size_t numTensors(size_t index) const;
+  TensorDesc tensor(size_t index, size_t tensor_id) const;
+
+  /**
+   * @brief Returns a view of kernel `index` with its tensor table resolved.
+   * Unresolved tensors are left as nullptr (unflatten then throws); kernels
+   * with local buffers need resolveInto.
+   */
+  FlatIRView kernel(size_t index,
+                    const TensorResolver &resolve = resolveFromTensorMap) const;
+
+private:
+  const uint8_t *blob(size_t index) const;
+
+  const uint8_t *data_ = nullptr;
+  size_t size_ = 0;
+};
@@ -0,0 +1,330 @@
+#pragma once
+
+#include "IR.hpp"
+#include "IRContext.hpp"
+#include <vector>
+
+/**
+ * @brief Compile-time dispatched visitor over IR nodes (CRTP).
+ *
+ * visit() switches once on the node kind stored in IRNode and calls the
+ * matching visitX() of Derived directly, so traversals contain no virtual
+ * calls. Derived classes only define the handlers they need; anything left
+ * out falls back to a coarser handler:
+ *
+ *   visitAdd / visitMul / visitMin / visitDiv  ->  visitBinary  ->  visitNode
+ *   every other visitX                         ->  visitNode
+ *
+ * visitNode() and visitNull() return a value-initialized RetT by default.
+ */
+template <typename Derived, typename RetT = void> class IRVisitor {
+public:
+  RetT visit(const IRNode *node) {
+    if (!node) {
+      return derived().visitNull();
+    }
+    switch (node->getType()) {
+    case IRNodeType::Loop:
+      return derived().visitLoop(static_cast<const Loop *>(node));
+    case IRNodeType::Load:
+      return derived().visitLoad(static_cast<const Load *>(node));
+    case IRNodeType::Store:
+      return derived().visitStore(static_cast<const Store *>(node));
+    case IRNodeType::Add:
+      return derived().visitAdd(static_cast<const Add *>(node));
+    case IRNodeType::Mul:
+      return derived().visitMul(static_cast<const Mul *>(node));
+    case IRNodeType::Assign:
+      return derived().visitAssign(static_cast<const Assign *>(node));
+    case IRNodeType::Const:
+      return derived().visitConst(static_cast<const Const *>(node));
+    case IRNodeType::Variable:
+      return derived().visitVariable(static_cast<const Variable *>(node));
+    case IRNodeType::Min:
+      return derived().visitMin(static_cast<const Min *>(node));
+    case IRNodeType::Div:
+      return derived().visitDiv(static_cast<const Div *>(node));
+    case IRNodeType::Block:
+      return derived().visitBlock(static_cast<const Block *>(node));
+    case IRNodeType::RecursiveNest:
+      return derived().visitRecursiveNest(
+          static_cast<const RecursiveNest *>(node));
+    case IRNodeType::CurveNest:
+      return derived().visitCurveNest(static_cast<const CurveNest *>(node));
+    }
+    return derived().visitNode(node);
+  }
+
+  RetT visitLoop(const Loop *node) { return derived().visitNode(node); }
+  RetT visitBlock(const Block *node) { return derived().visitNode(node); }
+  RetT visitRecursiveNest(const RecursiveNest *node) {
+    return derived().visitNode(node);
+  }
+  RetT visitCurveNest(const CurveNest *node) {
+    return derived().visitNode(node);
+  }
+  RetT visitLoad(const Load *node) { return derived().visitNode(node); }
+  RetT visitStore(const Store *node) { return derived().visitNode(node); }
+  RetT visitAssign(const Assign *node) { return derived().visitNode(node); }
+  RetT visitConst(const Const *node) { return derived().visitNode(node); }
+  RetT visitVariable(const Variable *node) {
+    return derived().visitNode(node);
+  }
+
+  RetT visitAdd(const Add *node) {
+    return derived().visitBinary(node, node->operand_one_, node->operand_two_);
+  }
+  RetT visitMul(const Mul *node) {
+    return derived().visitBinary(node, node->operand_one_, node->operand_two_);
+  }
+  RetT visitMin(const Min *node) {
+    return derived().visitBinary(node, node->operand_one_, node->operand_two_);
+  }
+  RetT visitDiv(const Div *node) {
+    return derived().visitBinary(node, node->operand_one_, node->operand_two_);
+  }
+
+  /**
+   * @brief Shared handler for the two-operand nodes (Add, Mul, Min, Div).
+   */
+  RetT visitBinary(const IRNode *node, const IRNode *, const IRNode *) {
+    return derived().visitNode(node);
+  }
+
+  RetT visitNode(const IRNode *) { return RetT(); }
+  RetT visitNull() { return RetT(); }
+
+protected:
+  Derived &derived() { return static_cast<Derived &>(*this); }
+};
+
+/**
+ * @brief A void visitor whose default handlers walk every child in pre-order
+ * (loop bounds and step before the body, assignment target before value).
+ * Derived handlers call the base handler to keep descending.
+ */
+template <typename Derived>
+class RecursiveIRVisitor : public IRVisitor<Derived, void> {
+public:
+  void visitLoop(const Loop *node) {
+    this->visit(node->lower_bound_);
+    this->visit(node->upper_bound_);
+    this->visit(node->step_);
+    for (const IRNode *child : node->body_) {
+      this->visit(child);
+    }
+  }
+  void visitBlock(const Block *node) {
+    for (const IRNode *child : node->body_) {
+      this->visit(child);
+    }
+  }
+  void visitRecursiveNest(const RecursiveNest *node) {
+    this->visit(node->band_);
+  }
+  void visitCurveNest(const CurveNest *node) { this->visit(node->band_); }
+  void visitLoad(const Load *node) {
+    for (const IRNode *index : node->indices_) {
+      this->visit(index);
+    }
+  }
+  void visitStore(const Store *node) {
+    for (const IRNode *index : node->indices_) {
+      this->visit(index);
+    }
+  }
+  void visitAssign(const Assign *node) {
+    this->visit(node->target_);
+    this->visit(node->value_);
+  }
+  void visitBinary(const IRNode *, const IRNode *one, const IRNode *two) {
+    this->visit(one);
+    this->visit(two);
+  }
+};
+
+// True if `sym` occurs anywhere under `node` (e.g. in a loop bound).
+class SymbolFinder : public RecursiveIRVisitor<SymbolFinder> {
+public:
+  explicit SymbolFinder(Symbol sym) : sym_(sym) {}
+
+  void visitVariable(const Variable *var) { found_ |= var->symbol_ == sym_; }
+
+  bool found_ = false;
+
+private:
+  Symbol sym_;
+};
+
+inline bool mentions(const IRNode *node, Symbol sym) {
+  SymbolFinder finder(sym);
+  finder.visit(node);
+  return finder.found_;
+}
+
+/**
+ * @brief Persistent IR-to-IR rewriter (CRTP).
+ *
+ * Each default handler rewrites the node's children and returns the original
+ * node when none of them changed, so only the spine above an actual change is
+ * rebuilt and all untouched subtrees stay shared. Expression nodes are rebuilt
+ * through the IRContext factories and are therefore hash-consed when enabled.
+ *
+ * A Derived class that defines `bool copyAll() const { return true; }`
+ * rebuilds every node instead (this is how deepCopy is implemented).
+ */
+template <typename Derived>
+class IRRewriter : public IRVisitor<Derived, IRNode *> {
+public:
+  explicit IRRewriter(IRContext &ctx) : ctx_(ctx) {}
+
+  IRNode *rewrite(const IRNode *node) { return this->visit(node); }
+
+  bool copyAll() const { return false; }
+
+  IRNode *visitConst(const Const *node) {
+    if (!this->derived().copyAll()) {
+      return self(node);
+    }
+    return ctx_.makeConst(node->value_, node->dtype_);
+  }
+
+  IRNode *visitVariable(const Variable *node) {
+    if (!this->derived().copyAll()) {
+      return self(node);
+    }
+    return ctx_.makeVariable(node->symbol_);
+  }
+
+  IRNode *visitAdd(const Add *node) {
+    IRNode *one = rewrite(node->operand_one_);
+    IRNode *two = rewrite(node->operand_two_);
+    if (unchanged(node->operand_one_, one) &&
+        unchanged(node->operand_two_, two)) {
+      return self(node);
+    }
+    return ctx_.makeAdd(one, two);
+  }
+
+  IRNode *visitMul(const Mul *node) {
+    IRNode *one = rewrite(node->operand_one_);
+    IRNode *two = rewrite(node->operand_two_);
+    if (unchanged(node->operand_one_, one) &&
+        unchanged(node->operand_two_, two)) {
+      return self(node);
+    }
+    return ctx_.makeMul(one, two);
+  }
+
+  IRNode *visitMin(const Min *node) {
+    IRNode *one = rewrite(node->operand_one_);
+    IRNode *two = rewrite(node->operand_two_);
+    if (unchanged(node->operand_one_, one) &&
+        unchanged(node->operand_two_, two)) {
+      return self(node);
+    }
+    return ctx_.makeMin(one, two);
+  }
+
+  IRNode *visitDiv(const Div *node) {
+    IRNode *one = rewrite(node->operand_one_);
+    IRNode *two = rewrite(node->operand_two_);
+    if (unchanged(node->operand_one_, one) &&
+        unchanged(node->operand_two_, two)) {
+      return self(node);
+    }
+    return ctx_.makeDiv(one, two);
+  }
+
+  IRNode *visitLoad(const Load *node) {
+    std::vector<IRNode *> indices;
+    if (!rewriteAll(node->indices_, indices)) {
+      return self(node);
+    }
+    return ctx_.create<Load>(node->tensor_, std::move(indices));
+  }
+
+  IRNode *visitStore(const Store *node) {
+    std::vector<IRNode *> indices;
+    if (!rewriteAll(node->indices_, indices)) {
+      return self(node);
+    }
+    return ctx_.create<Store>(node->tensor_, std::move(indices));
+  }
+
+  IRNode *visitAssign(const Assign *node) {
+    IRNode *target = rewrite(node->target_);
+    IRNode *value = rewrite(node->value_);
+    if (unchanged(node->target_, target) && unchanged(node->value_, value)) {
+      return self(node);
+    }
+    return ctx_.create<Assign>(target, value);
+  }
+
+  IRNode *visitLoop(const Loop *node) {
+    IRNode *lb = rewrite(node->lower_bound_);
+    IRNode *ub = rewrite(node->upper_bound_);
+    IRNode *step = rewrite(node->step_);
+    std::vector<IRNode *> body;
+    bool body_changed = rewriteAll(node->body_, body);
+    if (!body_changed && unchanged(node->lower_bound_, lb) &&
+        unchanged(node->upper_bound_, ub) && unchanged(node->step_, step)) {
+      return self(node);
+    }
+    Loop *loop = ctx_.create<Loop>(node->index_, lb, ub, step);
+    loop->body_ = std::move(body);
+    return loop;
+  }
+
+  IRNode *visitBlock(const Block *node) {
+    std::vector<IRNode *> body;
+    if (!rewriteAll(node->body_, body)) {
+      return self(node);
+    }
+    return ctx_.create<Block>(std::move(body));
+  }
+
+  IRNode *visitRecursiveNest(const RecursiveNest *node) {
+    IRNode *band = rewrite(node->band_);
+    if (unchanged(node->band_, band)) {
+      return self(node);
+    }
+    return ctx_.create<RecursiveNest>(band, node->base_sizes_);
+  }
+
+  IRNode *visitCurveNest(const CurveNest *node) {
+    IRNode *band = rewrite(node->band_);
+    if (unchanged(node->band_, band)) {
+      return self(node);
+    }
+    return ctx_.create<CurveNest>(band, node->curve_);
+  }
+
+  IRNode *visitNull() { return nullptr; }
+
+protected:
+  // Unchanged nodes are returned as-is. The visitor interface is const, but
+  // the nodes themselves are owned (mutably) by the context.
+  static IRNode *self(const IRNode *node) { return const_cast<IRNode *>(node); }
+
+  bool unchanged(const IRNode *before, const IRNode *after) {
+    return before == after && !this->derived().copyAll();
+  }
+
+  /**
+   * @brief Rewrites every node of `in` into `out`.
+   * @return true if any element changed (or copyAll() is set).
+   */
+  bool rewriteAll(const std::vector<IRNode *> &in, std::vector<IRNode *> &out) {
+    out.clear();
+    out.reserve(in.size());
+    bool changed = false;
+    for (const IRNode *node : in) {
+      out.push_back(rewrite(node));
+      changed |= !unchanged(node, out.back());
+    }
+    return changed || this->derived().copyAll();
+  }
+
+  IRContext &ctx_;
+};
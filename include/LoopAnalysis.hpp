@@ -0,0 +1,57 @@
+#pragma once
+
+#include "IR.hpp"
+#include "IRContext.hpp"
+#include <vector>
+
+/**
+ * @brief A perfectly nested chain of loops: every loop except the innermost
+ * has exactly one statement in its body, and that statement is the next loop.
+ */
+struct LoopBand {
+  std::vector<const Loop *> loops_; // Outermost first.
+
+  size_t depth() const { return loops_.size(); }
+  const Loop *outermost() const { return loops_.front(); }
+  const Loop *innermost() const { return loops_.back(); }
+};
+
+/**
+ * @brief Shape of every loop nest under a root.
+ */
+struct LoopNestInfo {
+  // Maximal bands in pre-order. A band starts at every loop that is not the
+  // only statement of its parent loop.
+  std::vector<LoopBand> bands_;
+  size_t num_loops_ = 0;
+  size_t max_depth_ = 0;
+};
+
+/**
+ * @brief One Load or Store together with the loops that enclose it.
+ */
+struct MemoryAccess {
+  const IRNode *node_ = nullptr; // The Load or Store node.
+  const Tensor *tensor_ = nullptr;
+  const std::vector<IRNode *> *indices_ = nullptr;
+  bool is_write_ = false;
+  std::vector<const Loop *> loops_; // Enclosing loops, outermost first.
+};
+
+struct AccessInfo {
+  std::vector<MemoryAccess> accesses_; // In program order.
+};
+
+// --- Analyses (see AnalysisManager in PassManager.hpp) ---
+
+struct LoopNestAnalysis {
+  using Result = LoopNestInfo;
+  static const char *name() { return "loop-nest"; }
+  static Result run(const IRContext &ctx, const IRNode *root);
+};
+
+struct AccessAnalysis {
+  using Result = AccessInfo;
+  static const char *name() { return "accesses"; }
+  static Result run(const IRContext &ctx, const IRNode *root);
+};
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "DependenceAnalysis.hpp"
+#include "IR.hpp"
+#include "IRContext.hpp"
+#include "LoopAnalysis.hpp"
+#include "PassManager.hpp"
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Memory cost of running `band` in `order` (a permutation of band
+ * positions, outermost first), compared lexicographically; lower is better.
+ *
+ * Loops are scored innermost first. Each contributes two entries: the number
+ * of accesses it walks with a stride other than the tensor's unit stride (per
+ * TensorLayout::strides_), then minus the number of loads it walks with unit
+ * stride. Accesses a loop does not move count as neither.
+ */
+std::vector<int64_t> loopOrderCost(const AccessInfo &accesses,
+                                   const std::vector<const Loop *> &band,
+                                   const std::vector<size_t> &order);
+
+/**
+ * @brief The cheapest order (see loopOrderCost) of the band rooted at `root`
+ * among those `deps` allows. Ties keep the current order.
+ * @return The identity permutation if `root` does not start a band of depth
+ * two or more.
+ */
+std::vector<size_t> selectLoopOrder(const IRContext &ctx, const IRNode *root,
+                                    const DependenceInfo &deps);
+
+/**
+ * @brief Reorders the perfect band rooted at `root` so that band position
+ * order[p] runs at depth p. Legality is not checked.
+ * @return The new root, or `root` if the order is the identity or the band
+ * cannot be reordered (too shallow, or bounds that depend on an outer band
+ * loop).
+ */
+IRNode *interchangeLoops(IRContext &ctx, IRNode *root,
+                         const std::vector<size_t> &order);
+
+/**
+ * @brief Moves the loops of the outermost band into the cheapest legal
+ * order. Run it before tiling, so that the point loops of each tile walk
+ * memory contiguously.
+ */
+class LoopInterchangePass : public Pass {
+public:
+  const char *name() const override { return "interchange"; }
+  bool run(IRContext &ctx, IRNode *&root, AnalysisManager &am) override;
+};
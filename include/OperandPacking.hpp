@@ -0,0 +1,68 @@
+#pragma once
+
+#include "IR.hpp"
+#include "IRContext.hpp"
+#include "PassManager.hpp"
+
+/**
+ * @brief Copies the tile of every read-only operand that a tiled loop nest
+ * under `root` reads into a contiguous local buffer, and makes the nest read
+ * the buffer instead.
+ *
+ * A point loop `for i = ii to min(ii + T, N)` (or `ii + T`) starts a nest.
+ * An operand X qualifies when nothing under `root` writes it and every load
+ * of X in the nest has the same subscripts, each the index of a different
+ * point loop of the nest whose bounds do not depend on the nest's other
+ * loops. Its tile is copied into a buffer Xp (see IRContext::makeBuffer) by
+ * a copy nest over the same point loops, and X[i, k] becomes
+ * Xp[k - kk, i - ii]:
+ *
+ *   for ii, kk:                     for ii, kk:
+ *     for jj:                         for i, k:
+ *       for i, k, j:                    Ap[k - kk, i - ii] = A[i, k]
+ *         C[i, j] += A[i, k] *  =>    for jj:
+ *                    B[k, j]            for k, j:
+ *                                         Bp[k - kk, j - jj] = B[k, j]
+ *                                       for i, k, j:
+ *                                         C[i, j] += Ap[k - kk, i - ii] *
+ *                                                    Bp[k - kk, j - jj]
+ *
+ * Buffers are laid out in the order a register-blocked micro-kernel (see
+ * RegisterBlockingPass) reads them. Dimensions indexed by reduction loops
+ * (point loops that no store subscript mentions) come first. The outer and
+ * inner loops that index the stores are blocked by `mr` and `nr` in the last
+ * dimension, so each k step of an mr x nr block reads mr (or nr) adjacent
+ * elements. For matmul this is the usual packed panel layout. A copy nest is
+ * hoisted out of every enclosing tile loop it does not depend on (A above
+ * jj), so each tile is packed once and reused. The copy loops read X in its
+ * own dimension order.
+ *
+ * Buffers hold one whole tile (T elements per dimension, the last one padded
+ * to a multiple of the block), aligned to 64 bytes, and are shared by nests
+ * that pack the same operand with the same shape. generateKernel keeps them
+ * on the stack up to CodeGenOptions::max_stack_bytes_ and allocates larger
+ * ones (e.g. for 512 x 512 tiles) on the heap once per call.
+ *
+ * @return The new root (a Block if copies are hoisted above the root loop),
+ * or `root` if nothing changed.
+ */
+IRNode *packOperands(IRContext &ctx, IRNode *root, unsigned mr = 1,
+                     unsigned nr = 1);
+
+/**
+ * @brief Pass wrapper around packOperands; run it after LoopTilingPass and
+ * before FullTileSplitPass (so full tiles also copy with constant trip
+ * counts) and RegisterBlockingPass (with the same mr and nr).
+ */
+class OperandPackingPass : public Pass {
+public:
+  explicit OperandPackingPass(unsigned mr = 1, unsigned nr = 1)
+      : mr_(mr), nr_(nr) {}
+
+  const char *name() const override { return "pack"; }
+  bool run(IRContext &ctx, IRNode *&root, AnalysisManager &am) override;
+
+private:
+  unsigned mr_;
+  unsigned nr_;
+};
@@ -0,0 +1,203 @@
+#pragma once
+
+#include "IR.hpp"
+#include "IRContext.hpp"
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <typeindex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Caches analysis results per IR root.
+ *
+ * An analysis is any type A with
+ *
+ *   using Result = ...;
+ *   static const char *name();
+ *   static Result run(const IRContext &ctx, const IRNode *root);
+ *
+ * get<A>(root) computes A once per root and returns the cached result on every
+ * later call with that root; results for different roots live side by side,
+ * so a reference returned for one root stays valid while another is queried.
+ * Because transforms are persistent, a pass that rewrites the IR usually hands
+ * back a new root, which misses the cache on its own; the PassManager
+ * additionally calls invalidate() whenever a pass reports a change, which
+ * covers passes that edit nodes in place. A rollback() or release() of the
+ * context drops every entry, since a later root may reuse a freed address.
+ *
+ * References returned by get() stay valid until the entry is dropped.
+ */
+class AnalysisManager {
+public:
+  explicit AnalysisManager(const IRContext &ctx)
+      : ctx_(ctx), epoch_(ctx.epoch()) {}
+
+  template <typename A> const typename A::Result &get(const IRNode *root) {
+    dropIfStale();
+    const std::type_index type(typeid(A));
+    AnalysisStats &s = stats(type, A::name());
+    auto it = cache_.find({type, root});
+    if (it != cache_.end()) {
+      ++s.hits_;
+      return *static_cast<const typename A::Result *>(it->second.get());
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    auto result = std::make_shared<typename A::Result>(A::run(ctx_, root));
+    auto end = std::chrono::steady_clock::now();
+
+    ++s.runs_;
+    s.wall_ms_ +=
+        std::chrono::duration<double, std::milli>(end - start).count();
+
+    cache_.emplace(Key{type, root}, result);
+    return *result;
+  }
+
+  /**
+   * @brief Returns true if A is cached for `root`.
+   */
+  template <typename A> bool cached(const IRNode *root) const {
+    return ctx_.epoch() == epoch_ &&
+           cache_.count({std::type_index(typeid(A)), root}) != 0;
+  }
+
+  // Drops every cached result of A.
+  template <typename A> void invalidate() {
+    const std::type_index type(typeid(A));
+    for (auto it = cache_.begin(); it != cache_.end();) {
+      it = it->first.first == type ? cache_.erase(it) : std::next(it);
+    }
+  }
+
+  // Drops every cached result (statistics are kept).
+  void invalidate();
+
+  struct AnalysisStats {
+    std::string name_;
+    size_t runs_ = 0;
+    size_t hits_ = 0;
+    double wall_ms_ = 0.0;
+  };
+
+  const std::vector<AnalysisStats> &stats() const { return stats_; }
+
+private:
+  using Key = std::pair<std::type_index, const IRNode *>;
+
+  struct KeyHash {
+    size_t operator()(const Key &k) const {
+      return k.first.hash_code() * 31 +
+             std::hash<const IRNode *>()(k.second);
+    }
+  };
+
+  // Clears the cache if the context rolled back or released nodes since the
+  // entries were made.
+  void dropIfStale() {
+    if (ctx_.epoch() != epoch_) {
+      cache_.clear();
+      epoch_ = ctx_.epoch();
+    }
+  }
+
+  AnalysisStats &stats(std::type_index type, const char *name) {
+    auto [it, inserted] = stats_index_.try_emplace(type, stats_.size());
+    if (inserted) {
+      stats_.push_back({name});
+    }
+    return stats_[it->second];
+  }
+
+  const IRContext &ctx_;
+  uint64_t epoch_;
+  std::unordered_map<Key, std::shared_ptr<void>, KeyHash> cache_;
+  std::unordered_map<std::type_index, size_t> stats_index_;
+  std::vector<AnalysisStats> stats_;
+};
+
+/**
+ * @brief A transformation over a whole IR tree.
+ */
+class Pass {
+public:
+  virtual ~Pass() = default;
+
+  virtual const char *name() const = 0;
+
+  /**
+   * @brief Runs the pass. The pass may replace `root` (persistent rewrite) or
+   * edit nodes in place, and must return true iff the IR changed.
+   */
+  virtual bool run(IRContext &ctx, IRNode *&root, AnalysisManager &am) = 0;
+};
+
+/**
+ * @brief Adapts a persistent transform `IRNode *f(IRContext &, IRNode *)` such
+ * as tilingPass. The IR is considered changed when f returns a different root.
+ */
+class RewritePass : public Pass {
+public:
+  using Transform = std::function<IRNode *(IRContext &, IRNode *)>;
+
+  RewritePass(std::string name, Transform transform)
+      : name_(std::move(name)), transform_(std::move(transform)) {}
+
+  const char *name() const override { return name_.c_str(); }
+  bool run(IRContext &ctx, IRNode *&root, AnalysisManager &am) override;
+
+private:
+  std::string name_;
+  Transform transform_;
+};
+
+/**
+ * @brief Runs a sequence of passes over one IR root, sharing a single
+ * AnalysisManager, and records each pass's wall time and allocations.
+ */
+class PassManager {
+public:
+  explicit PassManager(IRContext &ctx) : ctx_(ctx), analyses_(ctx) {}
+
+  void add(std::unique_ptr<Pass> pass) { passes_.push_back(std::move(pass)); }
+
+  template <typename P, typename... Args> P &add(Args &&...args) {
+    auto pass = std::make_unique<P>(std::forward<Args>(args)...);
+    P &ref = *pass;
+    passes_.push_back(std::move(pass));
+    return ref;
+  }
+
+  /**
+   * @brief Runs every registered pass in order.
+   * @return The final root.
+   */
+  IRNode *run(IRNode *root);
+
+  struct PassStats {
+    std::string name_;
+    double wall_ms_ = 0.0;
+    size_t nodes_allocated_ = 0; // IR nodes created by the pass.
+    size_t bytes_allocated_ = 0; // Arena bytes used by those nodes.
+    bool changed_ = false;
+  };
+
+  const std::vector<PassStats> &stats() const { return stats_; }
+  AnalysisManager &analyses() { return analyses_; }
+
+  // Prints one line per pass run and per analysis.
+  void printReport(std::ostream &os) const;
+
+private:
+  IRContext &ctx_;
+  AnalysisManager analyses_;
+  std::vector<std::unique_ptr<Pass>> passes_;
+  std::vector<PassStats> stats_;
+};
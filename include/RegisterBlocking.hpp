@@ -0,0 +1,65 @@
+#pragma once
+
+#include "DependenceAnalysis.hpp"
+#include "IR.hpp"
+#include "IRContext.hpp"
+#include "PassManager.hpp"
+
+/**
+ * @brief Turns every innermost 3-loop reduction nest under `root` into an
+ * `mr` x `nr` register block.
+ *
+ * A nest of three perfectly nested loops (in any order) whose body is one
+ * update `X[f(p, q)] = X[f(p, q)] op y`, where exactly one of the loops (k)
+ * does not appear in the subscripts of X, becomes
+ *
+ *   for p = lb_p to E_p step mr * s_p
+ *     for q = lb_q to E_q step nr * s_q
+ *       x_r_c = X[f(p + r * s_p, q + c * s_q)]          // mr * nr times
+ *       for k = ...
+ *         x_r_c = x_r_c op y[p + r * s_p, q + c * s_q]  // mr * nr times
+ *       X[f(p + r * s_p, q + c * s_q)] = x_r_c          // mr * nr times
+ *   for p = lb_p to E_p step s_p                        // columns past E_q
+ *     for q = E_q to ub_q step s_q
+ *       for k = ...
+ *         <original body>
+ *   for p = E_p to ub_p step s_p                        // rows past E_p
+ *     for q = lb_q to ub_q step s_q
+ *       for k = ...
+ *         <original body>
+ *
+ * where p is the outer of the two loops that index X and E is the end of the
+ * whole blocks (see alignedEnd). The accumulators x_r_c are scalar locals
+ * (see KernelTypes::locals_) that stay in registers across the k loop, so
+ * X is loaded and stored once per block instead of once per k iteration,
+ * and each operand load feeds up to mr (or nr) updates. The remainder loops
+ * are dropped when the trip counts are known multiples of the block.
+ *
+ * A nest is left unchanged unless p and q have positive constant steps, no
+ * loop bound depends on another loop of the nest, every block element maps
+ * to a distinct element of X (some subscript depends on p but not q and
+ * another on q but not p), y does not read X, at least one whole block fits
+ * and `deps` shows the nest is fully permutable.
+ *
+ * @return The new root (a Block if the root nest itself is split), or `root`
+ * if nothing changed.
+ */
+IRNode *registerBlock(IRContext &ctx, IRNode *root, unsigned mr, unsigned nr,
+                      const DependenceInfo &deps);
+
+/**
+ * @brief Pass wrapper around registerBlock; run it last among the loop
+ * transformations (after LoopTilingPass and FullTileSplitPass), since loops
+ * around the accumulators can no longer be reordered.
+ */
+class RegisterBlockingPass : public Pass {
+public:
+  RegisterBlockingPass(unsigned mr, unsigned nr) : mr_(mr), nr_(nr) {}
+
+  const char *name() const override { return "register-block"; }
+  bool run(IRContext &ctx, IRNode *&root, AnalysisManager &am) override;
+
+private:
+  unsigned mr_;
+  unsigned nr_;
+};
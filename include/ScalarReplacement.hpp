@@ -0,0 +1,38 @@
+#pragma once
+
+#include "IR.hpp"
+#include "IRContext.hpp"
+#include "PassManager.hpp"
+
+/**
+ * @brief Keeps tensor elements that every innermost loop under `root` reads
+ * and writes at a fixed position in scalar locals.
+ *
+ * An element X[f] qualifies when the innermost loop both loads and stores it,
+ * f does not depend on the loop's index, and the loop's body touches X
+ * nowhere else. Then
+ *
+ *   for k = ...                      x = X[f]
+ *     X[f] = X[f] + y[k]      =>     for k = ...
+ *                                      x = x + y[k]
+ *                                    X[f] = x
+ *
+ * which removes a load and a store per iteration (in matmul with k
+ * innermost, one of each per multiply-add). The local x (see
+ * KernelTypes::locals_) is shared by every loop replacing an element of X.
+ * If the loop runs no iterations, X[f] is read and written back unchanged.
+ *
+ * @return The new root (a Block if the root loop itself is replaced), or
+ * `root` if nothing changed.
+ */
+IRNode *scalarReplace(IRContext &ctx, IRNode *root);
+
+/**
+ * @brief Pass wrapper around scalarReplace; run it after the loop
+ * transformations, since loops around the locals can no longer be reordered.
+ */
+class ScalarReplacementPass : public Pass {
+public:
+  const char *name() const override { return "scalar-replace"; }
+  bool run(IRContext &ctx, IRNode *&root, AnalysisManager &am) override;
+};
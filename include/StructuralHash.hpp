@@ -0,0 +1,37 @@
+#pragma once
+
+#include "IR.hpp"
+#include "IRContext.hpp"
+#include <cstdint>
+
+/**
+ * @brief Returns a stable 64-bit hash of the structure of an IR subtree.
+ *
+ * The hash depends only on node kinds, constant values, symbol *names* and
+ * tensor name/dtype/extents, never on pointers or Symbol IDs, so the same
+ * kernel hashes identically across contexts, runs and machines. It is suitable
+ * as a key for JIT caches and tuning databases.
+ *
+ * Each node's hash is computed from its children's hashes and cached on the
+ * node, so rehashing a tree that shares subtrees with an already hashed one
+ * only visits the new nodes.
+ *
+ * @param ctx The context owning the subtree (used to resolve symbol names).
+ * @param node The root of the subtree. nullptr hashes to a fixed value.
+ */
+uint64_t structuralHash(const IRContext &ctx, const IRNode *node);
+
+/**
+ * @brief Deep structural equality of two subtrees owned by the same context.
+ *
+ * Shared (e.g. hash-consed) subtrees compare equal by pointer, and subtrees
+ * whose cached hashes differ are rejected without being walked.
+ */
+bool structurallyEqual(const IRContext &ctx, const IRNode *a, const IRNode *b);
+
+/**
+ * @brief Deep structural equality of two subtrees owned by different contexts.
+ * Symbols are compared by name rather than by ID.
+ */
+bool structurallyEqual(const IRContext &ctx_a, const IRNode *a,
+                       const IRContext &ctx_b, const IRNode *b);
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Dense integer ID of an interned name (loop index or Variable).
+ */
+using Symbol = uint32_t;
+
+/**
+ * @brief Interns names to dense Symbol IDs. Both directions are O(1): names
+ * hash to their ID, and IDs index straight into the name list.
+ */
+class SymbolTable {
+public:
+  /**
+   * @brief Returns the Symbol for `name`, interning it on first use.
+   */
+  Symbol intern(const std::string &name);
+
+  /**
+   * @brief Returns a Symbol whose name has never been interned before. The
+   * name is `hint` itself if that is free, otherwise `hint` plus a numeric
+   * suffix.
+   */
+  Symbol fresh(const std::string &hint);
+
+  /**
+   * @brief Returns the Symbol for `name` if it has been interned.
+   */
+  std::optional<Symbol> lookup(const std::string &name) const;
+
+  const std::string &name(Symbol sym) const { return names_[sym]; }
+  size_t size() const { return names_.size(); }
+
+  void clear();
+
+private:
+  std::vector<std::string> names_;
+  std::unordered_map<std::string, Symbol> ids_;
+  std::unordered_map<std::string, unsigned> next_suffix_;
+};
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * @brief Maps a tensor's logical indices to element offsets from its base
+ * pointer.
+ *
+ * Unblocked layouts are a plain stride per dimension, which covers packed and
+ * padded row-major, column-major and arbitrary strided views. A blocked
+ * (tile-major) layout stores the tensor as contiguous blocks of `block_`
+ * elements: element (i0, ..., in) lives at
+ *
+ *   sum_d (i_d / block_d) * block_strides_d + (i_d % block_d) * strides_d
+ *
+ * where `strides_` are the row-major strides inside one block and blocks are
+ * themselves laid out row-major.
+ */
+class TensorLayout {
+public:
+  TensorLayout() = default;
+
+  /**
+   * @brief Row-major layout. A non-zero `pitch` pads each innermost row to
+   * `pitch` elements (the leading dimension in BLAS terms).
+   * @param alignment Guaranteed base-address alignment in bytes (0: none
+   * beyond the element type).
+   */
+  static TensorLayout rowMajor(const std::vector<size_t> &extents,
+                               size_t pitch = 0, size_t alignment = 0);
+
+  /**
+   * @brief Column-major layout. A non-zero `pitch` pads each column.
+   */
+  static TensorLayout columnMajor(const std::vector<size_t> &extents,
+                                  size_t pitch = 0, size_t alignment = 0);
+
+  /**
+   * @brief Explicit per-dimension element strides.
+   */
+  static TensorLayout strided(const std::vector<size_t> &extents,
+                              const std::vector<size_t> &strides,
+                              size_t alignment = 0);
+
+  /**
+   * @brief Tile-major layout with blocks of `block` elements. Extents need
+   * not be multiples of the block; the last block of each dimension is padded.
+   */
+  static TensorLayout blocked(const std::vector<size_t> &extents,
+                              const std::vector<size_t> &block,
+                              size_t alignment = 0);
+
+  size_t dims() const { return strides_.size(); }
+  bool isBlocked() const { return !block_.empty(); }
+
+  // Block extent of dimension d, or 0 if the layout is not blocked.
+  size_t blockExtent(size_t d) const { return isBlocked() ? block_[d] : 0; }
+
+  /**
+   * @brief Element offset of a logical index.
+   */
+  size_t offset(const std::vector<size_t> &index) const;
+
+  bool operator==(const TensorLayout &other) const {
+    return strides_ == other.strides_ && block_ == other.block_ &&
+           block_strides_ == other.block_strides_ && size_ == other.size_ &&
+           alignment_ == other.alignment_;
+  }
+  bool operator!=(const TensorLayout &other) const {
+    return !(*this == other);
+  }
+
+  std::vector<size_t> strides_;       // Per dimension (inside a block).
+  std::vector<size_t> block_;         // Block extents; empty if unblocked.
+  std::vector<size_t> block_strides_; // Distance between adjacent blocks.
+  size_t size_ = 0;      // Elements to allocate, including all padding.
+  size_t alignment_ = 0; // Base-address alignment in bytes (0: none).
+};
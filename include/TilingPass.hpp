@@ -1,8 +1,206 @@
 #pragma once
 
 #include "IR.hpp"
-#include <memory>
+#include "IRContext.hpp"
+#include "PassManager.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
 
-std::unique_ptr<IRNode> deepCopy(const IRNode *nd);
+IRNode *deepCopy(IRContext &ctx, const IRNode *nd);
 
-std::unique_ptr<IRNode> tilingPass(IRNode *nd);
\ No newline at end of file
+IRNode *shallowCopy(IRContext &ctx, const IRNode *nd);
+
+/**
+ * @brief Outcome of a tiling transform. On failure `root_` is the unchanged
+ * input and `diagnostic_` explains why the band could not be tiled.
+ */
+struct TilingResult {
+  IRNode *root_ = nullptr;
+  bool ok_ = false;
+  std::string diagnostic_;
+
+  explicit operator bool() const { return ok_; }
+};
+
+/**
+ * @brief One level of a tiling hierarchy (e.g. an L2 block).
+ */
+struct TileLevel {
+  // Used to name the level's tile indices (i -> i_L2); empty gives ii.
+  std::string name_;
+  // Tile size per band loop, outermost first; 0 or 1 (or missing) leaves the
+  // loop untiled at this level.
+  std::vector<int64_t> sizes_;
+  // Order of this level's tile loops as a permutation of band positions,
+  // outermost first; empty keeps the band order.
+  std::vector<size_t> order_;
+  // Visits the tiles of this level's two outermost tile loops along a
+  // space-filling curve (see CurveNest) instead of row by row.
+  CurveOrder curve_ = CurveOrder::RowMajor;
+};
+
+/**
+ * @brief Tiles the outermost `tile_sizes.size()` loops of the perfect band
+ * rooted at `root`.
+ *
+ * Loop d with tile size T > 1 becomes a tile loop over fresh index dd (step
+ * T) and a point loop d = dd .. min(dd + T, ub). All tile loops are placed
+ * outside all point loops, in band order. A tile size of 0 or 1 leaves that
+ * loop untiled. Bounds and bodies are shared with the input.
+ *
+ * The band is rejected (with a diagnostic) if `root` is not a loop, the band
+ * is shallower than `tile_sizes`, a tiled loop has a non-constant step or a
+ * tile size that is not a multiple of it, or a loop's bounds depend on an
+ * outer loop of the band (non-rectangular iteration space). Dependences are
+ * not checked; LoopTilingPass and tilingPass do.
+ */
+TilingResult tileBand(IRContext &ctx, IRNode *root,
+                      const std::vector<int64_t> &tile_sizes);
+
+/**
+ * @brief Multi-level tiling of the perfect band rooted at `root`.
+ *
+ * `levels` go from coarsest to finest (e.g. L3 panel, L2 block, L1 tile,
+ * register tile). Each level contributes one tile loop per loop it tiles, in
+ * its own order, nested inside the coarser levels; the point loops come last
+ * in `point_order`. At every level a loop runs over [t, min(t + S, E)),
+ * where t and S belong to the nearest coarser level tiling the same loop and
+ * E is the end of that level's tile loop. E is the loop's upper bound when
+ * each size divides the next coarser one; otherwise it also stops at the end
+ * of the coarser tile, so sizes need not divide each other.
+ *
+ * A level with a Morton or Hilbert curve_ wraps its two outermost tile loops
+ * in a CurveNest, so consecutive tiles are neighbors in both dimensions and
+ * share more of the data they touch. Tiles visited along a curve are not
+ * split by FullTileSplitPass.
+ *
+ * Tiling and reordering are only legal if the band is fully permutable;
+ * this is not checked here (see DependenceInfo::isTilable). The same
+ * diagnostics as the single-level overload apply, plus one for orders that
+ * are not permutations of the band and one for curves over fewer than two
+ * tile loops.
+ */
+TilingResult tileBand(IRContext &ctx, IRNode *root,
+                      const std::vector<TileLevel> &levels,
+                      const std::vector<size_t> &point_order = {});
+
+/**
+ * @brief Default tile sizes for the outermost `depth` loops of the band at
+ * `root`: the block extent of any blocked tensor dimension a loop addresses
+ * directly, otherwise the sizes the cache model picks for the host's L1 (see
+ * selectTileSizes in CacheModel.hpp). The result depends on the machine and
+ * is memoized in `ctx` per band structure and cache level (see
+ * IRContext::memoize), so repeated calls on the same kernel shape skip the
+ * search.
+ */
+std::vector<int64_t> defaultTileSizes(const IRContext &ctx, const IRNode *root,
+                                      size_t depth);
+
+/**
+ * @brief Cache-oblivious tiling of the outermost `base_sizes.size()` loops of
+ * the perfect band rooted at `root`.
+ *
+ * Wraps the band in a RecursiveNest: the generated kernel halves the loop
+ * with the most iterations left until each loop runs at most its base size,
+ * then runs the unchanged band over that box (see CodeGenerator.cpp). Each
+ * level of the recursion works on a box half the size of the one above, so
+ * some level fits every cache without knowing its capacity.
+ *
+ * The same diagnostics as tileBand apply; base sizes must be positive
+ * multiples of their loop's step. Dependences are not checked here (see
+ * DependenceInfo::isTilable).
+ */
+TilingResult recursiveTileBand(IRContext &ctx, IRNode *root,
+                               const std::vector<int64_t> &base_sizes);
+
+// Base size per loop of the recursive mode when none is given. The base case
+// only has to amortize the recursion and leave the inner loop long enough to
+// vectorize; the caches are taken care of by the levels above it.
+constexpr int64_t kRecursiveBaseSize = 32;
+
+// Tile size tilingPass gives a loop the cache model leaves untiled (0) when
+// the tiles are visited along a curve, which needs two tile loops.
+constexpr int64_t kCurveTileSize = 32;
+
+enum class TilingMode {
+  Fixed,     // Tile loops with fixed sizes (tileBand)
+  Recursive, // Recursive bisection down to a base size (recursiveTileBand)
+};
+
+/**
+ * @brief Performs 2D loop tiling (i, j) -> (ii, jj, i, j) with the default
+ * tile sizes, visiting the (ii, jj) tiles in `curve` order, or with
+ * TilingMode::Recursive wraps (i, j) in a recursive bisection with
+ * kRecursiveBaseSize base cases (`curve` does not apply). With a Morton or
+ * Hilbert curve, a loop the default sizes leave untiled is tiled by
+ * kCurveTileSize instead, so the curve works whatever the host's caches.
+ * @throws std::invalid_argument with the tileBand diagnostic if the input is
+ * not a tileable 2-deep band, or if its dependences forbid tiling it.
+ */
+IRNode *tilingPass(IRContext &ctx, IRNode *nd,
+                   TilingMode mode = TilingMode::Fixed,
+                   CurveOrder curve = CurveOrder::RowMajor);
+
+/**
+ * @brief Pass wrapper around tileBand (or recursiveTileBand in recursive
+ * mode). With no tile sizes it tiles the two outermost loops with
+ * defaultTileSizes. Leaves the IR unchanged (and keeps
+ * the diagnostic) when the band is not tileable, including when the
+ * DependenceAnalysis shows the tiled loops are not fully permutable.
+ */
+class LoopTilingPass : public Pass {
+public:
+  LoopTilingPass() = default;
+
+  explicit LoopTilingPass(std::vector<int64_t> tile_sizes)
+      : levels_{TileLevel{"", std::move(tile_sizes), {}}} {}
+
+  explicit LoopTilingPass(std::vector<TileLevel> levels,
+                          std::vector<size_t> point_order = {})
+      : levels_(std::move(levels)), point_order_(std::move(point_order)) {}
+
+  // With TilingMode::Recursive the sizes are base sizes (none: the two
+  // outermost loops with kRecursiveBaseSize).
+  explicit LoopTilingPass(TilingMode mode, std::vector<int64_t> sizes = {})
+      : mode_(mode) {
+    if (!sizes.empty()) {
+      levels_.push_back({"", std::move(sizes), {}});
+    }
+  }
+
+  const char *name() const override { return "tile"; }
+  bool run(IRContext &ctx, IRNode *&root, AnalysisManager &am) override;
+
+  const std::string &diagnostic() const { return diagnostic_; }
+
+private:
+  std::vector<TileLevel> levels_;
+  std::vector<size_t> point_order_;
+  TilingMode mode_ = TilingMode::Fixed;
+  std::string diagnostic_;
+};
+
+/**
+ * @brief Separates full tiles from boundary tiles (index-set splitting).
+ *
+ * Every tile loop `for t = lb to ub step S` whose point loops run over
+ * `[t, min(t + S, X))` with ub <= X is split into a full-tile loop up to
+ * E = lb + (ub - lb) / S * S, whose point loops become `[t, t + S)` with a
+ * constant trip count and no min, and a remainder loop from E to ub that
+ * keeps the original bounds and runs at most once. Works on the output of
+ * both tileBand overloads, for any number of tiled loops and levels.
+ *
+ * @return The new root (a Block if the root loop itself is split), or
+ * `root` if nothing was split.
+ */
+IRNode *splitFullTiles(IRContext &ctx, IRNode *root);
+
+/**
+ * @brief Pass wrapper around splitFullTiles; run it after LoopTilingPass.
+ */
+class FullTileSplitPass : public Pass {
+public:
+  const char *name() const override { return "split-tiles"; }
+  bool run(IRContext &ctx, IRNode *&root, AnalysisManager &am) override;
+};
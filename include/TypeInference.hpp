@@ -0,0 +1,88 @@
+#pragma once
+
+#include "IR.hpp"
+#include "IRContext.hpp"
+#include "PassManager.hpp"
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Types derived for one kernel.
+ */
+struct KernelTypes {
+  // Type of loop counters, size parameters and all index arithmetic.
+  DType index_type_ = DType::Int32;
+
+  // Value type of every expression node reachable from the root. Index
+  // expressions have index_type_; values are promoted from tensor dtypes and
+  // constants (Int32 < Int64 < Float32 < Float64).
+  std::unordered_map<const IRNode *, DType> types_;
+
+  // Tensors accessed by the kernel, sorted by name.
+  std::vector<const Tensor *> tensors_;
+
+  // Symbols used but not bound by any enclosing loop (e.g. N, M), sorted by
+  // name. They become kernel parameters of type index_type_.
+  std::vector<Symbol> params_;
+
+  // Scalar locals: variables that are assigned to (e.g. the accumulators of a
+  // register block), in order of first assignment, with the promoted type of
+  // the values assigned to them. Codegen declares them at the kernel's top.
+  std::vector<std::pair<Symbol, DType>> locals_;
+
+  DType typeOf(const IRNode *node) const {
+    auto it = types_.find(node);
+    return it != types_.end() ? it->second : index_type_;
+  }
+
+  std::optional<DType> localType(Symbol sym) const {
+    for (const auto &[local, dtype] : locals_) {
+      if (local == sym) {
+        return dtype;
+      }
+    }
+    return std::nullopt;
+  }
+};
+
+/**
+ * @brief Infers index and value types for the kernel rooted at `root`.
+ *
+ * 32-bit index arithmetic is chosen when the largest element offset of any
+ * accessed tensor (its layout size, padding included) plus the largest index
+ * constant fits in int32; otherwise indices are 64-bit. This assumes accesses
+ * stay in bounds, so every index is bounded by the extents it addresses.
+ */
+struct TypeAnalysis {
+  using Result = KernelTypes;
+  static const char *name() { return "types"; }
+  static Result run(const IRContext &ctx, const IRNode *root);
+};
+
+/**
+ * @brief Promotion order used for mixed-type arithmetic.
+ */
+DType promoteTypes(DType a, DType b);
+
+/**
+ * @brief The C++ spelling of a DType.
+ */
+const char *cTypeName(DType dtype);
+
+/**
+ * @brief Size of one element of a DType in bytes.
+ */
+size_t dtypeSize(DType dtype);
+
+/**
+ * @brief Retypes constants to match the inferred types: index constants take
+ * the index type and value constants take the type of the expression they
+ * appear in, so no implicit conversions are left for codegen.
+ */
+class TypeInferencePass : public Pass {
+public:
+  const char *name() const override { return "type-inference"; }
+  bool run(IRContext &ctx, IRNode *&root, AnalysisManager &am) override;
+};
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "DependenceAnalysis.hpp"
+#include "IR.hpp"
+#include "IRContext.hpp"
+#include "PassManager.hpp"
+#include <string>
+
+/**
+ * @brief Unroll-and-jam of every selected loop under `root` by `factor`.
+ *
+ * A selected loop `for x = lb to ub step s` over a perfect chain of inner
+ * loops becomes
+ *
+ *   for x = lb to E step s * factor      // E = lb + (ub - lb) / (s * factor)
+ *     <inner loops>                      //       * (s * factor)
+ *       body[x]; body[x + s]; ...; body[x + (factor - 1) * s]
+ *   for x = E to ub step s               // epilogue, < factor iterations
+ *     <inner loops>
+ *       body[x]
+ *
+ * so the copies share the inner loops and every value they load in common
+ * (e.g. B[k, j] across i in matmul) is loaded once per inner iteration. The
+ * epilogue is dropped when the trip count is a known multiple of the factor.
+ *
+ * With an empty `index`, the loops selected are those whose body is a single
+ * innermost loop (the outer point loop of a 2D tile). Otherwise every loop
+ * with that index is selected. A selected loop is left unchanged unless it
+ * has a positive constant step, the loops it is jammed into do not depend on
+ * it in their bounds, and `deps` allows moving it below them.
+ *
+ * @return The new root (a Block if the root loop itself is split), or `root`
+ * if nothing changed.
+ */
+IRNode *unrollAndJam(IRContext &ctx, IRNode *root, unsigned factor,
+                     const DependenceInfo &deps, const std::string &index = "");
+
+/**
+ * @brief Pass wrapper around unrollAndJam; run it after LoopTilingPass (and
+ * FullTileSplitPass, so that full tiles need no epilogue).
+ */
+class UnrollAndJamPass : public Pass {
+public:
+  explicit UnrollAndJamPass(unsigned factor, std::string index = "")
+      : factor_(factor), index_(std::move(index)) {}
+
+  const char *name() const override { return "unroll-jam"; }
+  bool run(IRContext &ctx, IRNode *&root, AnalysisManager &am) override;
+
+private:
+  unsigned factor_;
+  std::string index_;
+};
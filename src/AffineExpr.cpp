@@ -0,0 +1,349 @@
+#include "AffineExpr.hpp"
+#include "IRVisitor.hpp"
+#include "StructuralHash.hpp"
+#include <algorithm>
+#include <limits>
+
+// --- AffineExpr ---
+
+AffineExpr AffineExpr::symbol(Symbol sym, int64_t coefficient) {
+  AffineExpr e;
+  if (coefficient != 0) {
+    e.terms_.emplace_back(sym, coefficient);
+  }
+  return e;
+}
+
+int64_t AffineExpr::coefficient(Symbol sym) const {
+  auto it = std::lower_bound(
+      terms_.begin(), terms_.end(), sym,
+      [](const Term &term, Symbol s) { return term.first < s; });
+  return it != terms_.end() && it->first == sym ? it->second : 0;
+}
+
+AffineExpr AffineExpr::combine(const AffineExpr &a, const AffineExpr &b,
+                               int64_t scale) {
+  AffineExpr out(a.constant_ + scale * b.constant_);
+  out.terms_.reserve(a.terms_.size() + b.terms_.size());
+
+  auto ia = a.terms_.begin();
+  auto ib = b.terms_.begin();
+  while (ia != a.terms_.end() || ib != b.terms_.end()) {
+    if (ib == b.terms_.end() ||
+        (ia != a.terms_.end() && ia->first < ib->first)) {
+      out.terms_.push_back(*ia++);
+    } else if (ia == a.terms_.end() || ib->first < ia->first) {
+      out.terms_.emplace_back(ib->first, scale * ib->second);
+      ++ib;
+    } else {
+      int64_t c = ia->second + scale * ib->second;
+      if (c != 0) {
+        out.terms_.emplace_back(ia->first, c);
+      }
+      ++ia;
+      ++ib;
+    }
+  }
+  return out;
+}
+
+AffineExpr AffineExpr::operator+(const AffineExpr &other) const {
+  return combine(*this, other, 1);
+}
+
+AffineExpr AffineExpr::operator-(const AffineExpr &other) const {
+  return combine(*this, other, -1);
+}
+
+AffineExpr AffineExpr::operator*(int64_t factor) const {
+  if (factor == 0) {
+    return AffineExpr();
+  }
+  AffineExpr out(constant_ * factor);
+  out.terms_ = terms_;
+  for (Term &term : out.terms_) {
+    term.second *= factor;
+  }
+  return out;
+}
+
+AffineExpr AffineExpr::substitute(Symbol sym, const AffineExpr &value) const {
+  int64_t c = coefficient(sym);
+  if (c == 0) {
+    return *this;
+  }
+  return combine(*this - AffineExpr::symbol(sym, c), value, c);
+}
+
+std::string AffineExpr::toString(const IRContext &ctx) const {
+  std::string s;
+  auto append = [&s](int64_t c, const std::string &atom) {
+    if (s.empty()) {
+      s += c < 0 ? "-" : "";
+    } else {
+      s += c < 0 ? " - " : " + ";
+    }
+    uint64_t magnitude = c < 0 ? 0 - static_cast<uint64_t>(c) : c;
+    if (atom.empty()) {
+      s += std::to_string(magnitude);
+    } else if (magnitude == 1) {
+      s += atom;
+    } else {
+      s += std::to_string(magnitude) + "*" + atom;
+    }
+  };
+  for (const Term &term : terms_) {
+    append(term.second, ctx.name(term.first));
+  }
+  if (constant_ != 0 || terms_.empty()) {
+    append(constant_, "");
+  }
+  return s;
+}
+
+// --- Conversion to and from IR ---
+
+std::optional<AffineExpr> toAffine(const IRNode *node) {
+  if (!node) {
+    return std::nullopt;
+  }
+  switch (node->getType()) {
+  case IRNodeType::Const: {
+    const ConstValue &value = static_cast<const Const *>(node)->value_;
+    if (const int *v = std::get_if<int>(&value)) {
+      return AffineExpr(*v);
+    }
+    if (const long long *v = std::get_if<long long>(&value)) {
+      return AffineExpr(*v);
+    }
+    return std::nullopt;
+  }
+  case IRNodeType::Variable:
+    return AffineExpr::symbol(static_cast<const Variable *>(node)->symbol_);
+  case IRNodeType::Add: {
+    const Add *add = static_cast<const Add *>(node);
+    std::optional<AffineExpr> one = toAffine(add->operand_one_);
+    if (!one) {
+      return std::nullopt;
+    }
+    std::optional<AffineExpr> two = toAffine(add->operand_two_);
+    if (!two) {
+      return std::nullopt;
+    }
+    return *one + *two;
+  }
+  case IRNodeType::Mul: {
+    // Affine only if at least one side is a constant
+    const Mul *mul = static_cast<const Mul *>(node);
+    std::optional<AffineExpr> one = toAffine(mul->operand_one_);
+    if (!one) {
+      return std::nullopt;
+    }
+    std::optional<AffineExpr> two = toAffine(mul->operand_two_);
+    if (!two) {
+      return std::nullopt;
+    }
+    if (one->isConstant()) {
+      return *two * one->constant();
+    }
+    if (two->isConstant()) {
+      return *one * two->constant();
+    }
+    return std::nullopt;
+  }
+  case IRNodeType::Div: {
+    // Only a quotient of two constants is affine
+    const Div *div = static_cast<const Div *>(node);
+    std::optional<AffineExpr> one = toAffine(div->operand_one_);
+    std::optional<AffineExpr> two = toAffine(div->operand_two_);
+    if (one && two && one->isConstant() && two->isConstant() &&
+        two->constant() != 0) {
+      return AffineExpr(one->constant() / two->constant());
+    }
+    return std::nullopt;
+  }
+  default:
+    return std::nullopt;
+  }
+}
+
+namespace {
+
+IRNode *makeIntConst(IRContext &ctx, int64_t value) {
+  if (value >= std::numeric_limits<int>::min() &&
+      value <= std::numeric_limits<int>::max()) {
+    return ctx.makeConst(ConstValue(static_cast<int>(value)), DType::Int32);
+  }
+  return ctx.makeConst(ConstValue(static_cast<long long>(value)),
+                       DType::Int64);
+}
+
+} // namespace
+
+IRNode *fromAffine(IRContext &ctx, const AffineExpr &expr) {
+  IRNode *result = nullptr;
+  for (const AffineExpr::Term &term : expr.terms()) {
+    IRNode *t = ctx.makeVariable(term.first);
+    if (term.second != 1) {
+      t = ctx.makeMul(t, makeIntConst(ctx, term.second));
+    }
+    result = result ? ctx.makeAdd(result, t) : t;
+  }
+  if (expr.constant() != 0 || !result) {
+    IRNode *c = makeIntConst(ctx, expr.constant());
+    result = result ? ctx.makeAdd(result, c) : c;
+  }
+  return result;
+}
+
+// --- Simplification ---
+
+namespace {
+
+class ExprSimplifier : public IRRewriter<ExprSimplifier> {
+public:
+  using IRRewriter::IRRewriter;
+
+  IRNode *visitAdd(const Add *node) {
+    if (IRNode *canonical = canonicalize(node)) {
+      return canonical;
+    }
+    return IRRewriter::visitAdd(node);
+  }
+
+  IRNode *visitMul(const Mul *node) {
+    if (IRNode *canonical = canonicalize(node)) {
+      return canonical;
+    }
+    return IRRewriter::visitMul(node);
+  }
+
+  IRNode *visitDiv(const Div *node) {
+    if (IRNode *canonical = canonicalize(node)) {
+      return canonical;
+    }
+    IRNode *one = rewrite(node->operand_one_);
+    IRNode *two = rewrite(node->operand_two_);
+    // x / 1 == x
+    std::optional<AffineExpr> b = toAffine(two);
+    if (b && b->isConstant() && b->constant() == 1) {
+      return one;
+    }
+    if (unchanged(node->operand_one_, one) &&
+        unchanged(node->operand_two_, two)) {
+      return self(node);
+    }
+    return ctx_.makeDiv(one, two);
+  }
+
+  IRNode *visitMin(const Min *node) {
+    IRNode *one = rewrite(node->operand_one_);
+    IRNode *two = rewrite(node->operand_two_);
+
+    // min(a, b) is decidable when a - b is a constant
+    std::optional<AffineExpr> a = toAffine(one);
+    std::optional<AffineExpr> b = toAffine(two);
+    if (a && b) {
+      AffineExpr diff = *a - *b;
+      if (diff.isConstant()) {
+        return diff.constant() <= 0 ? one : two;
+      }
+    }
+
+    if (unchanged(node->operand_one_, one) &&
+        unchanged(node->operand_two_, two)) {
+      return self(node);
+    }
+    return ctx_.makeMin(one, two);
+  }
+
+private:
+  // Returns the canonical form of an affine node, the node itself if it is
+  // already canonical, or nullptr if it is not affine.
+  IRNode *canonicalize(const IRNode *node) {
+    std::optional<AffineExpr> affine = toAffine(node);
+    if (!affine) {
+      return nullptr;
+    }
+    IRContext::Checkpoint cp = ctx_.checkpoint();
+    IRNode *canonical = fromAffine(ctx_, *affine);
+    if (structurallyEqual(ctx_, canonical, node)) {
+      // Keep the input (and sharing) and drop whatever was just built.
+      ctx_.rollback(cp);
+      return self(node);
+    }
+    return canonical;
+  }
+};
+
+// Replaces a loop index by an expression; see substituteIndex().
+class IndexSubstituter : public IRRewriter<IndexSubstituter> {
+public:
+  IndexSubstituter(IRContext &ctx, Symbol index, IRNode *value)
+      : IRRewriter(ctx), index_(index), value_(value) {}
+
+  IRNode *visitVariable(const Variable *node) {
+    return node->symbol_ == index_ ? value_ : self(node);
+  }
+
+  IRNode *visitLoad(const Load *node) {
+    std::vector<IRNode *> indices;
+    if (!rewriteAll(node->indices_, indices)) {
+      return self(node);
+    }
+    simplifyAll(indices);
+    return ctx_.create<Load>(node->tensor_, std::move(indices));
+  }
+
+  IRNode *visitStore(const Store *node) {
+    std::vector<IRNode *> indices;
+    if (!rewriteAll(node->indices_, indices)) {
+      return self(node);
+    }
+    simplifyAll(indices);
+    return ctx_.create<Store>(node->tensor_, std::move(indices));
+  }
+
+private:
+  void simplifyAll(std::vector<IRNode *> &indices) {
+    for (IRNode *&index : indices) {
+      index = ExprSimplifier(ctx_).rewrite(index);
+    }
+  }
+
+  Symbol index_;
+  IRNode *value_;
+};
+
+} // namespace
+
+IRNode *simplifyExpr(IRContext &ctx, IRNode *node) {
+  return ExprSimplifier(ctx).rewrite(node);
+}
+
+IRNode *substituteIndex(IRContext &ctx, const IRNode *node, Symbol index,
+                        IRNode *value) {
+  return IndexSubstituter(ctx, index, value).rewrite(node);
+}
+
+IRNode *alignedEnd(IRContext &ctx, IRNode *lb, IRNode *ub, int64_t chunk) {
+  std::optional<AffineExpr> lb_affine = toAffine(lb);
+  std::optional<AffineExpr> ub_affine = toAffine(ub);
+  IRNode *span = lb_affine && ub_affine
+                     ? fromAffine(ctx, *ub_affine - *lb_affine)
+                     : ctx.makeAdd(ub, ctx.makeMul(lb, makeIntConst(ctx, -1)));
+  IRNode *whole = ctx.makeMul(ctx.makeDiv(span, makeIntConst(ctx, chunk)),
+                              makeIntConst(ctx, chunk));
+  bool zero_lb = lb_affine && *lb_affine == AffineExpr(0);
+  return simplifyExpr(ctx, zero_lb ? whole : ctx.makeAdd(lb, whole));
+}
+
+bool AffineSimplifyPass::run(IRContext &ctx, IRNode *&root,
+                             AnalysisManager &) {
+  IRNode *result = ExprSimplifier(ctx).rewrite(root);
+  if (result == root) {
+    return false;
+  }
+  root = result;
+  return true;
+}
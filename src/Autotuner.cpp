@@ -0,0 +1,520 @@
+#include "Autotuner.hpp"
+#include "AffineExpr.hpp"
+#include "CacheModel.hpp"
+#include "CodeGenerator.hpp"
+#include "LoopAnalysis.hpp"
+#include "LoopInterchange.hpp"
+#include "TilingPass.hpp"
+#include "TypeInference.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
+#include <unistd.h>
+
+namespace {
+
+// Constant value of an affine bound once the size parameters are known.
+std::optional<int64_t>
+evaluate(const IRNode *node,
+         const std::vector<std::pair<Symbol, int64_t>> &params) {
+  std::optional<AffineExpr> expr = toAffine(node);
+  if (!expr) {
+    return std::nullopt;
+  }
+  for (const auto &[sym, value] : params) {
+    *expr = expr->substitute(sym, AffineExpr(value));
+  }
+  if (!expr->isConstant()) {
+    return std::nullopt;
+  }
+  return expr->constant();
+}
+
+int64_t constantStep(const Loop *loop) {
+  std::optional<AffineExpr> step = toAffine(loop->step_);
+  return step && step->isConstant() && step->constant() > 0 ? step->constant()
+                                                            : 0;
+}
+
+std::string join(const std::vector<std::string> &parts, const char *sep) {
+  std::string out;
+  for (const std::string &part : parts) {
+    out += (out.empty() ? "" : sep) + part;
+  }
+  return out;
+}
+
+std::string readFile(const std::filesystem::path &path) {
+  std::ifstream in(path);
+  std::stringstream ss;
+  ss << in.rdbuf();
+  return ss.str();
+}
+
+} // namespace
+
+std::string Schedule::toString() const {
+  std::vector<std::string> sizes;
+  for (int64_t size : tile_sizes_) {
+    sizes.push_back(std::to_string(size));
+  }
+  std::vector<std::string> order;
+  for (size_t d : order_) {
+    order.push_back(std::to_string(d));
+  }
+  std::string s = "tile " + join(sizes, "x");
+  if (!order.empty()) {
+    s += " order " + join(order, ",");
+  }
+  return s + " unroll " + std::to_string(std::max(unroll_, 1u));
+}
+
+const Measurement *AutotuneReport::best() const {
+  return measured_.empty() ? nullptr : &measured_.front();
+}
+
+double AutotuneReport::speedup() const {
+  const Measurement *fastest = best();
+  return fastest && fastest->ms_ > 0 ? baseline_ms_ / fastest->ms_ : 1.0;
+}
+
+void AutotuneReport::print(std::ostream &os, size_t top) const {
+  os << "=== Autotune ===\n";
+  os << "  " << enumerated_ << " candidates enumerated, "
+     << measured_.size() + rejected_.size() << " timed, " << rejected_.size()
+     << " rejected (wrong output)\n";
+  os << std::fixed << std::setprecision(3);
+  os << "  " << std::left << std::setw(40) << "untiled" << std::right
+     << std::setw(10) << baseline_ms_ << " ms\n";
+  for (size_t i = 0; i < measured_.size() && i < top; ++i) {
+    const Measurement &m = measured_[i];
+    os << "  " << std::left << std::setw(40) << m.schedule_.toString()
+       << std::right << std::setw(10) << m.ms_ << " ms  " << std::setw(6)
+       << std::setprecision(2) << baseline_ms_ / m.ms_ << "x  (model "
+       << std::setprecision(4) << m.model_score_ << ")\n"
+       << std::setprecision(3);
+  }
+  if (const Measurement *fastest = best()) {
+    os << "Best: " << fastest->schedule_.toString() << ", "
+       << std::setprecision(2) << speedup() << "x over untiled\n";
+  }
+  os << std::defaultfloat;
+}
+
+/**
+ * @brief Prepares tuning of the outermost band of `untiled`.
+ *
+ * Size parameters that TunerOptions does not set are inferred from the
+ * extent of a tensor dimension indexed directly by a loop bounded by the
+ * parameter (e.g. N from C[i, j] with i < N).
+ *
+ * @throws std::invalid_argument if `untiled` does not start a loop band or a
+ * size parameter cannot be inferred.
+ */
+Autotuner::Autotuner(IRContext &ctx, IRNode *untiled, TunerOptions options)
+    : ctx_(ctx), untiled_(untiled), options_(std::move(options)),
+      analyses_(ctx) {
+  const LoopNestInfo nest = LoopNestAnalysis::run(ctx_, untiled_);
+  if (nest.bands_.empty() || nest.bands_.front().outermost() != untiled_) {
+    throw std::invalid_argument("autotune: root does not start a loop band");
+  }
+  band_ = nest.bands_.front().loops_;
+  dependences_ = DependenceAnalysis::run(ctx_, untiled_);
+
+  const AccessInfo accesses = AccessAnalysis::run(ctx_, untiled_);
+  for (Symbol param : TypeAnalysis::run(ctx_, untiled_).params_) {
+    const std::string &name = ctx_.name(param);
+    auto given = options_.params_.find(name);
+    if (given != options_.params_.end()) {
+      params_.emplace_back(param, given->second);
+      continue;
+    }
+    std::optional<int64_t> inferred;
+    for (const MemoryAccess &access : accesses.accesses_) {
+      for (const Loop *loop : access.loops_) {
+        std::optional<AffineExpr> ub = toAffine(loop->upper_bound_);
+        if (inferred || !ub || *ub != AffineExpr::symbol(param)) {
+          continue;
+        }
+        for (size_t d = 0; d < access.indices_->size(); ++d) {
+          std::optional<AffineExpr> index = toAffine((*access.indices_)[d]);
+          if (index && *index == AffineExpr::symbol(loop->index_)) {
+            inferred = static_cast<int64_t>(access.tensor_->extents_[d]);
+            break;
+          }
+        }
+      }
+    }
+    if (!inferred) {
+      throw std::invalid_argument("autotune: cannot infer a value for size "
+                                  "parameter '" +
+                                  name + "'; set it in TunerOptions::params_");
+    }
+    params_.emplace_back(param, *inferred);
+  }
+
+  for (const Loop *loop : band_) {
+    std::optional<int64_t> lb = evaluate(loop->lower_bound_, params_);
+    std::optional<int64_t> ub = evaluate(loop->upper_bound_, params_);
+    int64_t step = std::max<int64_t>(constantStep(loop), 1);
+    trips_.push_back(lb && ub ? std::max<int64_t>((*ub - *lb + step - 1) / step,
+                                                  1)
+                              : estimateTripCount(loop, accesses));
+  }
+}
+
+/**
+ * @brief Enumerates the search space and prunes it with two cheap models.
+ *
+ * Tilings are ranked by the cache model: those whose tile fits in L1 come
+ * first, then those fitting in L2, each ordered by predicted cache lines per
+ * iteration. Loop orders are ranked by loopOrderCost, which mostly counts
+ * the strided accesses of the innermost loop. The best `keep_tilings_`
+ * tilings are crossed with the best `keep_orders_` orders and every unroll
+ * factor.
+ */
+std::vector<Measurement> Autotuner::candidates() const {
+  const size_t depth = band_.size();
+  const CacheTopology &host = CacheTopology::host();
+  const CacheLevel *l1 = host.level(1);
+  const CacheLevel *l2 = host.level(2);
+  if (!l1) {
+    l1 = &host.levels_.front();
+  }
+  if (!l2) {
+    l2 = l1;
+  }
+
+  // Per loop: untiled, or any candidate size below the trip count. A band
+  // that is not fully permutable is only run untiled.
+  std::vector<std::vector<int64_t>> choices(depth, std::vector<int64_t>{0});
+  const bool tilable = dependences_.isTilable(band_);
+  for (size_t d = 0; tilable && d < depth; ++d) {
+    int64_t step = constantStep(band_[d]);
+    for (int64_t size : options_.tile_sizes_) {
+      if (step > 0 && size > 1 && size < trips_[d] && size % step == 0) {
+        choices[d].push_back(size);
+      }
+    }
+  }
+
+  const FootprintModel &footprints =
+      analyses_.get<FootprintAnalysis>(untiled_);
+
+  struct Tiling {
+    std::vector<int64_t> sizes_;
+    int tier_ = 0;
+    double score_ = 0;
+  };
+  std::vector<Tiling> tilings;
+  std::vector<size_t> pick(depth, 0);
+  for (;;) {
+    Tiling t;
+    double volume = 1;
+    for (size_t d = 0; d < depth; ++d) {
+      t.sizes_.push_back(choices[d][pick[d]]);
+      volume *= t.sizes_[d] > 0 ? t.sizes_[d] : trips_[d];
+    }
+    TileFootprint fp = footprints.evaluate(t.sizes_, *l1);
+    if (!fitsInCache(fp, *l1)) {
+      t.tier_ = fitsInCache(footprints.evaluate(t.sizes_, *l2), *l2) ? 1 : 2;
+    }
+    t.score_ = static_cast<double>(fp.lines_) / volume;
+    tilings.push_back(std::move(t));
+
+    size_t d = depth;
+    while (d > 0 && ++pick[d - 1] == choices[d - 1].size()) {
+      pick[--d] = 0;
+    }
+    if (d == 0) {
+      break;
+    }
+  }
+  std::stable_sort(tilings.begin(), tilings.end(),
+                   [](const Tiling &a, const Tiling &b) {
+                     return a.tier_ != b.tier_ ? a.tier_ < b.tier_
+                                               : a.score_ < b.score_;
+                   });
+  tilings.resize(std::min(tilings.size(), options_.keep_tilings_));
+
+  std::vector<size_t> identity(depth);
+  std::iota(identity.begin(), identity.end(), 0);
+  std::vector<std::vector<size_t>> orders{identity};
+  if (options_.reorder_) {
+    std::vector<size_t> order = identity;
+    while (std::next_permutation(order.begin(), order.end())) {
+      if (dependences_.isLegalOrder(band_, order)) {
+        orders.push_back(order);
+      }
+    }
+    const AccessInfo accesses = AccessAnalysis::run(ctx_, untiled_);
+    std::stable_sort(orders.begin(), orders.end(),
+                     [&](const std::vector<size_t> &a,
+                         const std::vector<size_t> &b) {
+                       return loopOrderCost(accesses, band_, a) <
+                              loopOrderCost(accesses, band_, b);
+                     });
+  }
+  orders.resize(std::min(orders.size(), std::max<size_t>(
+                                            options_.keep_orders_, 1)));
+
+  std::vector<unsigned> unrolls = options_.unroll_factors_;
+  if (unrolls.empty()) {
+    unrolls.push_back(1);
+  }
+
+  std::vector<Measurement> out;
+  for (const Tiling &t : tilings) {
+    for (const std::vector<size_t> &order : orders) {
+      for (unsigned unroll : unrolls) {
+        Measurement m;
+        m.schedule_.tile_sizes_ = t.sizes_;
+        m.schedule_.order_ = order == identity ? std::vector<size_t>{} : order;
+        m.schedule_.unroll_ = unroll;
+        m.model_score_ = t.score_;
+        out.push_back(std::move(m));
+      }
+    }
+  }
+  return out;
+}
+
+IRNode *Autotuner::apply(const Schedule &schedule) const {
+  TilingResult tiled =
+      tileBand(ctx_, untiled_, {TileLevel{"", schedule.tile_sizes_,
+                                          schedule.order_}},
+               schedule.order_);
+  if (!tiled) {
+    throw std::invalid_argument("autotune: " + tiled.diagnostic_);
+  }
+  return tiled.root_;
+}
+
+/**
+ * @brief Emits one translation unit with the untiled kernel, every candidate
+ * and a main() that runs each of them on the same synthetic inputs. For every
+ * kernel it prints one line: its index (0 is the untiled kernel), the fastest
+ * of `repetitions_` runs in milliseconds and a checksum of the written
+ * tensors after one run.
+ */
+std::string
+Autotuner::harnessSource(const std::vector<Measurement> &candidates) const {
+  std::ostringstream os;
+  os << "#include <algorithm>\n"
+        "#include <chrono>\n"
+        "#include <cstdio>\n"
+        "#include <cstdlib>\n"
+        "#include <cstring>\n\n";
+
+  // The candidates are only needed as text; their nodes are reclaimed below.
+  const IRContext::Checkpoint checkpoint = ctx_.checkpoint();
+  std::vector<const IRNode *> kernels{untiled_};
+  for (const Measurement &m : candidates) {
+    kernels.push_back(apply(m.schedule_));
+  }
+  for (size_t k = 0; k < kernels.size(); ++k) {
+    CodeGenOptions options;
+    options.unroll_ = k == 0 ? 0 : candidates[k - 1].schedule_.unroll_;
+    generateKernel(ctx_, kernels[k], "kernel_" + std::to_string(k), os,
+                   options);
+    os << "\n";
+  }
+
+  os << "template <typename T> T *alloc(size_t n, size_t align) {\n"
+        "  size_t bytes = (n * sizeof(T) + align - 1) / align * align;\n"
+        "  return static_cast<T *>(std::aligned_alloc(align, bytes));\n"
+        "}\n\n"
+        "template <typename T> void fill(T *p, size_t n, size_t seed) {\n"
+        "  for (size_t i = 0; i < n; ++i) {\n"
+        "    p[i] = static_cast<T>((i * 2654435761u + seed) % 1000) / "
+        "static_cast<T>(100);\n"
+        "  }\n"
+        "}\n\n"
+        "int main() {\n";
+
+  const KernelTypes types = TypeAnalysis::run(ctx_, untiled_);
+  const AccessInfo accesses = AccessAnalysis::run(ctx_, untiled_);
+  std::string reset;
+  std::string checksum;
+  for (size_t t = 0; t < types.tensors_.size(); ++t) {
+    const Tensor *tensor = types.tensors_[t];
+    const std::string &name = tensor->name;
+    const std::string type = cTypeName(tensor->dtype_);
+    const std::string count = std::to_string(tensor->layout_.size_);
+    const std::string align =
+        std::to_string(std::max<size_t>(tensor->layout_.alignment_, 64));
+    os << "  " << type << " *" << name << " = alloc<" << type << ">(" << count
+       << ", " << align << ");\n";
+    os << "  " << type << " *" << name << "_init = alloc<" << type << ">("
+       << count << ", " << align << ");\n";
+    os << "  fill(" << name << "_init, " << count << ", " << t + 1 << ");\n";
+    reset += "    std::memcpy(" + name + ", " + name + "_init, " + count +
+             " * sizeof(" + type + "));\n";
+    bool written = std::any_of(
+        accesses.accesses_.begin(), accesses.accesses_.end(),
+        [tensor](const MemoryAccess &a) {
+          return a.is_write_ && a.tensor_ == tensor;
+        });
+    if (written) {
+      checksum += "    for (size_t i = 0; i < " + count +
+                  "; ++i) {\n      sum += static_cast<double>(" + name +
+                  "[i]) * static_cast<double>(i % 7 + 1);\n    }\n";
+    }
+  }
+  os << "  auto reset = [&] {\n" << reset << "  };\n";
+  os << "  auto checksum = [&] {\n    double sum = 0;\n"
+     << checksum << "    return sum;\n  };\n\n";
+
+  for (size_t k = 0; k < kernels.size(); ++k) {
+    // Arguments in signature order (tensors, then sizes, each by name).
+    const KernelTypes kt = TypeAnalysis::run(ctx_, kernels[k]);
+    std::vector<std::string> args;
+    for (const Tensor *tensor : kt.tensors_) {
+      args.push_back(tensor->name);
+    }
+    for (Symbol param : kt.params_) {
+      for (const auto &[sym, value] : params_) {
+        if (sym == param) {
+          args.push_back(std::to_string(value));
+        }
+      }
+    }
+    const std::string call =
+        "kernel_" + std::to_string(k) + "(" + join(args, ", ") + ");\n";
+    os << "  {\n"
+       << "    reset();\n"
+       << "    " << call << "    double sum = checksum();\n"
+       << "    double best = 1e300;\n"
+       << "    for (int r = 0; r < "
+       << std::max<size_t>(options_.repetitions_, 1) << "; ++r) {\n"
+       << "      reset();\n"
+       << "      auto start = std::chrono::steady_clock::now();\n"
+       << "      " << call
+       << "      auto stop = std::chrono::steady_clock::now();\n"
+       << "      best = std::min(best, std::chrono::duration<double, "
+          "std::milli>(stop - start).count());\n"
+       << "    }\n"
+       << "    std::printf(\"" << k << " %.6f %.17g\\n\", best, sum);\n"
+       << "  }\n";
+  }
+  os << "  return 0;\n}\n";
+  ctx_.rollback(checkpoint);
+  return os.str();
+}
+
+/**
+ * @brief Compiles all candidates into one harness, runs it and ranks the
+ * candidates by time. Outputs are compared with the untiled kernel through a
+ * weighted checksum (relative tolerance 1e-6, since unroll hints may change
+ * floating-point contraction).
+ */
+AutotuneReport Autotuner::tune() {
+  AutotuneReport report;
+  std::vector<Measurement> measured = candidates();
+
+  size_t space = 1;
+  for (size_t d = 0; d < band_.size(); ++d) {
+    size_t sizes = 1;
+    int64_t step = constantStep(band_[d]);
+    for (int64_t size : options_.tile_sizes_) {
+      sizes += step > 0 && size > 1 && size < trips_[d] && size % step == 0;
+    }
+    space *= sizes;
+  }
+  size_t orders = 1;
+  for (size_t d = 2; options_.reorder_ && d <= band_.size(); ++d) {
+    orders *= d;
+  }
+  report.enumerated_ =
+      space * orders * std::max<size_t>(options_.unroll_factors_.size(), 1);
+
+  namespace fs = std::filesystem;
+  const bool own_dir = options_.work_dir_.empty();
+  fs::path dir = own_dir ? fs::temp_directory_path() /
+                               ("tiling-autotune-" + std::to_string(getpid()))
+                         : fs::path(options_.work_dir_);
+  fs::create_directories(dir);
+  const fs::path source = dir / "autotune.cpp";
+  const fs::path binary = dir / "autotune";
+  const fs::path log = dir / "autotune.log";
+  auto cleanup = [&] {
+    if (options_.keep_files_) {
+      return;
+    }
+    std::error_code ec;
+    if (own_dir) {
+      fs::remove_all(dir, ec);
+    } else {
+      for (const fs::path &p : {source, binary, log}) {
+        fs::remove(p, ec);
+      }
+    }
+  };
+
+  {
+    std::ofstream out(source);
+    out << harnessSource(measured);
+  }
+
+  std::string compiler = options_.compiler_;
+  if (compiler.empty()) {
+    const char *cxx = std::getenv("CXX");
+    compiler = cxx && *cxx ? cxx : "c++";
+  }
+  const std::string command = compiler + " -std=c++17 " + options_.flags_ +
+                              " -o '" + binary.string() + "' '" +
+                              source.string() + "' > '" + log.string() +
+                              "' 2>&1";
+  if (std::system(command.c_str()) != 0) {
+    std::string message = "autotune: compilation failed: " + command + "\n" +
+                          readFile(log).substr(0, 2000);
+    cleanup();
+    throw std::runtime_error(message);
+  }
+
+  FILE *pipe = ::popen(("'" + binary.string() + "'").c_str(), "r");
+  if (!pipe) {
+    cleanup();
+    throw std::runtime_error("autotune: cannot run " + binary.string());
+  }
+  std::vector<std::pair<double, double>> results(measured.size() + 1,
+                                                 {-1.0, 0.0});
+  char line[256];
+  while (std::fgets(line, sizeof(line), pipe)) {
+    size_t k = 0;
+    double ms = 0;
+    double sum = 0;
+    if (std::sscanf(line, "%zu %lf %lf", &k, &ms, &sum) == 3 &&
+        k < results.size()) {
+      results[k] = {ms, sum};
+    }
+  }
+  int status = ::pclose(pipe);
+  cleanup();
+  if (status != 0 || results.front().first < 0) {
+    throw std::runtime_error("autotune: timing harness failed");
+  }
+
+  report.baseline_ms_ = results.front().first;
+  const double reference = results.front().second;
+  for (size_t i = 0; i < measured.size(); ++i) {
+    Measurement &m = measured[i];
+    m.ms_ = results[i + 1].first;
+    double error = std::abs(results[i + 1].second - reference);
+    m.correct_ = m.ms_ >= 0 &&
+                 error <= 1e-6 * std::max(std::abs(reference), 1.0);
+    (m.correct_ ? report.measured_ : report.rejected_).push_back(m);
+  }
+  std::stable_sort(report.measured_.begin(), report.measured_.end(),
+                   [](const Measurement &a, const Measurement &b) {
+                     return a.ms_ < b.ms_;
+                   });
+  return report;
+}
@@ -0,0 +1,472 @@
+#include "CacheModel.hpp"
+#include "AffineExpr.hpp"
+#include "LoopAnalysis.hpp"
+#include "TypeInference.hpp"
+#include <cstdlib>
+#include <fstream>
+#include <numeric>
+#include <unordered_map>
+
+// --- Topology ---
+
+namespace {
+
+// Reads the first line of a sysfs attribute; empty if it does not exist.
+std::string readAttribute(const std::string &path) {
+  std::ifstream in(path);
+  std::string line;
+  std::getline(in, line);
+  return line;
+}
+
+// Parses "48K", "2048K", "32M" or a plain byte count. Returns 0 on error.
+size_t parseSize(const std::string &text) {
+  size_t pos = 0;
+  unsigned long long value = 0;
+  try {
+    value = std::stoull(text, &pos);
+  } catch (const std::exception &) {
+    return 0;
+  }
+  std::string suffix = text.substr(pos);
+  if (suffix == "K") {
+    value <<= 10;
+  } else if (suffix == "M") {
+    value <<= 20;
+  } else if (suffix == "G") {
+    value <<= 30;
+  } else if (!suffix.empty()) {
+    return 0;
+  }
+  return static_cast<size_t>(value);
+}
+
+} // namespace
+
+/**
+ * @brief Reads the data cache hierarchy from Linux sysfs.
+ *
+ * Every indexN directory describes one cache. Instruction caches are skipped,
+ * and when several caches report the same level (split or clustered caches)
+ * the first one wins. Missing line sizes or associativities keep the
+ * CacheLevel defaults.
+ *
+ * @param sysfs_dir The cache directory of one CPU.
+ * @return The detected levels, L1 first, or defaults() if none were found.
+ */
+CacheTopology CacheTopology::detect(const std::string &sysfs_dir) {
+  CacheTopology topology;
+  for (unsigned index = 0;; ++index) {
+    const std::string dir = sysfs_dir + "/index" + std::to_string(index) + "/";
+    const std::string type = readAttribute(dir + "type");
+    if (type.empty()) {
+      break;
+    }
+    if (type == "Instruction") {
+      continue;
+    }
+    CacheLevel cache;
+    cache.level_ =
+        static_cast<unsigned>(parseSize(readAttribute(dir + "level")));
+    cache.size_ = parseSize(readAttribute(dir + "size"));
+    if (cache.level_ == 0 || cache.size_ == 0 || topology.level(cache.level_)) {
+      continue;
+    }
+    if (size_t line = parseSize(readAttribute(dir + "coherency_line_size"))) {
+      cache.line_size_ = line;
+    }
+    // Fully associative caches report 0 ways; treat them as one big set.
+    if (size_t ways = parseSize(readAttribute(dir + "ways_of_associativity"))) {
+      cache.associativity_ = ways;
+    } else {
+      cache.associativity_ =
+          std::max<size_t>(cache.size_ / cache.line_size_, 1);
+    }
+    topology.levels_.push_back(cache);
+  }
+  if (topology.levels_.empty()) {
+    return defaults();
+  }
+  std::sort(topology.levels_.begin(), topology.levels_.end(),
+            [](const CacheLevel &a, const CacheLevel &b) {
+              return a.level_ < b.level_;
+            });
+  return topology;
+}
+
+CacheTopology CacheTopology::defaults() {
+  CacheTopology topology;
+  topology.levels_ = {{1, size_t{32} << 10, 64, 8},
+                      {2, size_t{1} << 20, 64, 16},
+                      {3, size_t{32} << 20, 64, 16}};
+  return topology;
+}
+
+const CacheTopology &CacheTopology::host() {
+  static const CacheTopology topology = detect();
+  return topology;
+}
+
+const CacheLevel *CacheTopology::level(unsigned n) const {
+  for (const CacheLevel &cache : levels_) {
+    if (cache.level_ == n) {
+      return &cache;
+    }
+  }
+  return nullptr;
+}
+
+// --- Footprint model ---
+
+/**
+ * @brief Estimates the trip count of a loop. Exact for constant bounds;
+ * otherwise the extent of a tensor dimension the loop index addresses
+ * directly (accesses are assumed in bounds); otherwise a nominal 1024.
+ *
+ * @param loop The loop.
+ * @param accesses The accesses of the kernel containing the loop.
+ * @return At least 1.
+ */
+int64_t estimateTripCount(const Loop *loop, const AccessInfo &accesses) {
+  std::optional<AffineExpr> lb = toAffine(loop->lower_bound_);
+  std::optional<AffineExpr> ub = toAffine(loop->upper_bound_);
+  std::optional<AffineExpr> step = toAffine(loop->step_);
+  int64_t stride = step && step->isConstant() && step->constant() > 0
+                       ? step->constant()
+                       : 1;
+  if (lb && ub && (*ub - *lb).isConstant()) {
+    int64_t span = (*ub - *lb).constant();
+    return std::max<int64_t>((span + stride - 1) / stride, 1);
+  }
+  for (const MemoryAccess &access : accesses.accesses_) {
+    for (size_t d = 0; d < access.indices_->size(); ++d) {
+      const IRNode *index = (*access.indices_)[d];
+      if (index && index->getType() == IRNodeType::Variable &&
+          static_cast<const Variable *>(index)->symbol_ == loop->index_) {
+        int64_t extent = static_cast<int64_t>(access.tensor_->extents_[d]);
+        return std::max<int64_t>((extent + stride - 1) / stride, 1);
+      }
+    }
+  }
+  return 1024;
+}
+
+bool fitsInCache(const TileFootprint &footprint, const CacheLevel &cache) {
+  // One way is left for everything the model does not see (scalars, the
+  // stack, other tiles' trailing lines).
+  const size_t usable =
+      cache.size_ / cache.associativity_ * (cache.associativity_ - 1);
+  return footprint.bytes_ <= std::max(usable, cache.line_size_) &&
+         footprint.set_pressure_ <= cache.associativity_;
+}
+
+
+namespace {
+
+// The outermost `depth` loops of the perfect band at `root` (fewer if the
+// band is shallower).
+std::vector<const Loop *> collectBand(const IRNode *root, size_t depth) {
+  std::vector<const Loop *> band;
+  const IRNode *node = root;
+  while (band.size() < depth && node && node->getType() == IRNodeType::Loop) {
+    const Loop *loop = static_cast<const Loop *>(node);
+    band.push_back(loop);
+    node = loop->body_.size() == 1 ? loop->body_.front() : nullptr;
+  }
+  return band;
+}
+
+// Candidate sizes for one loop: power-of-two multiples of its step below the
+// trip count, then the trip count itself.
+std::vector<int64_t> candidates(const Loop *loop, int64_t trip, int64_t cap) {
+  std::optional<AffineExpr> step = toAffine(loop->step_);
+  int64_t unit =
+      step && step->isConstant() && step->constant() > 0 ? step->constant() : 1;
+  std::vector<int64_t> out;
+  const int64_t limit = cap > 0 ? std::min(cap, trip) : trip;
+  for (int64_t size = unit; size < limit; size *= 2) {
+    out.push_back(size);
+  }
+  out.push_back(limit);
+  return out;
+}
+
+} // namespace
+
+/**
+ * @brief Models the band once: trip counts, affine index forms with their
+ * constant offsets removed, the trip counts of loops inside the band, and
+ * one entry per distinct set of lines (a load and store of the same element
+ * are counted once).
+ *
+ * @param ctx The context owning the band.
+ * @param root The outermost loop of the band.
+ * @param depth Number of band loops the model sizes.
+ */
+FootprintModel::FootprintModel(const IRContext &ctx, const IRNode *root,
+                               size_t depth) {
+  const AccessInfo accesses = AccessAnalysis::run(ctx, root);
+  band_ = collectBand(root, depth);
+  for (const Loop *loop : band_) {
+    trips_.push_back(estimateTripCount(loop, accesses));
+  }
+
+  for (const MemoryAccess &access : accesses.accesses_) {
+    Access a;
+    a.tensor_ = access.tensor_;
+    a.elem_ = dtypeSize(access.tensor_->dtype_);
+    for (const IRNode *index : *access.indices_) {
+      std::optional<AffineExpr> affine = toAffine(index);
+      if (affine) {
+        // The constant offset shifts the range but does not widen it.
+        *affine = *affine - AffineExpr(affine->constant());
+      }
+      a.indices_.push_back(std::move(affine));
+    }
+    // Loops inside the band are walked completely by every tile.
+    for (const Loop *loop : access.loops_) {
+      if (std::find(band_.begin(), band_.end(), loop) == band_.end()) {
+        inner_trips_.emplace(loop->index_, estimateTripCount(loop, accesses));
+      }
+    }
+    // A load and a store of the same element (C[i][j] += ...) share lines.
+    if (std::none_of(accesses_.begin(), accesses_.end(),
+                     [&a](const Access &b) { return sameLines(a, b); })) {
+      accesses_.push_back(std::move(a));
+    }
+  }
+}
+
+TileFootprint FootprintModel::evaluate(const std::vector<int64_t> &sizes,
+                                       const CacheLevel &cache) const {
+  TileFootprint total;
+  for (const Access &access : accesses_) {
+    size_t lines = 0;
+    size_t pressure = 0;
+    accessLines(access, sizes, cache, lines, pressure);
+    total.lines_ += lines;
+    total.set_pressure_ += pressure;
+  }
+  total.bytes_ = total.lines_ * cache.line_size_;
+  return total;
+}
+
+bool FootprintModel::sameLines(const Access &a, const Access &b) {
+  if (a.tensor_ != b.tensor_) {
+    return false;
+  }
+  for (size_t d = 0; d < a.indices_.size(); ++d) {
+    if (!a.indices_[d] || !b.indices_[d] ||
+        *a.indices_[d] != *b.indices_[d]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+int64_t FootprintModel::rangeOf(Symbol sym, const std::vector<int64_t> &sizes) const {
+  for (size_t d = 0; d < band_.size(); ++d) {
+    if (band_[d]->index_ == sym) {
+      int64_t size = d < sizes.size() ? sizes[d] : 0;
+      return size > 0 ? std::min(size, trips_[d]) : trips_[d];
+    }
+  }
+  auto it = inner_trips_.find(sym);
+  return it != inner_trips_.end() ? it->second : 1;
+}
+
+void FootprintModel::accessLines(const Access &access,
+                                 const std::vector<int64_t> &sizes,
+                                 const CacheLevel &cache, size_t &lines,
+                                 size_t &pressure) const {
+  const Tensor &tensor = *access.tensor_;
+  const std::vector<size_t> &strides = tensor.layout_.strides_;
+  const size_t dims = access.indices_.size();
+
+  // Elements spanned along every dimension.
+  std::vector<size_t> range(dims);
+  for (size_t k = 0; k < dims; ++k) {
+    const std::optional<AffineExpr> &index = access.indices_[k];
+    size_t span = tensor.extents_[k];
+    if (index) {
+      int64_t extra = 0;
+      for (const AffineExpr::Term &term : index->terms()) {
+        extra += std::abs(term.second) * (rangeOf(term.first, sizes) - 1);
+      }
+      span = std::min(span, static_cast<size_t>(extra) + 1);
+    }
+    range[k] = std::max<size_t>(span, 1);
+  }
+
+  // The dimension with the smallest stride is walked contiguously; every
+  // other dimension multiplies the number of rows, which start
+  // `row_stride` elements apart (the next smallest stride).
+  size_t contiguous = 0;
+  for (size_t k = 1; k < dims; ++k) {
+    if (strides[k] < strides[contiguous]) {
+      contiguous = k;
+    }
+  }
+  size_t rows = 1;
+  size_t row_stride = 0;
+  for (size_t k = 0; k < dims; ++k) {
+    if (k == contiguous) {
+      continue;
+    }
+    rows *= range[k];
+    if (range[k] > 1 && (row_stride == 0 || strides[k] < row_stride)) {
+      row_stride = strides[k];
+    }
+  }
+  const size_t line = cache.line_size_;
+  const size_t span_bytes =
+      dims ? range[contiguous] * std::max<size_t>(strides[contiguous], 1) *
+                 access.elem_
+           : access.elem_;
+  const size_t row_lines = std::min<size_t>(
+      dims ? range[contiguous] : 1, (span_bytes + line - 1) / line);
+  lines = rows * row_lines;
+
+  // Rows whose distance is a whole number of lines repeat every
+  // sets / gcd(distance, sets) rows; each row covers row_lines sets.
+  const size_t sets = cache.numSets();
+  size_t covered = sets;
+  const size_t row_bytes = row_stride * access.elem_;
+  if (rows > 1 && row_bytes % line == 0) {
+    size_t distance = (row_bytes / line) % sets;
+    size_t groups = sets / std::gcd(distance, sets);
+    covered = std::min(sets, groups * row_lines);
+  } else {
+    covered = std::min(sets, lines);
+  }
+  pressure = (lines + covered - 1) / std::max<size_t>(covered, 1);
+}
+
+FootprintModel FootprintAnalysis::run(const IRContext &ctx,
+                                      const IRNode *root) {
+  return FootprintModel(ctx, root);
+}
+
+TileFootprint tileFootprint(const IRContext &ctx, const IRNode *root,
+                            const std::vector<int64_t> &tile_sizes,
+                            const CacheLevel &cache) {
+  FootprintModel model(ctx, root, tile_sizes.size());
+  return model.evaluate(tile_sizes, cache);
+}
+
+/**
+ * @brief Exhaustive search over power-of-two tile sizes.
+ *
+ * Among the candidates that fit, the largest tile volume wins (it has the
+ * most reuse per miss), then the longest innermost tile (longer contiguous
+ * rows), then the smallest footprint. A loop whose whole range is chosen is
+ * reported as 0, i.e. left untiled. If no candidate fits, nothing is tiled:
+ * the level cannot hold even a single row of the band.
+ *
+ * @param ctx The context owning the band.
+ * @param root The outermost loop of the band.
+ * @param depth Number of band loops to size.
+ * @param cache The cache level the tile must stay resident in.
+ * @param max_sizes Per-loop upper bounds (0: unbounded), e.g. the sizes of
+ * the enclosing level.
+ * @return One size per band loop (fewer if the band is shallower).
+ */
+std::vector<int64_t> selectTileSizes(const IRContext &ctx, const IRNode *root,
+                                     size_t depth, const CacheLevel &cache,
+                                     const std::vector<int64_t> &max_sizes) {
+  FootprintModel model(ctx, root, depth);
+  const std::vector<const Loop *> &band = model.band();
+  const std::vector<int64_t> &trips = model.trips();
+  const size_t n = band.size();
+
+  std::vector<std::vector<int64_t>> choices;
+  for (size_t d = 0; d < n; ++d) {
+    int64_t cap = d < max_sizes.size() ? max_sizes[d] : 0;
+    choices.push_back(candidates(band[d], trips[d], cap));
+  }
+
+  std::vector<int64_t> best(n, 0);
+  bool found = false;
+  int64_t best_volume = 0;
+  size_t best_bytes = 0;
+  std::vector<size_t> pick(n, 0);
+  std::vector<int64_t> sizes(n);
+  while (n > 0) {
+    int64_t volume = 1;
+    for (size_t d = 0; d < n; ++d) {
+      sizes[d] = choices[d][pick[d]];
+      volume *= sizes[d];
+    }
+    TileFootprint footprint = model.evaluate(sizes, cache);
+    if (fitsInCache(footprint, cache)) {
+      bool better = !found || volume > best_volume ||
+                    (volume == best_volume && sizes.back() > best.back()) ||
+                    (volume == best_volume && sizes.back() == best.back() &&
+                     footprint.bytes_ < best_bytes);
+      if (better) {
+        found = true;
+        best = sizes;
+        best_volume = volume;
+        best_bytes = footprint.bytes_;
+      }
+    }
+    // Next combination (odometer order).
+    size_t d = n;
+    while (d-- > 0 && ++pick[d] == choices[d].size()) {
+      pick[d] = 0;
+    }
+    if (d == static_cast<size_t>(-1)) {
+      break;
+    }
+  }
+
+  if (!found) {
+    return std::vector<int64_t>(n, 0);
+  }
+  for (size_t d = 0; d < n; ++d) {
+    if (best[d] >= trips[d]) {
+      best[d] = 0;
+    }
+  }
+  return best;
+}
+
+/**
+ * @brief Sizes one tiling level per cache, from the last level inwards.
+ *
+ * Each level is searched within the tile of the level above it, so the
+ * hierarchy nests. A level is dropped when it would tile nothing, e.g. when
+ * the tile of the level above already fits.
+ *
+ * @param ctx The context owning the band.
+ * @param root The outermost loop of the band.
+ * @param depth Number of band loops to tile.
+ * @param topology The cache hierarchy, e.g. CacheTopology::host().
+ * @return Levels for tileBand, coarsest first.
+ */
+std::vector<TileLevel> selectTileLevels(const IRContext &ctx,
+                                        const IRNode *root, size_t depth,
+                                        const CacheTopology &topology) {
+  std::vector<TileLevel> levels;
+  std::vector<int64_t> parent;
+  for (auto it = topology.levels_.rbegin(); it != topology.levels_.rend();
+       ++it) {
+    std::vector<int64_t> sizes =
+        selectTileSizes(ctx, root, depth, *it, parent);
+    // A loop that keeps the whole tile of the level above needs no tile loop
+    // at this level.
+    std::vector<int64_t> own = sizes;
+    for (size_t d = 0; d < own.size() && d < parent.size(); ++d) {
+      if (parent[d] > 0 && own[d] == parent[d]) {
+        own[d] = 0;
+      }
+    }
+    if (std::none_of(own.begin(), own.end(),
+                     [](int64_t size) { return size > 1; })) {
+      continue;
+    }
+    levels.push_back({"L" + std::to_string(it->level_), own, {}});
+    parent = sizes;
+  }
+  return levels;
+}
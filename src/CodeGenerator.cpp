@@ -1,5 +1,11 @@
 #include "CodeGenerator.hpp"
+#include "AffineExpr.hpp"
 #include "IR.hpp"
+#include "IRVisitor.hpp"
+#include "TypeInference.hpp"
+#include <algorithm>
+#include <map>
+#include <optional>
 
 // --- Utility Functions (for Code Generation) ---
 
@@ -10,135 +16,600 @@ std::string indent_level_code_gen(int depth) {
   return std::string(depth * 4, ' ');
 }
 
-/**
- * @brief Recursively generates the C++ code for an expression (Const, Variable,
- * Add, Mul, Min, Load).
- *
- * @param node A pointer to the root of the expression IRNode.
- * @return A string containing the C++ representation of the expression.
- */
-std::string generateExpression(const IRNode *node) {
-  if (!node)
-    return "/* NULL_EXPR */";
-
-  switch (node->getType()) {
-  case IRNodeType::Const: {
-    const Const *constant = static_cast<const Const *>(node);
-    return std::visit(
+namespace {
+
+// Generates C++ expressions (Const, Variable, Add, Mul, Min, Load, Store).
+class ExpressionGenerator
+    : public IRVisitor<ExpressionGenerator, std::string> {
+public:
+  explicit ExpressionGenerator(const IRContext &ctx) : ctx_(ctx) {}
+
+  std::string visitConst(const Const *constant) {
+    std::string literal = std::visit(
         [](auto &&arg) -> std::string { return std::to_string(arg); },
         constant->getValue());
+    // Suffixes keep the literal's type equal to the constant's DType
+    if (std::holds_alternative<float>(constant->getValue())) {
+      return literal + "f";
+    }
+    if (std::holds_alternative<long long>(constant->getValue())) {
+      return literal + "LL";
+    }
+    return literal;
   }
-  case IRNodeType::Variable: {
-    return static_cast<const Variable *>(node)->getName();
+
+  std::string visitVariable(const Variable *var) {
+    return ctx_.name(var->getSymbol());
   }
-  case IRNodeType::Add: {
-    const Add *a = static_cast<const Add *>(node);
-    return "(" + generateExpression(a->operand_one_.get()) + " + " +
-           generateExpression(a->operand_two_.get()) + ")";
+
+  std::string visitAdd(const Add *a) {
+    return "(" + visit(a->operand_one_) + " + " + visit(a->operand_two_) + ")";
+  }
+
+  std::string visitMul(const Mul *m) {
+    return "(" + visit(m->operand_one_) + " * " + visit(m->operand_two_) + ")";
   }
-  case IRNodeType::Mul: {
-    const Mul *m = static_cast<const Mul *>(node);
-    return "(" + generateExpression(m->operand_one_.get()) + " * " +
-           generateExpression(m->operand_two_.get()) + ")";
+
+  // Integer division; operands are index expressions
+  std::string visitDiv(const Div *d) {
+    return "(" + visit(d->operand_one_) + " / " + visit(d->operand_two_) + ")";
   }
-  case IRNodeType::Min: {
-    const Min *m = static_cast<const Min *>(node);
+
+  std::string visitMin(const Min *m) {
     // Using C++ standard library min function
-    return "std::min(" + generateExpression(m->operand_one_.get()) + ", " +
-           generateExpression(m->operand_two_.get()) + ")";
-  }
-  case IRNodeType::Load: {
-    const Load *load = static_cast<const Load *>(node);
-    // NOTE: This uses the multi-dimensional syntax A[i, j], which needs to be
-    // manually mapped to 1D flat array indexing A[i * N + j] in a production
-    // system.
-    std::string s = load->tensor_.name + "[";
-    for (size_t i = 0; i < load->indices_.size(); ++i) {
-      s += generateExpression(load->indices_[i].get());
-      if (i < load->indices_.size() - 1)
-        s += ", ";
-    }
-    s += "]";
-    return s;
-  }
-  default:
-    // Other node types are statements, not expressions that return a value
-    return "/* UNHANDLED_EXPR_TYPE */";
+    return "std::min(" + visit(m->operand_one_) + ", " +
+           visit(m->operand_two_) + ")";
   }
-}
 
-/**
- * @brief Recursively generates C++ code from the IR tree into an output stream.
- *
- * @param root A pointer to the root of the IRNode subtree to generate code for.
- * @param depth The current indentation level.
- * @param os The output stream to write the generated C++ code to.
- */
-void codeGeneration(const IRNode *root, int depth, std::ostream &os) {
-  if (!root)
-    return;
+  std::string visitLoad(const Load *load) {
+    return access(load->tensor_, load->indices_);
+  }
+
+  // Treat Store as the left-hand side assignment target
+  std::string visitStore(const Store *store) {
+    return access(store->tensor_, store->indices_);
+  }
+
+  // Other node types are statements, not expressions that return a value
+  std::string visitNode(const IRNode *) { return "/* UNHANDLED_EXPR_TYPE */"; }
+  std::string visitNull() { return "/* NULL_EXPR */"; }
+
+private:
+  // Flattens a multi-dimensional access into the tensor's 1D element offset
+  // according to its layout, e.g. A[i * 1024 + j] for packed row-major, or
+  // for 32x32 blocks:
+  //   A[(i / 32) * 32768 + (i % 32) * 32 + (j / 32) * 1024 + (j % 32)]
+  // A dimension held in a single block needs no division (indices are
+  // assumed in bounds).
+  std::string access(const Tensor &t, const std::vector<IRNode *> &indices) {
+    const TensorLayout &layout = t.layout_;
+    std::string s;
+    auto add_term = [&s](const std::string &term) {
+      s += s.empty() ? term : " + " + term;
+    };
+    auto scaled = [](const std::string &e, size_t stride) {
+      return stride == 1 ? e : e + " * " + std::to_string(stride);
+    };
+    for (size_t d = 0; d < indices.size() && d < layout.dims(); ++d) {
+      std::string index = visit(indices[d]);
+      if (layout.isBlocked() && layout.block_[d] < t.extents_[d]) {
+        std::string b = std::to_string(layout.block_[d]);
+        add_term(scaled("(" + index + " / " + b + ")",
+                        layout.block_strides_[d]));
+        add_term(scaled("(" + index + " % " + b + ")", layout.strides_[d]));
+      } else if (layout.strides_[d] != 0) {
+        add_term(scaled(index, layout.strides_[d]));
+      }
+    }
+    return t.name + "[" + (s.empty() ? "0" : s) + "]";
+  }
+
+  const IRContext &ctx_;
+};
 
-  os << indent_level_code_gen(depth);
+// Emits C++ statements (Loop, Assign) with one level of indentation per depth.
+class StatementGenerator : public IRVisitor<StatementGenerator> {
+public:
+  StatementGenerator(const IRContext &ctx, const KernelTypes &types, int depth,
+                     std::ostream &os, unsigned unroll = 0)
+      : ctx_(ctx), types_(types), expr_(ctx), depth_(depth), os_(os),
+        unroll_(unroll), names_(ctx.symbols()) {}
 
-  switch (root->getType()) {
-  case IRNodeType::Loop: {
-    const Loop *loop = static_cast<const Loop *>(root);
+  void visitLoop(const Loop *loop) {
+    std::string lb_expr = expr_.visit(loop->lower_bound_);
+    std::string ub_expr = expr_.visit(loop->upper_bound_);
+    // Band loops of a recursive base case run over the current box
+    auto narrowed = narrowed_.find(loop);
+    if (narrowed != narrowed_.end()) {
+      lb_expr = narrowed->second.first;
+      ub_expr = narrowed->second.second;
+    }
+    std::string step_expr = expr_.visit(loop->step_);
 
-    std::string lb_expr = generateExpression(loop->lower_bound_.get());
-    std::string ub_expr = generateExpression(loop->upper_bound_.get());
-    std::string step_expr = generateExpression(loop->step_.get());
+    // Unroll hint for innermost loops (understood by GCC and Clang)
+    bool innermost = std::none_of(
+        loop->body_.begin(), loop->body_.end(), [](const IRNode *child) {
+          return child && child->getType() == IRNodeType::Loop;
+        });
+    if (unroll_ > 1 && innermost) {
+      os_ << indent_level_code_gen(depth_) << "#pragma GCC unroll " << unroll_
+          << "\n";
+    }
 
-    // Assuming loop index is an 'int' and step is positive for i += step format
-    os << "for (int " << loop->index_ << " = " << lb_expr << "; "
-       << loop->index_ << " < " << ub_expr << "; " << loop->index_
-       << " += " << step_expr << ") {\n";
+    // Loop counters use the inferred index type; the step is assumed positive
+    // for the i += step format
+    const std::string &index = ctx_.name(loop->index_);
+    os_ << indent_level_code_gen(depth_) << "for ("
+        << cTypeName(types_.index_type_) << " " << index << " = "
+        << lb_expr << "; " << index << " < " << ub_expr << "; " << index
+        << " += " << step_expr << ") {\n";
 
     // Recursively generate the body
-    for (const auto &child : loop->body_) {
-      codeGeneration(child.get(), depth + 1, os);
+    ++depth_;
+    for (const IRNode *child : loop->body_) {
+      visit(child);
     }
+    --depth_;
 
-    os << indent_level_code_gen(depth) << "}\n";
-    break;
+    os_ << indent_level_code_gen(depth_) << "}\n";
   }
 
-  case IRNodeType::Assign: {
-    const Assign *assign = static_cast<const Assign *>(root);
+  // Statements of a block are emitted in order at the current depth
+  void visitBlock(const Block *block) {
+    for (const IRNode *child : block->body_) {
+      visit(child);
+    }
+  }
 
-    std::string target_expr;
-    if (assign->target_->getType() == IRNodeType::Store) {
-      // Treat Store as the left-hand side assignment target
-      const Store *store = static_cast<const Store *>(assign->target_.get());
-      std::string access_str = store->tensor_.name + "[";
-      for (size_t i = 0; i < store->indices_.size(); ++i) {
-        access_str += generateExpression(store->indices_[i].get());
-        if (i < store->indices_.size() - 1)
-          access_str += ", ";
+  // A recursive generic lambda over one [lo, hi) range per band loop: it
+  // halves the range with the most iterations above its base size, lower
+  // half first, and runs the band over the box once none is left:
+  //
+  //   auto bisect = [&](auto &self, int i_lo, int i_hi, ...) -> void {
+  //       int i_n = i_hi - i_lo > 32 ? i_hi - i_lo : 0;
+  //       ...
+  //       if (i_n > 0 && i_n >= j_n) { int i_mid = i_lo + i_n / 2; ... }
+  //       else if (j_n > 0) { ... }
+  //       else { for (int i = i_lo; i < i_hi; i += 1) ... }
+  //   };
+  //   bisect(bisect, 0, N, 0, M);
+  //
+  // A band that is not a perfect nest of loops with constant positive steps
+  // and rectangular bounds (see collectBand) runs in its plain order instead.
+  void visitRecursiveNest(const RecursiveNest *nest) {
+    std::vector<const Loop *> band;
+    std::vector<int64_t> steps;
+    if (!collectBand(nest->band_, nest->base_sizes_.size(), band, steps)) {
+      visit(nest->band_);
+      return;
+    }
+
+    // Per band loop: its range, remaining iterations and split point
+    struct Range {
+      std::string lo, hi, n, mid;
+    };
+    const std::string type = cTypeName(types_.index_type_);
+    const std::string bisect = fresh("bisect");
+    const std::string self = fresh("self");
+    std::vector<Range> ranges;
+    std::string params;
+    std::string entry;
+    for (const Loop *loop : band) {
+      const std::string &name = ctx_.name(loop->index_);
+      ranges.push_back({fresh(name + "_lo"), fresh(name + "_hi"),
+                        fresh(name + "_n"), fresh(name + "_mid")});
+      params += ", " + type + " " + ranges.back().lo + ", " + type + " " +
+                ranges.back().hi;
+      entry += ", " + expr_.visit(loop->lower_bound_) + ", " +
+               expr_.visit(loop->upper_bound_);
+    }
+    auto args = [&](size_t split, const std::string &lo,
+                    const std::string &hi) {
+      std::string out = self;
+      for (size_t d = 0; d < band.size(); ++d) {
+        out += ", " + (d == split ? lo : ranges[d].lo) + ", " +
+               (d == split ? hi : ranges[d].hi);
+      }
+      return out;
+    };
+
+    os_ << indent_level_code_gen(depth_) << "{\n";
+    ++depth_;
+    os_ << indent_level_code_gen(depth_) << "auto " << bisect
+        << " = [&](auto &" << self << params << ") -> void {\n";
+    ++depth_;
+    // Remaining iterations per range, 0 once it is down to the base size
+    for (size_t d = 0; d < band.size(); ++d) {
+      const Range &r = ranges[d];
+      std::string trips = r.hi + " - " + r.lo;
+      if (steps[d] != 1) {
+        trips = "(" + trips + " + " + std::to_string(steps[d] - 1) + ") / " +
+                std::to_string(steps[d]);
+      }
+      int64_t base = std::max<int64_t>(nest->base_sizes_[d] / steps[d], 1);
+      os_ << indent_level_code_gen(depth_) << type << " " << r.n << " = "
+          << trips << " > " << base << " ? " << trips << " : 0;\n";
+    }
+    for (size_t d = 0; d < band.size(); ++d) {
+      const Range &r = ranges[d];
+      std::string cond = r.n + " > 0";
+      for (size_t e = d + 1; e < band.size(); ++e) {
+        cond += " && " + r.n + " >= " + ranges[e].n;
+      }
+      os_ << indent_level_code_gen(depth_) << (d ? "} else if (" : "if (")
+          << cond << ") {\n";
+      ++depth_;
+      std::string half = r.n + " / 2";
+      if (steps[d] != 1) {
+        half += " * " + std::to_string(steps[d]);
       }
-      access_str += "]";
-      target_expr = access_str;
-    } else if (assign->target_->getType() == IRNodeType::Variable) {
-      target_expr =
-          static_cast<const Variable *>(assign->target_.get())->getName();
+      os_ << indent_level_code_gen(depth_) << type << " " << r.mid << " = "
+          << r.lo << " + " << half << ";\n";
+      os_ << indent_level_code_gen(depth_) << self << "("
+          << args(d, r.lo, r.mid) << ");\n";
+      os_ << indent_level_code_gen(depth_) << self << "("
+          << args(d, r.mid, r.hi) << ");\n";
+      --depth_;
+    }
+    os_ << indent_level_code_gen(depth_) << "} else {\n";
+    ++depth_;
+    for (size_t d = 0; d < band.size(); ++d) {
+      narrowed_[band[d]] = {ranges[d].lo, ranges[d].hi};
+    }
+    visit(nest->band_);
+    for (const Loop *loop : band) {
+      narrowed_.erase(loop);
+    }
+    --depth_;
+    os_ << indent_level_code_gen(depth_) << "}\n";
+    --depth_;
+    os_ << indent_level_code_gen(depth_) << "};\n";
+    os_ << indent_level_code_gen(depth_) << bisect << "(" << bisect << entry
+        << ");\n";
+    --depth_;
+    os_ << indent_level_code_gen(depth_) << "}\n";
+  }
+
+  // The grid of (o, i) trips is covered by squares whose side is the largest
+  // power of two that fits both trip counts, taken row by row; within each
+  // square one loop over its positions decodes each position into a trip of
+  // both loops:
+  //
+  //   int ii_n = (N + 31) / 32;
+  //   int jj_n = (M + 31) / 32;
+  //   int ii_jj_side = 1;
+  //   while (2 * ii_jj_side <= ii_n && 2 * ii_jj_side <= jj_n) { ... }
+  //   for (int ii_b = 0; ii_b < ii_n; ii_b += ii_jj_side) {
+  //       for (int jj_b = 0; jj_b < jj_n; jj_b += ii_jj_side) {
+  //           for (long long ii_jj = 0; ii_jj < ...; ++ii_jj) {
+  //               int ii_c = 0;
+  //               int jj_c = 0;
+  //               for (int b = 0; (1 << b) < ii_jj_side; ++b) { ... }
+  //               ii_c += ii_b;
+  //               jj_c += jj_b;
+  //               if (ii_c >= ii_n || jj_c >= jj_n) { continue; }
+  //               int ii = ii_c * 32;
+  //               int jj = jj_c * 32;
+  //               ...
+  //
+  // A skinny grid thus runs many small curves instead of one mostly empty
+  // square; at most a quarter of the positions fall outside the grid.
+  // Positions are 64-bit, since the square can hold more positions than the
+  // index type. Same fallback as for a RecursiveNest.
+  void visitCurveNest(const CurveNest *nest) {
+    std::vector<const Loop *> band;
+    std::vector<int64_t> steps;
+    if (nest->curve_ == CurveOrder::RowMajor ||
+        !collectBand(nest->band_, 2, band, steps)) {
+      visit(nest->band_);
+      return;
+    }
+
+    const std::string type = cTypeName(types_.index_type_);
+    const std::string o = ctx_.name(band[0]->index_);
+    const std::string i = ctx_.name(band[1]->index_);
+    const std::string pos = fresh(o + "_" + i);
+    const std::string side = fresh(o + "_" + i + "_side");
+    const std::string o_n = fresh(o + "_n");
+    const std::string i_n = fresh(i + "_n");
+    const std::string o_b = fresh(o + "_b");
+    const std::string i_b = fresh(i + "_b");
+    const std::string o_c = fresh(o + "_c");
+    const std::string i_c = fresh(i + "_c");
+    auto emit = [this](const std::string &line) {
+      os_ << indent_level_code_gen(depth_) << line << "\n";
+    };
+
+    emit("{");
+    ++depth_;
+    std::vector<std::string> lbs;
+    for (size_t d = 0; d < 2; ++d) {
+      lbs.push_back(expr_.visit(band[d]->lower_bound_));
+      std::string trips = expr_.visit(band[d]->upper_bound_);
+      if (lbs[d] != "0") {
+        trips += " - " + lbs[d];
+      }
+      if (steps[d] != 1) {
+        trips = "(" + trips + " + " + std::to_string(steps[d] - 1) + ") / " +
+                std::to_string(steps[d]);
+      }
+      emit(type + " " + (d ? i_n : o_n) + " = " + trips + ";");
+    }
+    emit(type + " " + side + " = 1;");
+    emit("while (2 * " + side + " <= " + o_n + " && 2 * " + side + " <= " +
+         i_n + ") {");
+    emit("    " + side + " *= 2;");
+    emit("}");
+    emit("for (" + type + " " + o_b + " = 0; " + o_b + " < " + o_n + "; " +
+         o_b + " += " + side + ") {");
+    ++depth_;
+    emit("for (" + type + " " + i_b + " = 0; " + i_b + " < " + i_n + "; " +
+         i_b + " += " + side + ") {");
+    ++depth_;
+    emit("for (long long " + pos + " = 0; " + pos +
+         " < static_cast<long long>(" + side + ") * " + side + "; ++" + pos +
+         ") {");
+    ++depth_;
+    emit(type + " " + o_c + " = 0;");
+    emit(type + " " + i_c + " = 0;");
+    if (nest->curve_ == CurveOrder::Morton) {
+      // Odd bits of the position give the outer trip, even bits the inner
+      const std::string b = fresh("b");
+      emit("for (int " + b + " = 0; (1LL << " + b + ") < " + side + "; ++" +
+           b + ") {");
+      emit("    " + o_c + " |= ((" + pos + " >> (2 * " + b + " + 1)) & 1) << " +
+           b + ";");
+      emit("    " + i_c + " |= ((" + pos + " >> (2 * " + b + ")) & 1) << " +
+           b + ";");
+      emit("}");
+    } else {
+      // Hilbert curve, quadrant by quadrant from the finest
+      const std::string s = fresh("s");
+      const std::string r = fresh("r");
+      const std::string rx = fresh("rx");
+      const std::string ry = fresh("ry");
+      emit("for (long long " + s + " = 1, " + r + " = " + pos + "; " + s +
+           " < " + side + "; " + s + " *= 2, " + r + " /= 4) {");
+      ++depth_;
+      emit("long long " + rx + " = 1 & (" + r + " / 2);");
+      emit("long long " + ry + " = 1 & (" + r + " ^ " + rx + ");");
+      emit("if (" + ry + " == 0) {");
+      emit("    if (" + rx + " == 1) {");
+      emit("        " + o_c + " = " + s + " - 1 - " + o_c + ";");
+      emit("        " + i_c + " = " + s + " - 1 - " + i_c + ";");
+      emit("    }");
+      emit("    std::swap(" + o_c + ", " + i_c + ");");
+      emit("}");
+      emit(o_c + " += " + s + " * " + rx + ";");
+      emit(i_c + " += " + s + " * " + ry + ";");
+      --depth_;
+      emit("}");
+    }
+    emit(o_c + " += " + o_b + ";");
+    emit(i_c + " += " + i_b + ";");
+    emit("if (" + o_c + " >= " + o_n + " || " + i_c + " >= " + i_n + ") {");
+    emit("    continue;");
+    emit("}");
+    for (size_t d = 0; d < 2; ++d) {
+      std::string offset = d ? i_c : o_c;
+      if (steps[d] != 1) {
+        offset += " * " + std::to_string(steps[d]);
+      }
+      emit(type + " " + (d ? i : o) + " = " +
+           (lbs[d] == "0" ? offset : lbs[d] + " + " + offset) + ";");
+    }
+    for (const IRNode *child : band[1]->body_) {
+      visit(child);
+    }
+    for (int close = 0; close < 4; ++close) {
+      --depth_;
+      emit("}");
+    }
+  }
+
+  void visitAssign(const Assign *assign) {
+    std::string target_expr;
+    IRNodeType target_type = assign->target_->getType();
+    if (target_type == IRNodeType::Store ||
+        target_type == IRNodeType::Variable) {
+      target_expr = expr_.visit(assign->target_);
     } else {
       target_expr = "/* INVALID_TARGET */";
     }
 
     // Value is the recursive expression generation
-    std::string value_expr = generateExpression(assign->value_.get());
+    std::string value_expr = expr_.visit(assign->value_);
 
-    os << target_expr << " = " << value_expr << ";\n";
-    break;
+    // Make narrowing conversions to the stored element type explicit
+    if (target_type == IRNodeType::Store) {
+      DType target_dtype =
+          static_cast<const Store *>(assign->target_)->tensor_.dtype_;
+      if (types_.typeOf(assign->value_) != target_dtype) {
+        value_expr = std::string("static_cast<") + cTypeName(target_dtype) +
+                     ">(" + value_expr + ")";
+      }
+    }
+
+    os_ << indent_level_code_gen(depth_) << target_expr << " = " << value_expr
+        << ";\n";
+  }
+
+  // Skip all other nodes as they are handled as parts of expressions (Load,
+  // Const, etc.)
+
+private:
+  // The outermost `depth` loops of a perfect band with constant positive
+  // steps and rectangular bounds, as RecursiveNest and CurveNest require.
+  static bool collectBand(const IRNode *node, size_t depth,
+                          std::vector<const Loop *> &band,
+                          std::vector<int64_t> &steps) {
+    while (depth > 0 && band.size() < depth && node &&
+           node->getType() == IRNodeType::Loop) {
+      const Loop *loop = static_cast<const Loop *>(node);
+      std::optional<AffineExpr> step = toAffine(loop->step_);
+      bool rectangular = std::none_of(
+          band.begin(), band.end(), [loop](const Loop *outer) {
+            return mentions(loop->lower_bound_, outer->index_) ||
+                   mentions(loop->upper_bound_, outer->index_);
+          });
+      if (!step || !step->isConstant() || step->constant() <= 0 ||
+          !rectangular) {
+        return false;
+      }
+      band.push_back(loop);
+      steps.push_back(step->constant());
+      node = loop->body_.size() == 1 ? loop->body_.front() : nullptr;
+    }
+    return depth > 0 && band.size() == depth;
   }
 
-  default:
-    // Skip all other nodes as they are handled as parts of expressions (Load,
-    // Const, etc.)
-    break;
+  // Name for a helper variable of the generated code that no symbol of the
+  // program, and no other helper, uses.
+  std::string fresh(const std::string &hint) {
+    return names_.name(names_.fresh(hint));
   }
+
+  const IRContext &ctx_;
+  const KernelTypes &types_;
+  ExpressionGenerator expr_;
+  int depth_;
+  std::ostream &os_;
+  unsigned unroll_;
+  // The context's symbols plus the helper names handed out so far.
+  SymbolTable names_;
+  // Bounds of the band loops of the recursive base case being emitted
+  std::map<const Loop *, std::pair<std::string, std::string>> narrowed_;
+};
+
+} // namespace
+
+/**
+ * @brief Recursively generates the C++ code for an expression (Const, Variable,
+ * Add, Mul, Min, Load).
+ *
+ * @param ctx The context owning the expression (used to resolve symbol names).
+ * @param node A pointer to the root of the expression IRNode.
+ * @return A string containing the C++ representation of the expression.
+ */
+std::string generateExpression(const IRContext &ctx, const IRNode *node) {
+  return ExpressionGenerator(ctx).visit(node);
 }
 
-void generateCodeFiles(const IRNode *untiled_root, const IRNode *tiled_root,
+/**
+ * @brief Recursively generates C++ code from the IR tree into an output stream.
+ *
+ * @param ctx The context owning the tree (used to resolve symbol names).
+ * @param root A pointer to the root of the IRNode subtree to generate code for.
+ * @param depth The current indentation level.
+ * @param os The output stream to write the generated C++ code to.
+ */
+void codeGeneration(const IRContext &ctx, const IRNode *root, int depth,
+                    std::ostream &os) {
+  KernelTypes types = TypeAnalysis::run(ctx, root);
+  StatementGenerator(ctx, types, depth, os).visit(root);
+}
+
+/**
+ * @brief Generates one kernel as a standalone C++ function: a flat pointer per
+ * accessed tensor, then one index-typed parameter per free size symbol, each
+ * sorted by name. Local tensors and scalars are declared at the top of the
+ * body instead. Needs <algorithm> for std::min, <cstdlib> for local buffers
+ * beyond CodeGenOptions::max_stack_bytes_ (the kernel calls std::abort if
+ * one cannot be allocated), and C++14 for the generic lambda of a
+ * RecursiveNest.
+ *
+ * @param ctx The context owning the tree.
+ * @param root The root of the kernel.
+ * @param name The name of the generated function.
+ * @param os The output stream to write the function to.
+ * @param options Code generation options.
+ */
+void generateKernel(const IRContext &ctx, const IRNode *root,
+                    const std::string &name, std::ostream &os,
+                    const CodeGenOptions &options) {
+  // One flat pointer per accessed tensor, then one index-typed parameter
+  // per free size symbol (N, M, ...)
+  KernelTypes types = TypeAnalysis::run(ctx, root);
+  std::string pointers;
+  for (const Tensor *t : types.tensors_) {
+    if (t->local_) {
+      continue;
+    }
+    pointers += std::string(pointers.empty() ? "" : ", ") +
+                cTypeName(t->dtype_) + " *" + t->name;
+  }
+  std::string sizes;
+  for (Symbol param : types.params_) {
+    sizes += std::string(sizes.empty() ? "" : ", ") +
+             cTypeName(types.index_type_) + " " + ctx.name(param);
+  }
+  os << "void " << name << "(\n";
+  if (!pointers.empty()) {
+    os << "    " << pointers << (sizes.empty() ? ") {" : ",")
+       << " // Array data pointers\n";
+  }
+  if (!sizes.empty() || pointers.empty()) {
+    os << "    " << sizes << ") {\n";
+  }
+
+  // Let the compiler rely on each layout's base-address alignment
+  for (const Tensor *t : types.tensors_) {
+    if (t->layout_.alignment_ > 0 && !t->local_) {
+      const char *type = cTypeName(t->dtype_);
+      os << "    " << t->name << " = static_cast<" << type
+         << " *>(__builtin_assume_aligned(" << t->name << ", "
+         << t->layout_.alignment_ << "));\n";
+    }
+  }
+
+  // Local buffers (e.g. packed operand tiles) live on the stack while they
+  // fit in options.max_stack_bytes_ together; larger ones are allocated once
+  // per call and freed at the end. The kernel cannot report errors, so it
+  // aborts if an allocation fails rather than packing through a null pointer
+  std::vector<const Tensor *> heap;
+  size_t stack_bytes = 0;
+  for (const Tensor *t : types.tensors_) {
+    if (!t->local_) {
+      continue;
+    }
+    const char *type = cTypeName(t->dtype_);
+    const size_t bytes = t->layout_.size_ * dtypeSize(t->dtype_);
+    if (stack_bytes + bytes > options.max_stack_bytes_) {
+      // aligned_alloc needs a multiple of the alignment
+      const size_t align = std::max<size_t>(t->layout_.alignment_, 64);
+      os << "    " << type << " *" << t->name << " = static_cast<" << type
+         << " *>(std::aligned_alloc(" << align << ", "
+         << (bytes + align - 1) / align * align << "));\n";
+      os << "    if (!" << t->name << ") {\n";
+      os << "        std::abort();\n";
+      os << "    }\n";
+      heap.push_back(t);
+      continue;
+    }
+    stack_bytes += bytes;
+    os << "    ";
+    if (t->layout_.alignment_ > 0) {
+      os << "alignas(" << t->layout_.alignment_ << ") ";
+    }
+    os << type << " " << t->name << "[" << t->layout_.size_ << "];\n";
+  }
+
+  // Scalar locals (e.g. register-block accumulators) are assigned before use
+  for (const auto &[sym, dtype] : types.locals_) {
+    os << "    " << cTypeName(dtype) << " " << ctx.name(sym) << ";\n";
+  }
+
+  // --- Kernel Body Generation ---
+  StatementGenerator(ctx, types, 1, os, options.unroll_).visit(root);
+
+  for (const Tensor *t : heap) {
+    os << "    std::free(" << t->name << ");\n";
+  }
+  os << "}\n";
+}
+
+void generateCodeFiles(const IRContext &ctx, const IRNode *untiled_root,
+                       const IRNode *tiled_root,
                        const std::string &kernel_type) {
 
   // Helper function to print the code to a given stream (now always std::cout)
@@ -153,20 +624,14 @@ void generateCodeFiles(const IRNode *untiled_root, const IRNode *tiled_root,
     // --- Standard C++ Boilerplate Header ---
     os << "#include <algorithm>\n";
     os << "#include <iostream>\n";
-    os << "#include <cmath>\n\n";
+    os << "#include <cmath>\n";
+    os << "#include <cstdlib>\n\n";
 
     os << "/**\n";
     os << " * Generated kernel: " << full_kernel_name << "\n";
     os << " */\n";
-    // The function signature assumes 1D flat array pointers and a size N
-    os << "void " << full_kernel_name << "(\n";
-    os << "    float *A, float *B, float *C, // Array data pointers\n";
-    os << "    int N) {\n"; // N is the dimension size (e.g., 1024)
-
-    // --- Kernel Body Generation ---
-    codeGeneration(root, 1, os);
-
-    os << "}\n\n";
+    generateKernel(ctx, root, full_kernel_name, os);
+    os << "\n";
 
     // Example boilerplate for testing
     os << "/*\n";
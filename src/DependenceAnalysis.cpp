@@ -0,0 +1,556 @@
+#include "DependenceAnalysis.hpp"
+#include "AffineExpr.hpp"
+#include "IRVisitor.hpp"
+#include "StructuralHash.hpp"
+#include <algorithm>
+#include <numeric>
+#include <set>
+#include <string>
+#include <utility>
+
+namespace {
+
+// Stands in for a bound that is not known. Index values are assumed to stay
+// well inside it, which keeps the Banerjee sums exact in 64 bits.
+constexpr int64_t kUnbounded = int64_t{1} << 30;
+
+struct Range {
+  int64_t lo_ = -kUnbounded;
+  int64_t hi_ = kUnbounded;
+};
+
+// Bounds of a loop's index: its constant bounds, tightened by the extent of
+// any tensor dimension the index addresses directly.
+Range indexRange(const Loop *loop, const AccessInfo &accesses) {
+  Range r;
+  std::optional<AffineExpr> lb = toAffine(loop->lower_bound_);
+  std::optional<AffineExpr> ub = toAffine(loop->upper_bound_);
+  if (lb && lb->isConstant()) {
+    r.lo_ = std::max(r.lo_, lb->constant());
+  }
+  if (ub && ub->isConstant()) {
+    r.hi_ = std::min(r.hi_, ub->constant() - 1);
+  }
+  const AffineExpr index = AffineExpr::symbol(loop->index_);
+  for (const MemoryAccess &access : accesses.accesses_) {
+    if (std::find(access.loops_.begin(), access.loops_.end(), loop) ==
+        access.loops_.end()) {
+      continue;
+    }
+    for (size_t d = 0; d < access.indices_->size(); ++d) {
+      std::optional<AffineExpr> sub = toAffine((*access.indices_)[d]);
+      if (sub && *sub == index) {
+        r.lo_ = std::max<int64_t>(r.lo_, 0);
+        r.hi_ = std::min(r.hi_,
+                         static_cast<int64_t>(access.tensor_->extents_[d]) - 1);
+      }
+    }
+  }
+  return r;
+}
+
+// Innermost loop of `loops` with index `sym`, or -1.
+int enclosingLoop(const std::vector<const Loop *> &loops, Symbol sym) {
+  for (size_t p = loops.size(); p-- > 0;) {
+    if (loops[p]->index_ == sym) {
+      return static_cast<int>(p);
+    }
+  }
+  return -1;
+}
+
+/**
+ * @brief One subscript position of a source/sink pair, as the equation
+ *
+ *   sum_p (a_p x_p - b_p y_p) + sum_v c_v v = rhs_
+ *
+ * where x_p and y_p are the source and sink iterations of common loop p and v
+ * ranges over every other symbol (loops enclosing only one access, size
+ * parameters).
+ */
+struct SubscriptEquation {
+  std::vector<std::pair<int64_t, int64_t>> common_; // (a_p, b_p)
+  std::vector<std::pair<int64_t, Range>> free_;     // (c_v, range of v)
+  int64_t rhs_ = 0;
+};
+
+struct Interval {
+  int64_t min_ = 0;
+  int64_t max_ = 0;
+
+  // Adds the extremes of a linear function attained at one of `values`.
+  void add(std::initializer_list<int64_t> values) {
+    min_ += std::min(values);
+    max_ += std::max(values);
+  }
+};
+
+/**
+ * @brief GCD and Banerjee tests of one equation under a direction vector.
+ *
+ * For '<' the sink iteration is written y = x + t with t >= 1, so the pair
+ * contributes (a - b) x - b t over the triangle x >= lo, t >= 1,
+ * x + t <= hi, whose extremes lie at its three corners; '>' is symmetric.
+ * @return false if the equation has no integer solution in the region.
+ */
+bool mayDepend(const SubscriptEquation &eq,
+               const std::vector<DepDirection> &direction,
+               const std::vector<Range> &ranges) {
+  int64_t g = 0;
+  Interval sum;
+  for (size_t p = 0; p < direction.size(); ++p) {
+    const auto [a, b] = eq.common_[p];
+    const Range &r = ranges[p];
+    if (r.lo_ > r.hi_) {
+      return false; // The loop runs no iteration.
+    }
+    switch (direction[p]) {
+    case DepDirection::Eq:
+      g = std::gcd(g, a - b);
+      sum.add({(a - b) * r.lo_, (a - b) * r.hi_});
+      break;
+    case DepDirection::Lt:
+    case DepDirection::Gt: {
+      if (r.hi_ - r.lo_ < 1) {
+        return false; // A single iteration carries nothing.
+      }
+      g = std::gcd(g, std::gcd(a, b));
+      // (x coefficient, t coefficient) after substituting the other index.
+      const int64_t cx = a - b;
+      const int64_t ct = direction[p] == DepDirection::Lt ? -b : a;
+      sum.add({cx * r.lo_ + ct, cx * r.lo_ + ct * (r.hi_ - r.lo_),
+               cx * (r.hi_ - 1) + ct});
+      break;
+    }
+    }
+  }
+  for (const auto &[c, r] : eq.free_) {
+    g = std::gcd(g, c);
+    sum.add({c * r.lo_, c * r.hi_});
+  }
+  if (g == 0) {
+    return eq.rhs_ == 0;
+  }
+  return eq.rhs_ % g == 0 && sum.min_ <= eq.rhs_ && eq.rhs_ <= sum.max_;
+}
+
+// Finds every direction vector of one ordered pair of accesses.
+class PairTester {
+public:
+  PairTester(const AccessInfo &accesses, size_t source, size_t sink)
+      : source_(accesses.accesses_[source]), sink_(accesses.accesses_[sink]),
+        source_first_(source < sink) {
+    while (common_.size() < std::min(source_.loops_.size(),
+                                     sink_.loops_.size()) &&
+           source_.loops_[common_.size()] == sink_.loops_[common_.size()]) {
+      common_.push_back(source_.loops_[common_.size()]);
+    }
+    for (const Loop *loop : common_) {
+      ranges_.push_back(indexRange(loop, accesses));
+    }
+
+    // Symbols of loops that enclose only one of the accesses.
+    auto private_range = [&](const MemoryAccess &access, Symbol sym) {
+      int p = enclosingLoop(access.loops_, sym);
+      if (p < static_cast<int>(common_.size())) {
+        return std::optional<Range>();
+      }
+      return std::optional<Range>(indexRange(access.loops_[p], accesses));
+    };
+
+    for (size_t d = 0; d < source_.indices_->size(); ++d) {
+      std::optional<AffineExpr> f = toAffine((*source_.indices_)[d]);
+      std::optional<AffineExpr> h = toAffine((*sink_.indices_)[d]);
+      if (!f || !h) {
+        continue; // No constraint from a non-affine subscript.
+      }
+      SubscriptEquation eq;
+      eq.rhs_ = h->constant() - f->constant();
+      eq.common_.assign(common_.size(), {0, 0});
+      // Size parameters take the same value at both ends.
+      std::vector<std::pair<Symbol, int64_t>> params;
+      auto add_term = [&](const MemoryAccess &access, Symbol sym, int64_t c,
+                          bool is_source) {
+        int p = enclosingLoop(access.loops_, sym);
+        if (p >= 0 && p < static_cast<int>(common_.size())) {
+          (is_source ? eq.common_[p].first : eq.common_[p].second) += c;
+        } else if (std::optional<Range> r = private_range(access, sym)) {
+          eq.free_.emplace_back(is_source ? c : -c, *r);
+        } else {
+          params.emplace_back(sym, is_source ? c : -c);
+        }
+      };
+      for (const auto &[sym, c] : f->terms()) {
+        add_term(source_, sym, c, /*is_source=*/true);
+      }
+      for (const auto &[sym, c] : h->terms()) {
+        add_term(sink_, sym, c, /*is_source=*/false);
+      }
+      std::sort(params.begin(), params.end());
+      for (size_t i = 0; i < params.size();) {
+        int64_t c = 0;
+        size_t j = i;
+        for (; j < params.size() && params[j].first == params[i].first; ++j) {
+          c += params[j].second;
+        }
+        if (c != 0) {
+          eq.free_.emplace_back(c, Range{0, kUnbounded});
+        }
+        i = j;
+      }
+      equations_.push_back(std::move(eq));
+    }
+  }
+
+  const std::vector<const Loop *> &commonLoops() const { return common_; }
+
+  // Lexicographically non-negative direction vectors with a solution; an
+  // all-'=' vector only if the source comes first in program order.
+  std::vector<std::vector<DepDirection>> directions() {
+    std::vector<std::vector<DepDirection>> out;
+    std::vector<DepDirection> prefix;
+    refine(prefix, /*carried=*/false, out);
+    return out;
+  }
+
+  // Sink minus source index of common loop p, if the subscripts fix it.
+  std::optional<int64_t> distance(size_t p, DepDirection direction) const {
+    if (direction == DepDirection::Eq) {
+      return 0;
+    }
+    for (const SubscriptEquation &eq : equations_) {
+      // a x_p - a y_p = rhs with no other symbol: y_p - x_p = -rhs / a.
+      const auto [a, b] = eq.common_[p];
+      bool alone = a != 0 && a == b && eq.free_.empty();
+      for (size_t q = 0; alone && q < eq.common_.size(); ++q) {
+        alone = q == p || (eq.common_[q].first == 0 &&
+                           eq.common_[q].second == 0);
+      }
+      if (alone && eq.rhs_ % a == 0) {
+        return -eq.rhs_ / a;
+      }
+    }
+    return std::nullopt;
+  }
+
+private:
+  // Components not yet fixed are left free (no constraint), which is what
+  // a '*' would mean; vectors are refined one loop at a time and pruned as
+  // soon as some equation has no solution.
+  bool feasible(const std::vector<DepDirection> &prefix) const {
+    std::vector<DepDirection> direction = prefix;
+    std::vector<Range> ranges(ranges_.begin(),
+                              ranges_.begin() + prefix.size());
+    for (const SubscriptEquation &eq : equations_) {
+      SubscriptEquation fixed = eq;
+      fixed.common_.resize(prefix.size());
+      for (size_t p = prefix.size(); p < common_.size(); ++p) {
+        fixed.free_.emplace_back(eq.common_[p].first, ranges_[p]);
+        fixed.free_.emplace_back(-eq.common_[p].second, ranges_[p]);
+      }
+      if (!mayDepend(fixed, direction, ranges)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void refine(std::vector<DepDirection> &prefix, bool carried,
+              std::vector<std::vector<DepDirection>> &out) const {
+    if (!feasible(prefix)) {
+      return;
+    }
+    if (prefix.size() == common_.size()) {
+      if (carried || source_first_) {
+        out.push_back(prefix);
+      }
+      return;
+    }
+    for (DepDirection d :
+         {DepDirection::Lt, DepDirection::Eq, DepDirection::Gt}) {
+      // A '>' before any '<' would run the sink first.
+      if (d == DepDirection::Gt && !carried) {
+        continue;
+      }
+      prefix.push_back(d);
+      refine(prefix, carried || d == DepDirection::Lt, out);
+      prefix.pop_back();
+    }
+  }
+
+  const MemoryAccess &source_;
+  const MemoryAccess &sink_;
+  const bool source_first_;
+  std::vector<const Loop *> common_;
+  std::vector<Range> ranges_;
+  std::vector<SubscriptEquation> equations_;
+};
+
+// Collects the load/store pairs of updates `X[f] = X[f] op y`.
+class ReductionCollector : public RecursiveIRVisitor<ReductionCollector> {
+public:
+  ReductionCollector(const IRContext &ctx,
+                     std::set<std::pair<const IRNode *, const IRNode *>> &out)
+      : ctx_(ctx), out_(out) {}
+
+  void visitAssign(const Assign *assign) {
+    if (!assign->target_ || assign->target_->getType() != IRNodeType::Store ||
+        !assign->value_) {
+      return;
+    }
+    const IRNodeType op = assign->value_->getType();
+    if (op != IRNodeType::Add && op != IRNodeType::Mul &&
+        op != IRNodeType::Min) {
+      return;
+    }
+    const Store *store = static_cast<const Store *>(assign->target_);
+    const Add *update = static_cast<const Add *>(assign->value_);
+    for (const IRNode *operand : {update->operand_one_, update->operand_two_}) {
+      if (!operand || operand->getType() != IRNodeType::Load) {
+        continue;
+      }
+      const Load *load = static_cast<const Load *>(operand);
+      if (load->tensor_.name != store->tensor_.name ||
+          load->indices_.size() != store->indices_.size()) {
+        continue;
+      }
+      bool same = true;
+      for (size_t d = 0; same && d < load->indices_.size(); ++d) {
+        same = structurallyEqual(ctx_, load->indices_[d], store->indices_[d]);
+      }
+      if (same) {
+        out_.emplace(load, store);
+        out_.emplace(store, store);
+      }
+    }
+  }
+
+private:
+  const IRContext &ctx_;
+  std::set<std::pair<const IRNode *, const IRNode *>> &out_;
+};
+
+// Collects the loops enclosing an assignment to a scalar local.
+class ScalarLoopCollector : public RecursiveIRVisitor<ScalarLoopCollector> {
+public:
+  explicit ScalarLoopCollector(std::vector<const Loop *> &out) : out_(out) {}
+
+  void visitLoop(const Loop *loop) {
+    enclosing_.push_back(loop);
+    RecursiveIRVisitor::visitLoop(loop);
+    enclosing_.pop_back();
+  }
+
+  void visitAssign(const Assign *assign) {
+    if (!assign->target_ ||
+        assign->target_->getType() != IRNodeType::Variable) {
+      return;
+    }
+    for (const Loop *loop : enclosing_) {
+      if (std::find(out_.begin(), out_.end(), loop) == out_.end()) {
+        out_.push_back(loop);
+      }
+    }
+  }
+
+private:
+  std::vector<const Loop *> &out_;
+  std::vector<const Loop *> enclosing_;
+};
+
+const char *directionString(DepDirection d) {
+  switch (d) {
+  case DepDirection::Lt:
+    return "<";
+  case DepDirection::Eq:
+    return "=";
+  case DepDirection::Gt:
+    return ">";
+  }
+  return "?";
+}
+
+std::string accessString(const IRContext &ctx, const MemoryAccess &access) {
+  std::string s = access.tensor_->name + "[";
+  for (size_t d = 0; d < access.indices_->size(); ++d) {
+    std::optional<AffineExpr> sub = toAffine((*access.indices_)[d]);
+    s += (d ? ", " : "") + (sub ? sub->toString(ctx) : std::string("?"));
+  }
+  return s + "]";
+}
+
+} // namespace
+
+size_t Dependence::level() const {
+  for (size_t p = 0; p < direction_.size(); ++p) {
+    if (direction_[p] != DepDirection::Eq) {
+      return p;
+    }
+  }
+  return direction_.size();
+}
+
+bool Dependence::carriedBy(const Loop *loop) const {
+  size_t p = level();
+  return p < loops_.size() && loops_[p] == loop;
+}
+
+bool DependenceInfo::isParallel(const Loop *loop, bool allow_reductions) const {
+  if (std::find(scalar_loops_.begin(), scalar_loops_.end(), loop) !=
+      scalar_loops_.end()) {
+    return false;
+  }
+  for (const Dependence &dep : dependences_) {
+    if (dep.carriedBy(loop) && !(allow_reductions && dep.reduction_)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool DependenceInfo::isPermutable(const std::vector<const Loop *> &band) const {
+  if (band.empty()) {
+    return true;
+  }
+  if (band.size() > 1 && touchesScalars(band)) {
+    return false;
+  }
+  for (const Dependence &dep : dependences_) {
+    auto first = std::find(dep.loops_.begin(), dep.loops_.end(), band.front());
+    if (first == dep.loops_.end()) {
+      continue; // The accesses do not share the band.
+    }
+    const size_t begin = first - dep.loops_.begin();
+    if (dep.level() < begin) {
+      continue; // Carried outside the band.
+    }
+    for (size_t p = begin; p < begin + band.size() && p < dep.loops_.size();
+         ++p) {
+      if (dep.direction_[p] == DepDirection::Gt) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool DependenceInfo::isLegalOrder(const std::vector<const Loop *> &band,
+                                  const std::vector<size_t> &order) const {
+  if (band.empty()) {
+    return true;
+  }
+  if (!std::is_sorted(order.begin(), order.end()) && touchesScalars(band)) {
+    return false;
+  }
+  for (const Dependence &dep : dependences_) {
+    auto first = std::find(dep.loops_.begin(), dep.loops_.end(), band.front());
+    if (first == dep.loops_.end()) {
+      continue;
+    }
+    const size_t begin = first - dep.loops_.begin();
+    if (dep.level() < begin) {
+      continue;
+    }
+    // The first non-'=' component in the new order must still be '<'.
+    for (size_t d : order) {
+      if (begin + d >= dep.loops_.size()) {
+        continue;
+      }
+      DepDirection component = dep.direction_[begin + d];
+      if (component == DepDirection::Gt) {
+        return false;
+      }
+      if (component == DepDirection::Lt) {
+        break;
+      }
+    }
+  }
+  return true;
+}
+
+bool DependenceInfo::touchesScalars(
+    const std::vector<const Loop *> &band) const {
+  for (const Loop *loop : band) {
+    if (std::find(scalar_loops_.begin(), scalar_loops_.end(), loop) !=
+        scalar_loops_.end()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void DependenceInfo::print(const IRContext &ctx, std::ostream &os) const {
+  static const char *kinds[] = {"flow", "anti", "output"};
+  for (const Dependence &dep : dependences_) {
+    os << kinds[static_cast<int>(dep.kind_)] << " "
+       << accessString(ctx, accesses_.accesses_[dep.source_]) << " -> "
+       << accessString(ctx, accesses_.accesses_[dep.sink_]) << " (";
+    for (size_t p = 0; p < dep.direction_.size(); ++p) {
+      os << (p ? ", " : "") << directionString(dep.direction_[p]);
+    }
+    os << ") distance (";
+    for (size_t p = 0; p < dep.distance_.size(); ++p) {
+      os << (p ? ", " : "");
+      if (dep.distance_[p]) {
+        os << *dep.distance_[p];
+      } else {
+        os << "?";
+      }
+    }
+    os << ")" << (dep.reduction_ ? " reduction" : "") << "\n";
+  }
+}
+
+/**
+ * @brief Computes the dependences between every pair of accesses under
+ * `root` that touch the same tensor, at least one of them a write.
+ *
+ * Each subscript position gives one linear equation between the source and
+ * sink iterations. Direction vectors over the loops common to both accesses
+ * are refined hierarchically, one loop at a time, and a branch is dropped as
+ * soon as the GCD or Banerjee test shows some equation has no solution in
+ * the loop bounds. Distances come from subscripts that mention a single
+ * common loop with the same coefficient on both sides (e.g. A[i] and
+ * A[i - 1]). Non-affine subscripts constrain nothing, so the result is
+ * conservative: a reported dependence may not exist, a missing one cannot.
+ */
+DependenceInfo DependenceAnalysis::run(const IRContext &ctx,
+                                       const IRNode *root) {
+  DependenceInfo info;
+  info.accesses_ = AccessAnalysis::run(ctx, root);
+  const std::vector<MemoryAccess> &accesses = info.accesses_.accesses_;
+
+  std::set<std::pair<const IRNode *, const IRNode *>> reductions;
+  ReductionCollector(ctx, reductions).visit(root);
+  ScalarLoopCollector(info.scalar_loops_).visit(root);
+
+  for (size_t source = 0; source < accesses.size(); ++source) {
+    for (size_t sink = 0; sink < accesses.size(); ++sink) {
+      const MemoryAccess &a = accesses[source];
+      const MemoryAccess &b = accesses[sink];
+      if ((!a.is_write_ && !b.is_write_) ||
+          a.tensor_->name != b.tensor_->name ||
+          a.indices_->size() != b.indices_->size()) {
+        continue;
+      }
+      PairTester tester(info.accesses_, source, sink);
+      for (std::vector<DepDirection> &direction : tester.directions()) {
+        Dependence dep;
+        dep.kind_ = !a.is_write_  ? DependenceKind::Anti
+                    : b.is_write_ ? DependenceKind::Output
+                                  : DependenceKind::Flow;
+        dep.source_ = source;
+        dep.sink_ = sink;
+        dep.loops_ = tester.commonLoops();
+        for (size_t p = 0; p < direction.size(); ++p) {
+          dep.distance_.push_back(tester.distance(p, direction[p]));
+        }
+        dep.direction_ = std::move(direction);
+        dep.reduction_ = reductions.count({a.node_, b.node_}) ||
+                         reductions.count({b.node_, a.node_});
+        info.dependences_.push_back(std::move(dep));
+      }
+    }
+  }
+  return info;
+}
@@ -0,0 +1,346 @@
+#include "FlatIR.hpp"
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
+
+NodeId FlatIR::addNode(IRNodeType kind, uint32_t op0, uint32_t op1,
+                       uint32_t op2, uint32_t op3,
+                       const std::vector<NodeId> &children) {
+  NodeId id = static_cast<NodeId>(kind_.size());
+  kind_.push_back(static_cast<uint8_t>(kind));
+  op0_.push_back(op0);
+  op1_.push_back(op1);
+  op2_.push_back(op2);
+  op3_.push_back(op3);
+  range_begin_.push_back(static_cast<uint32_t>(children_.size()));
+  range_size_.push_back(static_cast<uint32_t>(children.size()));
+  children_.insert(children_.end(), children.begin(), children.end());
+  return id;
+}
+
+FlatIRView FlatIR::view() const {
+  FlatIRView v;
+  v.root_ = root_;
+  v.size_ = size();
+  v.num_children_ = children_.size();
+  v.kind_ = kind_.data();
+  v.op0_ = op0_.data();
+  v.op1_ = op1_.data();
+  v.op2_ = op2_.data();
+  v.op3_ = op3_.data();
+  v.range_begin_ = range_begin_.data();
+  v.range_size_ = range_size_.data();
+  v.children_ = children_.data();
+  v.symbol_names_.assign(symbol_names_.begin(), symbol_names_.end());
+  v.tensors_ = tensors_;
+  return v;
+}
+
+// --- Encoding ---
+
+namespace {
+
+class Flattener {
+public:
+  Flattener(const IRContext &ctx, FlatIR &out) : ctx_(ctx), out_(out) {}
+
+  NodeId encode(const IRNode *node) {
+    if (!node) {
+      return kNullNode;
+    }
+    // Shared subtrees (e.g. hash-consed expressions) are encoded once.
+    auto it = ids_.find(node);
+    if (it != ids_.end()) {
+      return it->second;
+    }
+    NodeId id = encodeNode(node);
+    ids_.emplace(node, id);
+    return id;
+  }
+
+private:
+  uint32_t symbol(Symbol sym) {
+    auto [it, inserted] = symbols_.try_emplace(
+        sym, static_cast<uint32_t>(out_.symbol_names_.size()));
+    if (inserted) {
+      out_.symbol_names_.push_back(ctx_.name(sym));
+    }
+    return it->second;
+  }
+
+  uint32_t tensor(Tensor &t) {
+    auto [it, inserted] = tensors_.try_emplace(
+        &t, static_cast<uint32_t>(out_.tensors_.size()));
+    if (inserted) {
+      out_.tensors_.push_back(&t);
+    }
+    return it->second;
+  }
+
+  std::vector<NodeId> encodeAll(const std::vector<IRNode *> &nodes) {
+    std::vector<NodeId> ids;
+    ids.reserve(nodes.size());
+    for (const IRNode *n : nodes) {
+      ids.push_back(encode(n));
+    }
+    return ids;
+  }
+
+  NodeId encodeNode(const IRNode *node) {
+    const IRNodeType kind = node->getType();
+    switch (kind) {
+    case IRNodeType::Const: {
+      const Const *c = static_cast<const Const *>(node);
+      uint64_t bits = std::visit(
+          [](auto arg) -> uint64_t {
+            uint64_t out = 0;
+            std::memcpy(&out, &arg, sizeof(arg));
+            return out;
+          },
+          c->value_);
+      return out_.addNode(kind, static_cast<uint32_t>(bits),
+                          static_cast<uint32_t>(bits >> 32),
+                          static_cast<uint32_t>(c->value_.index()),
+                          static_cast<uint32_t>(c->dtype_));
+    }
+    case IRNodeType::Variable:
+      return out_.addNode(
+          kind, symbol(static_cast<const Variable *>(node)->symbol_));
+    case IRNodeType::Add:
+    case IRNodeType::Mul:
+    case IRNodeType::Min:
+    case IRNodeType::Div: {
+      // Add, Mul, Min and Div share the two-operand layout
+      const Add *b = static_cast<const Add *>(node);
+      NodeId one = encode(b->operand_one_);
+      NodeId two = encode(b->operand_two_);
+      return out_.addNode(kind, one, two);
+    }
+    case IRNodeType::Load: {
+      const Load *l = static_cast<const Load *>(node);
+      std::vector<NodeId> indices = encodeAll(l->indices_);
+      return out_.addNode(kind, tensor(l->tensor_), 0, 0, 0, indices);
+    }
+    case IRNodeType::Store: {
+      const Store *s = static_cast<const Store *>(node);
+      std::vector<NodeId> indices = encodeAll(s->indices_);
+      return out_.addNode(kind, tensor(s->tensor_), 0, 0, 0, indices);
+    }
+    case IRNodeType::Assign: {
+      const Assign *a = static_cast<const Assign *>(node);
+      NodeId target = encode(a->target_);
+      NodeId value = encode(a->value_);
+      return out_.addNode(kind, target, value);
+    }
+    case IRNodeType::Loop: {
+      const Loop *l = static_cast<const Loop *>(node);
+      NodeId lb = encode(l->lower_bound_);
+      NodeId ub = encode(l->upper_bound_);
+      NodeId step = encode(l->step_);
+      std::vector<NodeId> body = encodeAll(l->body_);
+      return out_.addNode(kind, symbol(l->index_), lb, ub, step, body);
+    }
+    case IRNodeType::Block: {
+      std::vector<NodeId> body =
+          encodeAll(static_cast<const Block *>(node)->body_);
+      return out_.addNode(kind, 0, 0, 0, 0, body);
+    }
+    case IRNodeType::RecursiveNest: {
+      const RecursiveNest *r = static_cast<const RecursiveNest *>(node);
+      NodeId band = encode(r->band_);
+      // Base sizes become Int64 constants, so the range holds only nodes.
+      std::vector<NodeId> sizes;
+      for (int64_t size : r->base_sizes_) {
+        uint64_t bits = static_cast<uint64_t>(size);
+        sizes.push_back(out_.addNode(
+            IRNodeType::Const, static_cast<uint32_t>(bits),
+            static_cast<uint32_t>(bits >> 32), 1,
+            static_cast<uint32_t>(DType::Int64)));
+      }
+      return out_.addNode(kind, band, 0, 0, 0, sizes);
+    }
+    case IRNodeType::CurveNest: {
+      const CurveNest *c = static_cast<const CurveNest *>(node);
+      NodeId band = encode(c->band_);
+      return out_.addNode(kind, band, static_cast<uint32_t>(c->curve_));
+    }
+    default:
+      throw std::runtime_error("flatten: unknown IRNodeType");
+    }
+  }
+
+  const IRContext &ctx_;
+  FlatIR &out_;
+  std::unordered_map<const IRNode *, NodeId> ids_;
+  std::unordered_map<Symbol, uint32_t> symbols_;
+  std::unordered_map<Tensor *, uint32_t> tensors_;
+};
+
+ConstValue decodeConst(uint32_t lo, uint32_t hi, uint32_t variant_index) {
+  uint64_t bits = (static_cast<uint64_t>(hi) << 32) | lo;
+  auto from_bits = [bits](auto zero) {
+    decltype(zero) value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return ConstValue(value);
+  };
+  switch (variant_index) {
+  case 0:
+    return from_bits(int{});
+  case 1:
+    return from_bits((long long){});
+  case 2:
+    return from_bits(float{});
+  case 3:
+    return from_bits(double{});
+  default:
+    throw std::runtime_error("unflatten: bad constant encoding");
+  }
+}
+
+} // namespace
+
+FlatIR flatten(const IRContext &ctx, const IRNode *root) {
+  FlatIR flat;
+  Flattener flattener(ctx, flat);
+  flat.setRoot(flattener.encode(root));
+  return flat;
+}
+
+// --- Decoding ---
+
+IRNode *unflatten(IRContext &ctx, const FlatIR &flat) {
+  return unflatten(ctx, flat.view());
+}
+
+IRNode *unflatten(IRContext &ctx, const FlatIRView &flat) {
+  if (flat.root_ == kNullNode) {
+    return nullptr;
+  }
+  if (flat.root_ >= flat.size_) {
+    throw std::runtime_error("unflatten: root out of range");
+  }
+
+  std::vector<Symbol> symbols;
+  symbols.reserve(flat.symbol_names_.size());
+  for (std::string_view name : flat.symbol_names_) {
+    symbols.push_back(ctx.symbols().intern(std::string(name)));
+  }
+
+  // Post-order storage means every operand is decoded before its user, so a
+  // single forward sweep rebuilds the whole tree. Any reference that does not
+  // point backwards is corrupt.
+  std::vector<IRNode *> nodes(flat.size_, nullptr);
+  NodeId current = 0;
+  auto node = [&nodes, &current](NodeId id) -> IRNode * {
+    if (id == kNullNode) {
+      return nullptr;
+    }
+    if (id >= current) {
+      throw std::runtime_error("unflatten: bad node reference");
+    }
+    return nodes[id];
+  };
+  auto range = [&](NodeId id) {
+    if (static_cast<size_t>(flat.range_begin_[id]) + flat.range_size_[id] >
+        flat.num_children_) {
+      throw std::runtime_error("unflatten: child range out of bounds");
+    }
+    std::vector<IRNode *> out;
+    for (const NodeId *c = flat.childrenBegin(id); c != flat.childrenEnd(id);
+         ++c) {
+      out.push_back(node(*c));
+    }
+    return out;
+  };
+  auto symbol = [&symbols](uint32_t index) {
+    if (index >= symbols.size()) {
+      throw std::runtime_error("unflatten: bad symbol id");
+    }
+    return symbols[index];
+  };
+  auto tensor = [&flat](uint32_t index) -> Tensor & {
+    if (index >= flat.tensors_.size() || !flat.tensors_[index]) {
+      throw std::runtime_error("unflatten: bad tensor id");
+    }
+    return *flat.tensors_[index];
+  };
+
+  auto dtype = [](uint32_t value) {
+    if (value > static_cast<uint32_t>(kLastDType)) {
+      throw std::runtime_error("unflatten: bad dtype");
+    }
+    return static_cast<DType>(value);
+  };
+
+  for (NodeId id = 0; id < flat.size_; ++id) {
+    current = id;
+    const uint32_t op0 = flat.op0_[id];
+    const uint32_t op1 = flat.op1_[id];
+    const uint32_t op2 = flat.op2_[id];
+    const uint32_t op3 = flat.op3_[id];
+
+    switch (flat.kind(id)) {
+    case IRNodeType::Const:
+      nodes[id] = ctx.makeConst(decodeConst(op0, op1, op2), dtype(op3));
+      break;
+    case IRNodeType::Variable:
+      nodes[id] = ctx.makeVariable(symbol(op0));
+      break;
+    case IRNodeType::Add:
+      nodes[id] = ctx.makeAdd(node(op0), node(op1));
+      break;
+    case IRNodeType::Mul:
+      nodes[id] = ctx.makeMul(node(op0), node(op1));
+      break;
+    case IRNodeType::Min:
+      nodes[id] = ctx.makeMin(node(op0), node(op1));
+      break;
+    case IRNodeType::Div:
+      nodes[id] = ctx.makeDiv(node(op0), node(op1));
+      break;
+    case IRNodeType::Load:
+      nodes[id] = ctx.create<Load>(tensor(op0), range(id));
+      break;
+    case IRNodeType::Store:
+      nodes[id] = ctx.create<Store>(tensor(op0), range(id));
+      break;
+    case IRNodeType::Assign:
+      nodes[id] = ctx.create<Assign>(node(op0), node(op1));
+      break;
+    case IRNodeType::Loop: {
+      Loop *loop =
+          ctx.create<Loop>(symbol(op0), node(op1), node(op2), node(op3));
+      loop->body_ = range(id);
+      nodes[id] = loop;
+      break;
+    }
+    case IRNodeType::Block:
+      nodes[id] = ctx.create<Block>(range(id));
+      break;
+    case IRNodeType::RecursiveNest: {
+      std::vector<int64_t> sizes;
+      for (const IRNode *size : range(id)) {
+        if (!size || size->getType() != IRNodeType::Const) {
+          throw std::runtime_error("unflatten: bad recursive base size");
+        }
+        sizes.push_back(std::visit(
+            [](auto v) { return static_cast<int64_t>(v); },
+            static_cast<const Const *>(size)->value_));
+      }
+      nodes[id] = ctx.create<RecursiveNest>(node(op0), std::move(sizes));
+      break;
+    }
+    case IRNodeType::CurveNest:
+      if (op1 > static_cast<uint32_t>(CurveOrder::Hilbert)) {
+        throw std::runtime_error("unflatten: bad curve order");
+      }
+      nodes[id] =
+          ctx.create<CurveNest>(node(op0), static_cast<CurveOrder>(op1));
+      break;
+    default:
+      throw std::runtime_error("unflatten: unknown IRNodeType");
+    }
+  }
+
+  return nodes[flat.root_];
+}
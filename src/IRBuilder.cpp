@@ -1,4 +1,5 @@
 #include "IRBuilder.hpp"
+#include "IRVisitor.hpp"
 #include <algorithm>
 #include <iomanip>
 #include <iostream>
@@ -40,8 +41,8 @@ std::string clean_expr(std::string s) {
 }
 
 // Helper to parse index list and tensor access (shared logic for Load/Store)
-std::tuple<Tensor *, std::vector<std::unique_ptr<IRNode>>>
-parseTensorAccess(const std::string &access_str) {
+std::tuple<Tensor *, std::vector<IRNode *>>
+parseTensorAccess(IRContext &ctx, const std::string &access_str) {
   size_t open_bracket = access_str.find('[');
   size_t close_bracket = access_str.find(']');
 
@@ -56,36 +57,36 @@ parseTensorAccess(const std::string &access_str) {
   Tensor *t = TensorMap.at(tensor_name);
 
   std::vector<std::string> index_vars = split(indices_str, ',');
-  std::vector<std::unique_ptr<IRNode>> indices;
+  std::vector<IRNode *> indices;
 
   for (const auto &var : index_vars) {
     // Indices are assumed to be simple Variables (like "i", "j")
-    indices.push_back(std::make_unique<Variable>(var));
+    indices.push_back(ctx.makeVariable(var));
   }
 
   return {t, std::move(indices)};
 }
 
 // 1. Builds a Load node
-std::unique_ptr<IRNode> parseLoad(const std::string &access_str) {
-  auto [t, indices] = parseTensorAccess(access_str);
-  return std::make_unique<Load>(*t, std::move(indices));
+IRNode *parseLoad(IRContext &ctx, const std::string &access_str) {
+  auto [t, indices] = parseTensorAccess(ctx, access_str);
+  return ctx.create<Load>(*t, std::move(indices));
 }
 
 // 2. Builds a Store node
-std::unique_ptr<IRNode> parseStore(const std::string &access_str) {
-  auto [t, indices] = parseTensorAccess(access_str);
-  return std::make_unique<Store>(*t, std::move(indices));
+IRNode *parseStore(IRContext &ctx, const std::string &access_str) {
+  auto [t, indices] = parseTensorAccess(ctx, access_str);
+  return ctx.create<Store>(*t, std::move(indices));
 }
 
 // 3. Builds the Right-Hand Side expression tree recursively
-std::unique_ptr<IRNode> parseExpression(const std::string &expr_str) {
+IRNode *parseExpression(IRContext &ctx, const std::string &expr_str) {
   std::string cleaned = clean_expr(expr_str);
 
   // Base Case: Single Operand (Load)
   if (cleaned.find('+') == std::string::npos &&
       cleaned.find('*') == std::string::npos) {
-    return parseLoad(cleaned);
+    return parseLoad(ctx, cleaned);
   }
 
   // Recursive Case: Find Main Operator (Precedence: + then *)
@@ -95,7 +96,8 @@ std::unique_ptr<IRNode> parseExpression(const std::string &expr_str) {
   if (op_pos != std::string::npos) {
     std::string left = cleaned.substr(0, op_pos);
     std::string right = cleaned.substr(op_pos + 1);
-    return std::make_unique<Add>(parseExpression(left), parseExpression(right));
+    return ctx.makeAdd(parseExpression(ctx, left),
+                       parseExpression(ctx, right));
   }
 
   // Look for '*' (next precedence)
@@ -103,14 +105,15 @@ std::unique_ptr<IRNode> parseExpression(const std::string &expr_str) {
   if (op_pos != std::string::npos) {
     std::string left = cleaned.substr(0, op_pos);
     std::string right = cleaned.substr(op_pos + 1);
-    return std::make_unique<Mul>(parseExpression(left), parseExpression(right));
+    return ctx.makeMul(parseExpression(ctx, left),
+                       parseExpression(ctx, right));
   }
 
-  return parseExpression(cleaned);
+  return parseExpression(ctx, cleaned);
 }
 
 // 4. Main Builder Implementation
-std::unique_ptr<IRNode> buildUntiledIR(const std::string &input_program) {
+IRNode *buildUntiledIR(IRContext &ctx, const std::string &input_program) {
 
   // --- Step 1: Parse Loops and Body Strings ---
   size_t loops_start = input_program.find("LOOPS:");
@@ -126,43 +129,43 @@ std::unique_ptr<IRNode> buildUntiledIR(const std::string &input_program) {
   std::string value_str = clean_expr(body_str.substr(assign_pos + 1));
 
   // Use parseStore for the LHS target
-  auto store_target_node = parseStore(target_str);
+  IRNode *store_target_node = parseStore(ctx, target_str);
 
   // Value (RHS): The complex expression tree
-  auto value_expr_root = parseExpression(value_str);
+  IRNode *value_expr_root = parseExpression(ctx, value_str);
 
   // Create the core Assign statement
-  auto assign_stmt = std::make_unique<Assign>(std::move(store_target_node),
-                                              std::move(value_expr_root));
+  IRNode *assign_stmt = ctx.create<Assign>(store_target_node, value_expr_root);
 
   // --- Step 3: Parse and Nest Loops ---
-  std::vector<std::string> loop_tokens = split(loops_str, ',');
+  // Whitespace is stripped so that loop names intern to the same symbols as
+  // the (already cleaned) index names in the body.
+  std::vector<std::string> loop_tokens = split(clean_expr(loops_str), ',');
 
-  std::unique_ptr<IRNode> current_body = std::move(assign_stmt);
+  IRNode *current_body = assign_stmt;
 
   for (int i = loop_tokens.size() - 1; i >= 0; --i) {
     std::vector<std::string> parts = split(loop_tokens[i], '=');
-    std::string var = parts[0];
+    Symbol var = ctx.symbols().intern(parts[0]);
 
     std::vector<std::string> bounds = split(parts[1], ':');
 
     // Lambda to parse bounds: number -> Const, anything else -> Variable
-    auto parse_bound = [](const std::string &s) -> std::unique_ptr<IRNode> {
+    auto parse_bound = [&ctx](const std::string &s) -> IRNode * {
       if (std::all_of(s.begin(), s.end(), ::isdigit)) {
-        return std::make_unique<Const>(std::stoi(s), DType::Int32);
+        return ctx.makeConst(std::stoi(s), DType::Int32);
       }
-      return std::make_unique<Variable>(s);
+      return ctx.makeVariable(s);
     };
 
-    auto new_loop =
-        std::make_unique<Loop>(var,                    // index variable
-                               parse_bound(bounds[0]), // lower bound (LB)
-                               parse_bound(bounds[1]), // upper bound (UB)
-                               parse_bound(bounds[2])  // step (STEP)
-        );
+    Loop *new_loop = ctx.create<Loop>(var,                    // index variable
+                                      parse_bound(bounds[0]), // lower bound
+                                      parse_bound(bounds[1]), // upper bound
+                                      parse_bound(bounds[2])  // step (STEP)
+    );
 
-    new_loop->body_.push_back(std::move(current_body));
-    current_body = std::move(new_loop);
+    new_loop->body_.push_back(current_body);
+    current_body = new_loop;
   }
 
   return current_body;
@@ -175,117 +178,121 @@ std::unique_ptr<IRNode> buildUntiledIR(const std::string &input_program) {
 // Utility for Indentation
 std::string indent_level(int depth) { return std::string(depth * 4, ' '); }
 
-// Recursive Traversal Function to print expressions for bounds/steps
+namespace {
+
+// Prints expressions for bounds/steps/indices
 // Returns the string representation of the expression
-std::string printExpressionIR(const IRNode *node) {
-  if (!node)
-    return "NULL";
+class ExpressionPrinter : public IRVisitor<ExpressionPrinter, std::string> {
+public:
+  explicit ExpressionPrinter(const IRContext &ctx) : ctx_(ctx) {}
 
-  switch (node->getType()) {
-  case IRNodeType::Const: {
-    const Const *constant = static_cast<const Const *>(node);
+  std::string visitConst(const Const *constant) {
     return std::visit(
         [](auto &&arg) -> std::string { return std::to_string(arg); },
         constant->getValue());
   }
-  case IRNodeType::Variable: {
-    return static_cast<const Variable *>(node)->getName();
+
+  std::string visitVariable(const Variable *var) {
+    return ctx_.name(var->getSymbol());
   }
-  case IRNodeType::Add: {
-    const Add *a = static_cast<const Add *>(node);
-    return "(" + printExpressionIR(a->operand_one_.get()) + " + " +
-           printExpressionIR(a->operand_two_.get()) + ")";
+
+  std::string visitAdd(const Add *a) {
+    return "(" + visit(a->operand_one_) + " + " + visit(a->operand_two_) + ")";
   }
-  case IRNodeType::Mul: {
-    const Mul *m = static_cast<const Mul *>(node);
-    return "(" + printExpressionIR(m->operand_one_.get()) + " * " +
-           printExpressionIR(m->operand_two_.get()) + ")";
+
+  std::string visitMul(const Mul *m) {
+    return "(" + visit(m->operand_one_) + " * " + visit(m->operand_two_) + ")";
   }
-  case IRNodeType::Min: {
-    const Min *m = static_cast<const Min *>(node);
-    return "MIN(" + printExpressionIR(m->operand_one_.get()) + ", " +
-           printExpressionIR(m->operand_two_.get()) + ")";
+
+  std::string visitMin(const Min *m) {
+    return "MIN(" + visit(m->operand_one_) + ", " + visit(m->operand_two_) +
+           ")";
   }
-  default:
-    return "[COMPLEX_EXPR]";
+
+  std::string visitDiv(const Div *d) {
+    return "(" + visit(d->operand_one_) + " / " + visit(d->operand_two_) + ")";
   }
-}
 
-void printIR(const IRNode *node, int depth) {
-  if (!node)
-    return;
+  std::string visitNode(const IRNode *) { return "[COMPLEX_EXPR]"; }
+  std::string visitNull() { return "NULL"; }
 
-  std::cout << indent_level(depth);
+private:
+  const IRContext &ctx_;
+};
 
-  switch (node->getType()) {
-  case IRNodeType::Loop: {
-    const Loop *loop = static_cast<const Loop *>(node);
+// Prints one node per line, indented by depth
+class IRPrinter : public IRVisitor<IRPrinter> {
+public:
+  IRPrinter(const IRContext &ctx, int depth) : ctx_(ctx), depth_(depth) {}
 
-    std::string lb_expr = printExpressionIR(loop->lower_bound_.get());
-    std::string ub_expr = printExpressionIR(loop->upper_bound_.get());
-    std::string step_expr = printExpressionIR(loop->step_.get());
+  void visitLoop(const Loop *loop) {
+    ExpressionPrinter expr(ctx_);
+    std::string lb_expr = expr.visit(loop->lower_bound_);
+    std::string ub_expr = expr.visit(loop->upper_bound_);
+    std::string step_expr = expr.visit(loop->step_);
 
-    std::cout << "LOOP: for " << loop->index_ << " = ";
+    line() << "LOOP: for " << ctx_.name(loop->index_) << " = ";
     std::cout << lb_expr << " to " << ub_expr << " step " << step_expr
               << std::endl;
 
-    for (const auto &child : loop->body_) {
-      printIR(child.get(), depth + 1);
+    for (const IRNode *child : loop->body_) {
+      visitChild(child);
     }
-    break;
   }
 
-  case IRNodeType::Assign: {
-    std::cout << "ASSIGN" << std::endl;
-    printIR(static_cast<const Assign *>(node)->target_.get(), depth + 1);
-    printIR(static_cast<const Assign *>(node)->value_.get(), depth + 1);
-    break;
+  void visitBlock(const Block *block) {
+    line() << "BLOCK" << std::endl;
+    for (const IRNode *child : block->body_) {
+      visitChild(child);
+    }
   }
 
-  case IRNodeType::Load: {
-    const Load *load = static_cast<const Load *>(node);
-    std::cout << "LOAD: " << load->tensor_.name << "[";
-    for (size_t i = 0; i < load->indices_.size(); ++i) {
-      const Variable *var =
-          dynamic_cast<const Variable *>(load->indices_[i].get());
-      std::cout << (var ? var->getName() : "?");
-      if (i < load->indices_.size() - 1)
-        std::cout << ", ";
+  void visitRecursiveNest(const RecursiveNest *nest) {
+    line() << "RECURSIVE: base";
+    for (size_t d = 0; d < nest->base_sizes_.size(); ++d) {
+      std::cout << (d ? " x " : " ") << nest->base_sizes_[d];
     }
-    std::cout << "]" << std::endl;
-    break;
+    std::cout << std::endl;
+    visitChild(nest->band_);
   }
 
-  case IRNodeType::Store: {
-    const Store *store = static_cast<const Store *>(node);
-    std::cout << "STORE (Target): " << store->tensor_.name << "[";
-    for (size_t i = 0; i < store->indices_.size(); ++i) {
-      const Variable *var =
-          dynamic_cast<const Variable *>(store->indices_[i].get());
-      std::cout << (var ? var->getName() : "?");
-      if (i < store->indices_.size() - 1)
-        std::cout << ", ";
-    }
-    std::cout << "]" << std::endl;
-    break;
+  void visitCurveNest(const CurveNest *nest) {
+    line() << "CURVE: "
+           << (nest->curve_ == CurveOrder::Morton    ? "MORTON"
+               : nest->curve_ == CurveOrder::Hilbert ? "HILBERT"
+                                                     : "ROW-MAJOR")
+           << std::endl;
+    visitChild(nest->band_);
+  }
+
+  void visitAssign(const Assign *assign) {
+    line() << "ASSIGN" << std::endl;
+    visitChild(assign->target_);
+    visitChild(assign->value_);
+  }
+
+  void visitLoad(const Load *load) {
+    line() << "LOAD: " << load->tensor_.name << indices(load->indices_)
+           << std::endl;
   }
 
-  case IRNodeType::Add:
-  case IRNodeType::Mul:
-  case IRNodeType::Min: {
-    // Note: Add, Mul, Min share the two-operand structure
-    const Add *binary = static_cast<const Add *>(node);
+  void visitStore(const Store *store) {
+    line() << "STORE (Target): " << store->tensor_.name
+           << indices(store->indices_) << std::endl;
+  }
+
+  void visitBinary(const IRNode *node, const IRNode *one, const IRNode *two) {
+    // Note: Add, Mul, Min, Div share the two-operand structure
     std::string op = (node->getType() == IRNodeType::Add)   ? "ADD"
                      : (node->getType() == IRNodeType::Mul) ? "MUL"
+                     : (node->getType() == IRNodeType::Div) ? "DIV"
                                                             : "MIN";
-    std::cout << op << std::endl;
-    printIR(binary->operand_one_.get(), depth + 1);
-    printIR(binary->operand_two_.get(), depth + 1);
-    break;
+    line() << op << std::endl;
+    visitChild(one);
+    visitChild(two);
   }
 
-  case IRNodeType::Const: {
-    const Const *constant = static_cast<const Const *>(node);
+  void visitConst(const Const *constant) {
     std::string val_str = std::visit(
         [](auto &&arg) -> std::string {
           using T = std::decay_t<decltype(arg)>;
@@ -300,17 +307,45 @@ void printIR(const IRNode *node, int depth) {
           }
         },
         constant->getValue());
-    std::cout << "CONST: " << val_str << std::endl;
-    break;
+    line() << "CONST: " << val_str << std::endl;
   }
 
-  case IRNodeType::Variable: {
-    const Variable *var = static_cast<const Variable *>(node);
-    std::cout << "VAR: " << var->getName() << std::endl;
-    break;
+  void visitVariable(const Variable *var) {
+    line() << "VAR: " << ctx_.name(var->getSymbol()) << std::endl;
   }
 
-  default:
-    std::cout << "UNKNOWN_NODE" << std::endl;
+  void visitNode(const IRNode *) { line() << "UNKNOWN_NODE" << std::endl; }
+
+private:
+  std::ostream &line() { return std::cout << indent_level(depth_); }
+
+  void visitChild(const IRNode *child) {
+    ++depth_;
+    visit(child);
+    --depth_;
+  }
+
+  std::string indices(const std::vector<IRNode *> &idx) {
+    ExpressionPrinter expr(ctx_);
+    std::string s = "[";
+    for (size_t i = 0; i < idx.size(); ++i) {
+      s += expr.visit(idx[i]);
+      if (i < idx.size() - 1)
+        s += ", ";
+    }
+    return s + "]";
   }
-}
\ No newline at end of file
+
+  const IRContext &ctx_;
+  int depth_;
+};
+
+} // namespace
+
+std::string printExpressionIR(const IRContext &ctx, const IRNode *node) {
+  return ExpressionPrinter(ctx).visit(node);
+}
+
+void printIR(const IRContext &ctx, const IRNode *node, int depth) {
+  IRPrinter(ctx, depth).visit(node);
+}
@@ -0,0 +1,195 @@
+#include "IRContext.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <iterator>
+
+void Arena::newSlab(size_t min_size) {
+  size_t size = std::max(slab_size_, min_size);
+  char *slab = static_cast<char *>(std::malloc(size));
+  if (!slab) {
+    throw std::bad_alloc();
+  }
+  slabs_.push_back(slab);
+  cur_ = slab;
+  end_ = slab + size;
+}
+
+void Arena::rollback(const Mark &m) {
+  while (slabs_.size() > m.slabs) {
+    std::free(slabs_.back());
+    slabs_.pop_back();
+  }
+  cur_ = m.cur;
+  end_ = m.end;
+  bytes_used_ = m.bytes_used;
+}
+
+void Arena::reset() {
+  for (char *slab : slabs_) {
+    std::free(slab);
+  }
+  slabs_.clear();
+  cur_ = nullptr;
+  end_ = nullptr;
+  bytes_used_ = 0;
+}
+
+Const *IRContext::makeConst(ConstValue value, DType dtype) {
+  if (!hash_consing_) {
+    return create<Const>(value, dtype);
+  }
+  auto [it, inserted] = consts_.try_emplace({value, dtype}, nullptr);
+  if (inserted) {
+    it->second = create<Const>(value, dtype);
+  }
+  return it->second;
+}
+
+Variable *IRContext::makeVariable(Symbol sym) {
+  if (!hash_consing_) {
+    return create<Variable>(sym);
+  }
+  if (sym >= variables_.size()) {
+    variables_.resize(sym + 1, nullptr);
+  }
+  if (!variables_[sym]) {
+    variables_[sym] = create<Variable>(sym);
+  }
+  return variables_[sym];
+}
+
+template <typename T>
+T *IRContext::makeBinary(IRNodeType kind, IRNode *one, IRNode *two) {
+  if (!hash_consing_) {
+    return create<T>(one, two);
+  }
+  auto [it, inserted] =
+      binaries_.try_emplace(BinaryKey(kind, one, two), nullptr);
+  if (inserted) {
+    it->second = create<T>(one, two);
+  }
+  return static_cast<T *>(it->second);
+}
+
+Add *IRContext::makeAdd(IRNode *one, IRNode *two) {
+  return makeBinary<Add>(IRNodeType::Add, one, two);
+}
+
+Mul *IRContext::makeMul(IRNode *one, IRNode *two) {
+  return makeBinary<Mul>(IRNodeType::Mul, one, two);
+}
+
+Min *IRContext::makeMin(IRNode *one, IRNode *two) {
+  return makeBinary<Min>(IRNodeType::Min, one, two);
+}
+
+Div *IRContext::makeDiv(IRNode *one, IRNode *two) {
+  return makeBinary<Div>(IRNodeType::Div, one, two);
+}
+
+void IRContext::forget(const IRNode *node) {
+  switch (node->getType()) {
+  case IRNodeType::Const: {
+    const Const *c = static_cast<const Const *>(node);
+    auto it = consts_.find({c->value_, c->dtype_});
+    if (it != consts_.end() && it->second == node) {
+      consts_.erase(it);
+    }
+    break;
+  }
+  case IRNodeType::Variable: {
+    Symbol sym = static_cast<const Variable *>(node)->symbol_;
+    if (sym < variables_.size() && variables_[sym] == node) {
+      variables_[sym] = nullptr;
+    }
+    break;
+  }
+  case IRNodeType::Add:
+  case IRNodeType::Mul:
+  case IRNodeType::Min:
+  case IRNodeType::Div: {
+    const Add *b = static_cast<const Add *>(node);
+    auto it = binaries_.find(
+        BinaryKey(node->getType(), b->operand_one_, b->operand_two_));
+    if (it != binaries_.end() && it->second == node) {
+      binaries_.erase(it);
+    }
+    break;
+  }
+  default:
+    break;
+  }
+}
+
+Tensor *IRContext::makeBuffer(const std::string &name, DType dtype,
+                              const std::vector<size_t> &extents,
+                              TensorLayout layout) {
+  Tensor &buffer =
+      buffers_.emplace_back(name, dtype, extents.size(), extents,
+                              std::move(layout));
+  buffer.local_ = true;
+  return &buffer;
+}
+
+void IRContext::memoize(uint64_t key, const IRNode *subtree,
+                        std::vector<int64_t> value) const {
+  if (memo_.size() >= kMemoLimit) {
+    memo_.clear();
+    memo_keys_.clear();
+  }
+  memo_.emplace(key, MemoEntry{subtree, std::move(value)});
+  memo_keys_.emplace(subtree, key);
+}
+
+std::vector<const IRContext::MemoEntry *>
+IRContext::memoized(uint64_t key) const {
+  std::vector<const MemoEntry *> entries;
+  auto [begin, end] = memo_.equal_range(key);
+  for (auto it = begin; it != end; ++it) {
+    entries.push_back(&it->second);
+  }
+  return entries;
+}
+
+void IRContext::forgetMemo(const IRNode *node) {
+  auto [begin, end] = memo_keys_.equal_range(node);
+  for (auto key = begin; key != end; ++key) {
+    auto [first, last] = memo_.equal_range(key->second);
+    for (auto it = first; it != last;) {
+      it = it->second.subtree == node ? memo_.erase(it) : std::next(it);
+    }
+  }
+  memo_keys_.erase(begin, end);
+}
+
+void IRContext::rollback(const Checkpoint &cp) {
+  ++epoch_;
+  while (nodes_.size() > cp.nodes) {
+    IRNode *node = nodes_.back();
+    nodes_.pop_back();
+    if (hash_consing_) {
+      forget(node);
+    }
+    if (!memo_keys_.empty()) {
+      forgetMemo(node);
+    }
+    node->~IRNode();
+  }
+  arena_.rollback(cp.arena);
+}
+
+void IRContext::release() {
+  ++epoch_;
+  for (auto it = nodes_.rbegin(); it != nodes_.rend(); ++it) {
+    (*it)->~IRNode();
+  }
+  nodes_.clear();
+  consts_.clear();
+  variables_.clear();
+  binaries_.clear();
+  buffers_.clear();
+  memo_.clear();
+  memo_keys_.clear();
+  symbols_.clear();
+  arena_.reset();
+}
@@ -0,0 +1,481 @@
+#include "IRFile.hpp"
+#include "IRBuilder.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+// --- On-disk records (fixed-width, naturally aligned, no padding) ---
+
+struct FileHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t num_kernels;
+  uint32_t reserved;
+  uint64_t directory_offset;
+  uint64_t file_size;
+};
+
+struct DirEntry {
+  uint64_t key;
+  uint64_t offset; // Of the kernel blob, from the start of the file.
+  uint64_t size;
+};
+
+// Section offsets are relative to the start of the kernel blob.
+struct KernelHeader {
+  uint32_t num_nodes;
+  uint32_t root;
+  uint32_t num_children;
+  uint32_t num_symbols;
+  uint32_t num_tensors;
+  uint32_t num_values;
+  uint32_t strings_size;
+  uint32_t reserved;
+  uint64_t kind;
+  uint64_t op0;
+  uint64_t op1;
+  uint64_t op2;
+  uint64_t op3;
+  uint64_t range_begin;
+  uint64_t range_size;
+  uint64_t children;
+  uint64_t symbols;
+  uint64_t tensors;
+  uint64_t values;
+  uint64_t strings;
+};
+
+struct SymbolRecord {
+  uint32_t offset; // Into the string section.
+  uint32_t length;
+};
+
+// Extents and layout vectors are `dims` entries each in the values section.
+struct TensorRecord {
+  uint32_t name_offset;
+  uint32_t name_length;
+  uint32_t dtype;
+  uint32_t dims;
+  uint32_t flags;
+  uint32_t extents_index;
+  uint32_t strides_index;
+  uint32_t block_index; // Block extents, then block strides; if kBlocked.
+  uint64_t layout_size;
+  uint64_t alignment;
+};
+
+constexpr uint32_t kBlocked = 1;
+constexpr uint32_t kLocal = 2; // Tensor::local_, e.g. a packed tile buffer.
+constexpr uint32_t kTensorFlags = kBlocked | kLocal;
+
+bool hostIsLittleEndian() {
+  const uint16_t probe = 1;
+  uint8_t first;
+  std::memcpy(&first, &probe, 1);
+  return first == 1;
+}
+
+// --- Writing ---
+
+class BlobWriter {
+public:
+  // Appends `size` bytes at the next 8-byte boundary; returns their offset.
+  uint64_t append(const void *data, size_t size) {
+    buf_.resize((buf_.size() + 7) & ~size_t(7), 0);
+    uint64_t offset = buf_.size();
+    if (size) {
+      buf_.insert(buf_.end(), static_cast<const uint8_t *>(data),
+                  static_cast<const uint8_t *>(data) + size);
+    }
+    return offset;
+  }
+
+  template <typename T> uint64_t append(const std::vector<T> &v) {
+    return append(v.data(), v.size() * sizeof(T));
+  }
+
+  void patch(uint64_t offset, const void *data, size_t size) {
+    std::memcpy(buf_.data() + offset, data, size);
+  }
+
+  size_t size() const { return buf_.size(); }
+  const std::vector<uint8_t> &bytes() const { return buf_; }
+
+private:
+  std::vector<uint8_t> buf_;
+};
+
+std::vector<uint8_t> encodeKernel(const FlatIR &flat) {
+  std::string strings;
+  std::vector<SymbolRecord> symbols;
+  for (const std::string &name : flat.symbol_names_) {
+    symbols.push_back({static_cast<uint32_t>(strings.size()),
+                       static_cast<uint32_t>(name.size())});
+    strings += name;
+  }
+
+  std::vector<TensorRecord> tensors;
+  std::vector<uint64_t> values;
+  auto append_values = [&values](const std::vector<size_t> &v) {
+    uint32_t index = static_cast<uint32_t>(values.size());
+    values.insert(values.end(), v.begin(), v.end());
+    return index;
+  };
+  for (const Tensor *t : flat.tensors_) {
+    const TensorLayout &layout = t->layout_;
+    TensorRecord r{};
+    r.name_offset = static_cast<uint32_t>(strings.size());
+    r.name_length = static_cast<uint32_t>(t->name.size());
+    r.dtype = static_cast<uint32_t>(t->dtype_);
+    r.dims = static_cast<uint32_t>(t->dims_);
+    r.flags = t->local_ ? kLocal : 0;
+    r.extents_index = append_values(t->extents_);
+    r.strides_index = append_values(layout.strides_);
+    if (layout.isBlocked()) {
+      r.flags |= kBlocked;
+      r.block_index = append_values(layout.block_);
+      append_values(layout.block_strides_);
+    }
+    r.layout_size = layout.size_;
+    r.alignment = layout.alignment_;
+    tensors.push_back(r);
+    strings += t->name;
+  }
+
+  KernelHeader h{};
+  h.num_nodes = static_cast<uint32_t>(flat.size());
+  h.root = flat.root();
+  h.num_children = static_cast<uint32_t>(flat.children_.size());
+  h.num_symbols = static_cast<uint32_t>(symbols.size());
+  h.num_tensors = static_cast<uint32_t>(tensors.size());
+  h.num_values = static_cast<uint32_t>(values.size());
+  h.strings_size = static_cast<uint32_t>(strings.size());
+
+  BlobWriter w;
+  w.append(&h, sizeof(h));
+  h.kind = w.append(flat.kind_);
+  h.op0 = w.append(flat.op0_);
+  h.op1 = w.append(flat.op1_);
+  h.op2 = w.append(flat.op2_);
+  h.op3 = w.append(flat.op3_);
+  h.range_begin = w.append(flat.range_begin_);
+  h.range_size = w.append(flat.range_size_);
+  h.children = w.append(flat.children_);
+  h.symbols = w.append(symbols);
+  h.tensors = w.append(tensors);
+  h.values = w.append(values);
+  h.strings = w.append(strings.data(), strings.size());
+  w.patch(0, &h, sizeof(h));
+  return w.bytes();
+}
+
+// --- Reading ---
+
+// True if [offset, offset + count * elem) lies inside a blob of `size` bytes
+// and is aligned for the element type.
+bool inBounds(uint64_t offset, uint64_t count, size_t elem, size_t align,
+              uint64_t size) {
+  return offset % align == 0 && offset <= size &&
+         count <= (size - offset) / elem;
+}
+
+template <typename T> const T *at(const uint8_t *base, uint64_t offset) {
+  return reinterpret_cast<const T *>(base + offset);
+}
+
+} // namespace
+
+/**
+ * @brief Serializes each entry's FlatIR into one file with a sorted directory
+ * so kernels can be looked up by key without scanning.
+ *
+ * @param path Destination file (overwritten).
+ * @param entries Kernels to store; keys must be unique.
+ */
+void writeIRFile(const std::string &path,
+                 const std::vector<IRFileEntry> &entries) {
+  if (!hostIsLittleEndian()) {
+    throw std::runtime_error("writeIRFile: big-endian hosts are unsupported");
+  }
+
+  std::vector<IRFileEntry> sorted = entries;
+  std::sort(sorted.begin(), sorted.end(),
+            [](const IRFileEntry &a, const IRFileEntry &b) {
+              return a.key < b.key;
+            });
+  for (size_t i = 1; i < sorted.size(); ++i) {
+    if (sorted[i].key == sorted[i - 1].key) {
+      throw std::runtime_error("writeIRFile: duplicate kernel key");
+    }
+  }
+
+  FileHeader header{};
+  header.magic = kIRFileMagic;
+  header.version = kIRFileVersion;
+  header.num_kernels = static_cast<uint32_t>(sorted.size());
+
+  BlobWriter w;
+  w.append(&header, sizeof(header));
+  std::vector<DirEntry> directory(sorted.size());
+  header.directory_offset = w.append(directory);
+  for (size_t i = 0; i < sorted.size(); ++i) {
+    std::vector<uint8_t> blob = encodeKernel(*sorted[i].kernel);
+    directory[i] = {sorted[i].key, w.append(blob), blob.size()};
+  }
+  header.file_size = w.size();
+  w.patch(0, &header, sizeof(header));
+  w.patch(header.directory_offset, directory.data(),
+          directory.size() * sizeof(DirEntry));
+
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  out.write(reinterpret_cast<const char *>(w.bytes().data()),
+            static_cast<std::streamsize>(w.size()));
+  if (!out) {
+    throw std::runtime_error("writeIRFile: cannot write " + path);
+  }
+}
+
+Tensor *resolveFromTensorMap(const TensorDesc &desc) {
+  if (desc.local) {
+    return nullptr;
+  }
+  auto it = TensorMap.find(std::string(desc.name));
+  if (it == TensorMap.end()) {
+    return nullptr;
+  }
+  Tensor *t = it->second;
+  if (t->dtype_ != desc.dtype || t->dims_ != desc.dims) {
+    return nullptr;
+  }
+  for (uint32_t d = 0; d < desc.dims; ++d) {
+    if (t->extents_[d] != desc.extents[d]) {
+      return nullptr;
+    }
+  }
+  // The kernel's addressing was generated for the stored layout.
+  if (t->layout_ != desc.layout()) {
+    return nullptr;
+  }
+  return t;
+}
+
+TensorResolver resolveInto(IRContext &ctx) {
+  return [&ctx](const TensorDesc &desc) -> Tensor * {
+    if (!desc.local) {
+      return resolveFromTensorMap(desc);
+    }
+    return ctx.makeBuffer(std::string(desc.name), desc.dtype,
+                          std::vector<size_t>(desc.extents,
+                                              desc.extents + desc.dims),
+                          desc.layout());
+  };
+}
+
+TensorLayout TensorDesc::layout() const {
+  TensorLayout layout;
+  layout.strides_.assign(strides, strides + dims);
+  if (block) {
+    layout.block_.assign(block, block + dims);
+    layout.block_strides_.assign(block_strides, block_strides + dims);
+  }
+  layout.size_ = static_cast<size_t>(layout_size);
+  layout.alignment_ = static_cast<size_t>(alignment);
+  return layout;
+}
+
+MappedIRFile::MappedIRFile(const std::string &path) {
+  if (!hostIsLittleEndian()) {
+    throw std::runtime_error("MappedIRFile: big-endian hosts are unsupported");
+  }
+
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("MappedIRFile: cannot open " + path);
+  }
+  struct stat st;
+  if (::fstat(fd, &st) != 0 ||
+      st.st_size < static_cast<off_t>(sizeof(FileHeader))) {
+    ::close(fd);
+    throw std::runtime_error("MappedIRFile: " + path + " is too small");
+  }
+  size_ = static_cast<size_t>(st.st_size);
+  void *map = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (map == MAP_FAILED) {
+    throw std::runtime_error("MappedIRFile: cannot map " + path);
+  }
+  data_ = static_cast<const uint8_t *>(map);
+
+  // Validate everything a view will dereference, so kernel() can trust it.
+  auto fail = [this, &path](const char *what) {
+    ::munmap(const_cast<uint8_t *>(data_), size_);
+    throw std::runtime_error("MappedIRFile: " + path + ": " + what);
+  };
+  const FileHeader *h = at<FileHeader>(data_, 0);
+  if (h->magic != kIRFileMagic) {
+    fail("bad magic");
+  }
+  if (h->version != kIRFileVersion) {
+    fail("unsupported version");
+  }
+  if (h->file_size != size_ ||
+      !inBounds(h->directory_offset, h->num_kernels, sizeof(DirEntry), 8,
+                size_)) {
+    fail("truncated directory");
+  }
+  for (size_t i = 0; i < h->num_kernels; ++i) {
+    const DirEntry &e = at<DirEntry>(data_, h->directory_offset)[i];
+    if (!inBounds(e.offset, 1, sizeof(KernelHeader), 8, size_) ||
+        e.size > size_ - e.offset || e.size < sizeof(KernelHeader)) {
+      fail("kernel out of bounds");
+    }
+    const KernelHeader &k = *at<KernelHeader>(data_, e.offset);
+    bool ok =
+        inBounds(k.kind, k.num_nodes, sizeof(uint8_t), 1, e.size) &&
+        inBounds(k.op0, k.num_nodes, sizeof(uint32_t), 4, e.size) &&
+        inBounds(k.op1, k.num_nodes, sizeof(uint32_t), 4, e.size) &&
+        inBounds(k.op2, k.num_nodes, sizeof(uint32_t), 4, e.size) &&
+        inBounds(k.op3, k.num_nodes, sizeof(uint32_t), 4, e.size) &&
+        inBounds(k.range_begin, k.num_nodes, sizeof(uint32_t), 4, e.size) &&
+        inBounds(k.range_size, k.num_nodes, sizeof(uint32_t), 4, e.size) &&
+        inBounds(k.children, k.num_children, sizeof(NodeId), 4, e.size) &&
+        inBounds(k.symbols, k.num_symbols, sizeof(SymbolRecord), 4, e.size) &&
+        inBounds(k.tensors, k.num_tensors, sizeof(TensorRecord), 8, e.size) &&
+        inBounds(k.values, k.num_values, sizeof(uint64_t), 8, e.size) &&
+        inBounds(k.strings, k.strings_size, 1, 1, e.size);
+    if (!ok) {
+      fail("section out of bounds");
+    }
+    const SymbolRecord *symbols = at<SymbolRecord>(data_ + e.offset, k.symbols);
+    for (uint32_t s = 0; s < k.num_symbols; ++s) {
+      if (!inBounds(symbols[s].offset, symbols[s].length, 1, 1,
+                    k.strings_size)) {
+        fail("symbol name out of bounds");
+      }
+    }
+    const TensorRecord *tensors = at<TensorRecord>(data_ + e.offset, k.tensors);
+    for (uint32_t t = 0; t < k.num_tensors; ++t) {
+      const TensorRecord &r = tensors[t];
+      const bool blocked = r.flags & kBlocked;
+      if (!inBounds(r.name_offset, r.name_length, 1, 1, k.strings_size) ||
+          !inBounds(r.extents_index, r.dims, 1, 1, k.num_values) ||
+          !inBounds(r.strides_index, r.dims, 1, 1, k.num_values) ||
+          (blocked &&
+           !inBounds(r.block_index, uint64_t{2} * r.dims, 1, 1,
+                     k.num_values))) {
+        fail("tensor record out of bounds");
+      }
+      if (r.dtype > static_cast<uint32_t>(kLastDType) ||
+          (r.flags & ~kTensorFlags) != 0) {
+        fail("bad tensor record");
+      }
+    }
+  }
+}
+
+MappedIRFile::~MappedIRFile() {
+  if (data_) {
+    ::munmap(const_cast<uint8_t *>(data_), size_);
+  }
+}
+
+uint32_t MappedIRFile::version() const {
+  return at<FileHeader>(data_, 0)->version;
+}
+
+size_t MappedIRFile::numKernels() const {
+  return at<FileHeader>(data_, 0)->num_kernels;
+}
+
+uint64_t MappedIRFile::key(size_t index) const {
+  const FileHeader *h = at<FileHeader>(data_, 0);
+  return at<DirEntry>(data_, h->directory_offset)[index].key;
+}
+
+std::optional<size_t> MappedIRFile::find(uint64_t key) const {
+  const FileHeader *h = at<FileHeader>(data_, 0);
+  const DirEntry *begin = at<DirEntry>(data_, h->directory_offset);
+  const DirEntry *end = begin + h->num_kernels;
+  const DirEntry *it = std::lower_bound(
+      begin, end, key, [](const DirEntry &e, uint64_t k) { return e.key < k; });
+  if (it == end || it->key != key) {
+    return std::nullopt;
+  }
+  return static_cast<size_t>(it - begin);
+}
+
+const uint8_t *MappedIRFile::blob(size_t index) const {
+  if (index >= numKernels()) {
+    throw std::out_of_range("MappedIRFile: kernel index out of range");
+  }
+  const FileHeader *h = at<FileHeader>(data_, 0);
+  return data_ + at<DirEntry>(data_, h->directory_offset)[index].offset;
+}
+
+size_t MappedIRFile::numTensors(size_t index) const {
+  return at<KernelHeader>(blob(index), 0)->num_tensors;
+}
+
+TensorDesc MappedIRFile::tensor(size_t index, size_t tensor_id) const {
+  const uint8_t *b = blob(index);
+  const KernelHeader *k = at<KernelHeader>(b, 0);
+  if (tensor_id >= k->num_tensors) {
+    throw std::out_of_range("MappedIRFile: tensor id out of range");
+  }
+  const TensorRecord &r = at<TensorRecord>(b, k->tensors)[tensor_id];
+  const char *strings = at<char>(b, k->strings);
+  const uint64_t *values = at<uint64_t>(b, k->values);
+  const bool blocked = r.flags & kBlocked;
+  TensorDesc desc{};
+  desc.name = std::string_view(strings + r.name_offset, r.name_length);
+  desc.dtype = static_cast<DType>(r.dtype);
+  desc.dims = r.dims;
+  desc.extents = values + r.extents_index;
+  desc.strides = values + r.strides_index;
+  desc.block = blocked ? values + r.block_index : nullptr;
+  desc.block_strides = blocked ? values + r.block_index + r.dims : nullptr;
+  desc.layout_size = r.layout_size;
+  desc.alignment = r.alignment;
+  desc.local = r.flags & kLocal;
+  return desc;
+}
+
+FlatIRView MappedIRFile::kernel(size_t index,
+                                const TensorResolver &resolve) const {
+  const uint8_t *b = blob(index);
+  const KernelHeader *k = at<KernelHeader>(b, 0);
+
+  FlatIRView v;
+  v.root_ = k->root;
+  v.size_ = k->num_nodes;
+  v.num_children_ = k->num_children;
+  v.kind_ = at<uint8_t>(b, k->kind);
+  v.op0_ = at<uint32_t>(b, k->op0);
+  v.op1_ = at<uint32_t>(b, k->op1);
+  v.op2_ = at<uint32_t>(b, k->op2);
+  v.op3_ = at<uint32_t>(b, k->op3);
+  v.range_begin_ = at<uint32_t>(b, k->range_begin);
+  v.range_size_ = at<uint32_t>(b, k->range_size);
+  v.children_ = at<NodeId>(b, k->children);
+
+  const char *strings = at<char>(b, k->strings);
+  const SymbolRecord *symbols = at<SymbolRecord>(b, k->symbols);
+  v.symbol_names_.reserve(k->num_symbols);
+  for (uint32_t s = 0; s < k->num_symbols; ++s) {
+    v.symbol_names_.emplace_back(strings + symbols[s].offset,
+                                 symbols[s].length);
+  }
+
+  v.tensors_.reserve(k->num_tensors);
+  for (uint32_t t = 0; t < k->num_tensors; ++t) {
+    v.tensors_.push_back(resolve ? resolve(tensor(index, t)) : nullptr);
+  }
+  return v;
+}
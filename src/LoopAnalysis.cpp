@@ -0,0 +1,111 @@
+#include "LoopAnalysis.hpp"
+#include "IRVisitor.hpp"
+
+namespace {
+
+class BandCollector : public RecursiveIRVisitor<BandCollector> {
+public:
+  explicit BandCollector(LoopNestInfo &info) : info_(info) {}
+
+  void visitLoop(const Loop *loop) {
+    ++info_.num_loops_;
+
+    // A loop continues the band of its parent if it is the parent's only
+    // statement; otherwise it opens a new band.
+    size_t band = current_band_;
+    if (!continues_band_) {
+      band = info_.bands_.size();
+      info_.bands_.emplace_back();
+    }
+    info_.bands_[band].loops_.push_back(loop);
+
+    ++depth_;
+    if (depth_ > info_.max_depth_) {
+      info_.max_depth_ = depth_;
+    }
+
+    const bool perfect = loop->body_.size() == 1 && loop->body_.front() &&
+                         loop->body_.front()->getType() == IRNodeType::Loop;
+    for (const IRNode *child : loop->body_) {
+      size_t saved_band = current_band_;
+      bool saved_continues = continues_band_;
+      current_band_ = band;
+      continues_band_ = perfect;
+      visit(child);
+      current_band_ = saved_band;
+      continues_band_ = saved_continues;
+    }
+    --depth_;
+  }
+
+  // Expressions cannot contain loops.
+  void visitAssign(const Assign *) {}
+
+private:
+  LoopNestInfo &info_;
+  size_t current_band_ = 0;
+  bool continues_band_ = false;
+  size_t depth_ = 0;
+};
+
+class AccessCollector : public RecursiveIRVisitor<AccessCollector> {
+public:
+  explicit AccessCollector(AccessInfo &info) : info_(info) {}
+
+  void visitLoop(const Loop *loop) {
+    loops_.push_back(loop);
+    RecursiveIRVisitor::visitLoop(loop);
+    loops_.pop_back();
+  }
+
+  void visitLoad(const Load *load) {
+    record(load, load->tensor_, load->indices_, /*is_write=*/false);
+    RecursiveIRVisitor::visitLoad(load);
+  }
+
+  void visitStore(const Store *store) {
+    record(store, store->tensor_, store->indices_, /*is_write=*/true);
+    RecursiveIRVisitor::visitStore(store);
+  }
+
+  // The value is read before the target is written.
+  void visitAssign(const Assign *assign) {
+    visit(assign->value_);
+    visit(assign->target_);
+  }
+
+private:
+  void record(const IRNode *node, const Tensor &tensor,
+              const std::vector<IRNode *> &indices, bool is_write) {
+    MemoryAccess access;
+    access.node_ = node;
+    access.tensor_ = &tensor;
+    access.indices_ = &indices;
+    access.is_write_ = is_write;
+    access.loops_ = loops_;
+    info_.accesses_.push_back(std::move(access));
+  }
+
+  AccessInfo &info_;
+  std::vector<const Loop *> loops_;
+};
+
+} // namespace
+
+/**
+ * @brief Collects the maximal perfectly nested loop bands under `root`.
+ */
+LoopNestInfo LoopNestAnalysis::run(const IRContext &, const IRNode *root) {
+  LoopNestInfo info;
+  BandCollector(info).visit(root);
+  return info;
+}
+
+/**
+ * @brief Collects every Load and Store under `root` with its enclosing loops.
+ */
+AccessInfo AccessAnalysis::run(const IRContext &, const IRNode *root) {
+  AccessInfo info;
+  AccessCollector(info).visit(root);
+  return info;
+}
@@ -0,0 +1,107 @@
+#include "LoopInterchange.hpp"
+#include "AffineExpr.hpp"
+#include "TilingPass.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <numeric>
+
+std::vector<int64_t> loopOrderCost(const AccessInfo &accesses,
+                                   const std::vector<const Loop *> &band,
+                                   const std::vector<size_t> &order) {
+  std::vector<int64_t> cost;
+  for (size_t p = order.size(); p-- > 0;) {
+    const Symbol index = band[order[p]]->index_;
+    int64_t strided = 0;
+    int64_t unit_loads = 0;
+    for (const MemoryAccess &access : accesses.accesses_) {
+      const std::vector<size_t> &strides = access.tensor_->layout_.strides_;
+      if (strides.empty()) {
+        continue;
+      }
+      // Elements advanced per iteration; unknown for non-affine subscripts.
+      int64_t stride = 0;
+      bool known = true;
+      for (size_t d = 0; d < access.indices_->size(); ++d) {
+        std::optional<AffineExpr> sub = toAffine((*access.indices_)[d]);
+        if (!sub) {
+          known = false;
+          break;
+        }
+        stride += sub->coefficient(index) * static_cast<int64_t>(strides[d]);
+      }
+      const int64_t unit = static_cast<int64_t>(
+          *std::min_element(strides.begin(), strides.end()));
+      if (!known || (stride != 0 && std::abs(stride) != unit)) {
+        ++strided;
+      } else if (stride != 0 && !access.is_write_) {
+        ++unit_loads;
+      }
+    }
+    cost.push_back(strided);
+    cost.push_back(-unit_loads);
+  }
+  return cost;
+}
+
+/**
+ * @brief Scores every permutation of the band at `root` and returns the
+ * cheapest legal one.
+ *
+ * The innermost loop decides most of the cost: an access it walks across
+ * rows misses on every iteration, while a unit-stride access misses once per
+ * cache line. Among orders whose innermost loop is equally good, unit-stride
+ * loads are preferred over unit-stride stores, since a strided store only
+ * fills the store buffer but a strided load stalls. Outer loops break the
+ * remaining ties, which matters once the band is tiled.
+ *
+ * @param ctx The context that owns the IR
+ * @param root Pointer to the outermost loop of the band
+ * @param deps Dependences of `root` (see DependenceAnalysis)
+ * @return A permutation of band positions, outermost first
+ */
+std::vector<size_t> selectLoopOrder(const IRContext &ctx, const IRNode *root,
+                                    const DependenceInfo &deps) {
+  const LoopNestInfo nest = LoopNestAnalysis::run(ctx, root);
+  if (nest.bands_.empty() || nest.bands_.front().outermost() != root) {
+    return {};
+  }
+  const std::vector<const Loop *> &band = nest.bands_.front().loops_;
+  std::vector<size_t> order(band.size());
+  std::iota(order.begin(), order.end(), 0);
+
+  std::vector<size_t> best = order;
+  std::vector<int64_t> best_cost = loopOrderCost(deps.accesses_, band, order);
+  while (std::next_permutation(order.begin(), order.end())) {
+    if (!deps.isLegalOrder(band, order)) {
+      continue;
+    }
+    std::vector<int64_t> cost = loopOrderCost(deps.accesses_, band, order);
+    if (cost < best_cost) {
+      best = order;
+      best_cost = std::move(cost);
+    }
+  }
+  return best;
+}
+
+IRNode *interchangeLoops(IRContext &ctx, IRNode *root,
+                         const std::vector<size_t> &order) {
+  if (std::is_sorted(order.begin(), order.end())) {
+    return root;
+  }
+  // A band tiled at no level is just its point loops in `order`.
+  TilingResult reordered = tileBand(ctx, root, std::vector<TileLevel>{}, order);
+  return reordered ? reordered.root_ : root;
+}
+
+bool LoopInterchangePass::run(IRContext &ctx, IRNode *&root,
+                              AnalysisManager &am) {
+  std::vector<size_t> order =
+      selectLoopOrder(ctx, root, am.get<DependenceAnalysis>(root));
+  IRNode *reordered = interchangeLoops(ctx, root, order);
+  if (reordered == root) {
+    return false;
+  }
+  root = reordered;
+  return true;
+}
@@ -0,0 +1,374 @@
+#include "OperandPacking.hpp"
+#include "AffineExpr.hpp"
+#include "IRVisitor.hpp"
+#include "StructuralHash.hpp"
+#include "TilingPass.hpp"
+#include <algorithm>
+#include <map>
+#include <numeric>
+#include <optional>
+#include <set>
+#include <string>
+#include <tuple>
+
+namespace {
+
+constexpr size_t kBufferAlignment = 64;
+
+// Names of the tensors stored to under a root.
+class WrittenTensors : public RecursiveIRVisitor<WrittenTensors> {
+public:
+  void visitStore(const Store *store) {
+    names_.insert(store->tensor_.name);
+    RecursiveIRVisitor::visitStore(store);
+  }
+
+  std::set<std::string> names_;
+};
+
+// The loops of a nest in preorder, and every load and store in it.
+class NestScanner : public RecursiveIRVisitor<NestScanner> {
+public:
+  void visitLoop(const Loop *loop) {
+    loops_.push_back(loop);
+    RecursiveIRVisitor::visitLoop(loop);
+  }
+
+  void visitLoad(const Load *load) {
+    loads_.push_back(load);
+    RecursiveIRVisitor::visitLoad(load);
+  }
+
+  void visitStore(const Store *store) {
+    stores_.push_back(store);
+    RecursiveIRVisitor::visitStore(store);
+  }
+
+  std::vector<const Loop *> loops_;
+  std::vector<const Load *> loads_;
+  std::vector<const Store *> stores_;
+};
+
+// Redirects the loads of one tensor to its buffer.
+class LoadRedirector : public IRRewriter<LoadRedirector> {
+public:
+  LoadRedirector(IRContext &ctx, const Tensor &from, Tensor &to,
+                 std::vector<IRNode *> indices)
+      : IRRewriter(ctx), from_(from), to_(to), indices_(std::move(indices)) {}
+
+  IRNode *visitLoad(const Load *node) {
+    if (node->tensor_.name != from_.name) {
+      return IRRewriter::visitLoad(node);
+    }
+    return ctx_.create<Load>(to_, indices_);
+  }
+
+private:
+  const Tensor &from_;
+  Tensor &to_;
+  std::vector<IRNode *> indices_;
+};
+
+// A point loop `for i = t to min(t + size_, ...)` of tile index t.
+struct PointLoop {
+  const Loop *loop_ = nullptr;
+  Symbol tile_ = 0;
+  int64_t size_ = 0;
+};
+
+class OperandPacker {
+public:
+  OperandPacker(IRContext &ctx, unsigned mr, unsigned nr,
+                std::set<std::string> written)
+      : ctx_(ctx), mr_(mr), nr_(nr), written_(std::move(written)) {}
+
+  // Returns the statements replacing `node` (just `node` if nothing changed).
+  std::vector<IRNode *> rewrite(IRNode *node) {
+    if (node && node->getType() == IRNodeType::Block) {
+      std::vector<IRNode *> out = rewriteAll(static_cast<Block *>(node)->body_);
+      if (out == static_cast<Block *>(node)->body_) {
+        return {node};
+      }
+      return out;
+    }
+    if (!node || node->getType() != IRNodeType::Loop) {
+      return {node};
+    }
+    Loop *loop = static_cast<Loop *>(node);
+    if (pointLoop(loop)) {
+      return pack(loop);
+    }
+
+    enclosing_.push_back(loop->index_);
+    std::vector<IRNode *> body = rewriteAll(loop->body_);
+    enclosing_.pop_back();
+    if (body == loop->body_) {
+      return {loop};
+    }
+    // Leading copies that do not depend on this loop run once before it.
+    std::vector<IRNode *> out;
+    size_t lead = 0;
+    while (lead < body.size() && copies_.count(body[lead])) {
+      ++lead;
+    }
+    for (size_t s = 0; s < lead; ++s) {
+      if (!mentions(body[s], loop->index_) && !refilled(body, s, lead)) {
+        out.push_back(body[s]);
+        body[s] = nullptr;
+      }
+    }
+    body.erase(std::remove(body.begin(), body.end(), nullptr), body.end());
+    Loop *copy = static_cast<Loop *>(shallowCopy(ctx_, loop));
+    copy->body_ = std::move(body);
+    out.push_back(copy);
+    return out;
+  }
+
+private:
+  std::vector<IRNode *> rewriteAll(const std::vector<IRNode *> &stmts) {
+    std::vector<IRNode *> out;
+    for (IRNode *stmt : stmts) {
+      std::vector<IRNode *> parts = rewrite(stmt);
+      out.insert(out.end(), parts.begin(), parts.end());
+    }
+    return out;
+  }
+
+  // True if a statement of `body` after the leading copies writes the buffer
+  // that body[s] fills, which would make hoisting body[s] wrong.
+  bool refilled(const std::vector<IRNode *> &body, size_t s,
+                size_t lead) const {
+    const Tensor *buffer = copies_.at(body[s]);
+    WrittenTensors writes;
+    for (size_t t = lead; t < body.size(); ++t) {
+      writes.visit(body[t]);
+    }
+    return writes.names_.count(buffer->name) != 0;
+  }
+
+  // The tile index and size if `loop` runs over one tile of an enclosing
+  // tile loop.
+  std::optional<PointLoop> pointLoop(const Loop *loop) const {
+    const IRNode *lb = loop->lower_bound_;
+    if (!lb || lb->getType() != IRNodeType::Variable) {
+      return std::nullopt;
+    }
+    Symbol tile = static_cast<const Variable *>(lb)->symbol_;
+    if (std::find(enclosing_.begin(), enclosing_.end(), tile) ==
+        enclosing_.end()) {
+      return std::nullopt;
+    }
+    const IRNode *end = loop->upper_bound_;
+    if (end && end->getType() == IRNodeType::Min) {
+      end = static_cast<const Min *>(end)->operand_one_;
+    }
+    std::optional<AffineExpr> extent = toAffine(end);
+    if (!extent) {
+      return std::nullopt;
+    }
+    AffineExpr size = *extent - AffineExpr::symbol(tile);
+    if (!size.isConstant() || size.constant() <= 0) {
+      return std::nullopt;
+    }
+    return PointLoop{loop, tile, size.constant()};
+  }
+
+  std::vector<IRNode *> pack(Loop *nest) {
+    NestScanner scan;
+    scan.visit(nest);
+    std::map<Symbol, PointLoop> points;
+    for (const Loop *loop : scan.loops_) {
+      if (std::optional<PointLoop> point = pointLoop(loop)) {
+        points.emplace(loop->index_, *point);
+      }
+    }
+    // Loops that index the stores, outermost first.
+    std::vector<Symbol> outputs;
+    for (const Loop *loop : scan.loops_) {
+      for (const Store *store : scan.stores_) {
+        bool used = false;
+        for (const IRNode *index : store->indices_) {
+          used |= mentions(index, loop->index_);
+        }
+        if (used && std::find(outputs.begin(), outputs.end(),
+                              loop->index_) == outputs.end()) {
+          outputs.push_back(loop->index_);
+        }
+      }
+    }
+
+    std::vector<IRNode *> out;
+    IRNode *body = nest;
+    std::set<std::string> seen;
+    for (const Load *load : scan.loads_) {
+      Tensor &tensor = load->tensor_;
+      if (!seen.insert(tensor.name).second || written_.count(tensor.name) ||
+          !qualifies(tensor, scan, points)) {
+        continue;
+      }
+      std::vector<const PointLoop *> dims;
+      for (const IRNode *index : load->indices_) {
+        dims.push_back(
+            &points.at(static_cast<const Variable *>(index)->symbol_));
+      }
+
+      // Reduction dimensions first, then those that index the stores.
+      std::vector<size_t> order(dims.size());
+      std::iota(order.begin(), order.end(), 0);
+      auto is_output = [&](size_t d) {
+        return std::find(outputs.begin(), outputs.end(),
+                         dims[d]->loop_->index_) != outputs.end();
+      };
+      std::stable_partition(order.begin(), order.end(),
+                            [&](size_t d) { return !is_output(d); });
+      Tensor &buffer = bufferFor(tensor, dims, order, outputs);
+
+      std::vector<IRNode *> indices;
+      for (size_t d : order) {
+        indices.push_back(fromAffine(
+            ctx_, AffineExpr::symbol(dims[d]->loop_->index_) -
+                      AffineExpr::symbol(dims[d]->tile_)));
+      }
+      // The copy nest walks X in its own dimension order.
+      IRNode *copy = ctx_.create<Assign>(
+          ctx_.create<Store>(buffer, indices),
+          ctx_.create<Load>(tensor, load->indices_));
+      for (size_t d = dims.size(); d-- > 0;) {
+        Loop *loop =
+            static_cast<Loop *>(shallowCopy(ctx_, dims[d]->loop_));
+        loop->body_ = {copy};
+        copy = loop;
+      }
+      copies_.emplace(copy, &buffer);
+      out.push_back(copy);
+      body = LoadRedirector(ctx_, tensor, buffer, std::move(indices))
+                 .rewrite(body);
+    }
+    out.push_back(body);
+    return out;
+  }
+
+  // Every load of `tensor` in the nest has the same subscripts, each the
+  // index of a different rectangular point loop.
+  bool qualifies(const Tensor &tensor, const NestScanner &scan,
+                 const std::map<Symbol, PointLoop> &points) const {
+    const Load *first = nullptr;
+    for (const Load *load : scan.loads_) {
+      if (load->tensor_.name != tensor.name) {
+        continue;
+      }
+      if (!first) {
+        first = load;
+      } else if (load->indices_.size() != first->indices_.size() ||
+                 !std::equal(load->indices_.begin(), load->indices_.end(),
+                             first->indices_.begin(),
+                             [this](const IRNode *a, const IRNode *b) {
+                               return structurallyEqual(ctx_, a, b);
+                             })) {
+        return false;
+      }
+    }
+    std::set<Symbol> used;
+    for (const IRNode *index : first->indices_) {
+      if (!index || index->getType() != IRNodeType::Variable) {
+        return false;
+      }
+      Symbol sym = static_cast<const Variable *>(index)->symbol_;
+      auto it = points.find(sym);
+      if (it == points.end() || !used.insert(sym).second) {
+        return false;
+      }
+      const Loop *loop = it->second.loop_;
+      for (const Loop *other : scan.loops_) {
+        if (mentions(loop->lower_bound_, other->index_) ||
+            mentions(loop->upper_bound_, other->index_) ||
+            mentions(loop->step_, other->index_)) {
+          return false;
+        }
+      }
+    }
+    return !first->indices_.empty();
+  }
+
+  // The buffer for one tile of `tensor` with dimensions dims[order[e]].
+  Tensor &bufferFor(const Tensor &tensor,
+                    const std::vector<const PointLoop *> &dims,
+                    const std::vector<size_t> &order,
+                    const std::vector<Symbol> &outputs) {
+    std::vector<size_t> extents;
+    for (size_t d : order) {
+      extents.push_back(static_cast<size_t>(dims[d]->size_));
+    }
+    // The micro-kernel reads mr rows of the outer output loop (nr columns of
+    // the inner one) per reduction step.
+    size_t block = 1;
+    const Symbol last = dims[order.back()]->loop_->index_;
+    if (!outputs.empty() && last == outputs[0]) {
+      block = mr_;
+    } else if (outputs.size() > 1 && last == outputs[1]) {
+      block = nr_;
+    }
+    TensorLayout layout;
+    if (block > 1 && block < extents.back()) {
+      std::vector<size_t> blocks = extents;
+      blocks.back() = block;
+      layout = TensorLayout::blocked(extents, blocks, kBufferAlignment);
+    } else {
+      layout = TensorLayout::rowMajor(extents, 0, kBufferAlignment);
+    }
+
+    auto key = std::make_tuple(tensor.name, extents, layout.block_);
+    auto it = buffers_.find(key);
+    if (it != buffers_.end()) {
+      return *it->second;
+    }
+    std::string name = ctx_.name(ctx_.symbols().fresh(tensor.name + "p"));
+    Tensor *buffer = ctx_.makeBuffer(name, tensor.dtype_, extents, layout);
+    buffers_.emplace(key, buffer);
+    return *buffer;
+  }
+
+  IRContext &ctx_;
+  unsigned mr_;
+  unsigned nr_;
+  std::set<std::string> written_;
+  std::vector<Symbol> enclosing_;
+  // Copy nests built so far, with the buffer each fills.
+  std::map<const IRNode *, const Tensor *> copies_;
+  std::map<std::tuple<std::string, std::vector<size_t>, std::vector<size_t>>,
+           Tensor *>
+      buffers_;
+};
+
+} // namespace
+
+/**
+ * @brief Operand packing (see OperandPacking.hpp).
+ *
+ * @param ctx The context that owns the input and will own the result and
+ * the buffers
+ * @param root The root of the IR, after tiling
+ * @param mr Rows of the register block that will read the buffers
+ * @param nr Columns of the register block
+ * @return The new root; the copy nests share their loop bounds with it.
+ */
+IRNode *packOperands(IRContext &ctx, IRNode *root, unsigned mr, unsigned nr) {
+  WrittenTensors written;
+  written.visit(root);
+  std::vector<IRNode *> parts =
+      OperandPacker(ctx, mr, nr, std::move(written.names_)).rewrite(root);
+  if (parts.size() == 1) {
+    return parts.front();
+  }
+  return ctx.create<Block>(std::move(parts));
+}
+
+bool OperandPackingPass::run(IRContext &ctx, IRNode *&root,
+                             AnalysisManager &) {
+  IRNode *result = packOperands(ctx, root, mr_, nr_);
+  if (result == root) {
+    return false;
+  }
+  root = result;
+  return true;
+}
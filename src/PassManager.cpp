@@ -0,0 +1,70 @@
+#include "PassManager.hpp"
+#include <iomanip>
+
+void AnalysisManager::invalidate() { cache_.clear(); }
+
+bool RewritePass::run(IRContext &ctx, IRNode *&root, AnalysisManager &) {
+  IRNode *result = transform_(ctx, root);
+  if (result == root) {
+    return false;
+  }
+  root = result;
+  return true;
+}
+
+/**
+ * @brief Runs every registered pass in order on `root`.
+ *
+ * Analyses computed by one pass are reused by the next as long as no pass in
+ * between reported a change. Allocation counts come from the IRContext, so a
+ * pass that rolls back its own scratch nodes is only charged for what it
+ * keeps.
+ *
+ * @param root The root of the IR to transform (owned by the context).
+ * @return The root after the last pass.
+ */
+IRNode *PassManager::run(IRNode *root) {
+  for (const std::unique_ptr<Pass> &pass : passes_) {
+    const size_t nodes_before = ctx_.numNodes();
+    const size_t bytes_before = ctx_.bytesUsed();
+    auto start = std::chrono::steady_clock::now();
+
+    bool changed = pass->run(ctx_, root, analyses_);
+
+    auto end = std::chrono::steady_clock::now();
+    if (changed) {
+      analyses_.invalidate();
+    }
+
+    PassStats s;
+    s.name_ = pass->name();
+    s.wall_ms_ = std::chrono::duration<double, std::milli>(end - start).count();
+    s.nodes_allocated_ =
+        ctx_.numNodes() > nodes_before ? ctx_.numNodes() - nodes_before : 0;
+    s.bytes_allocated_ =
+        ctx_.bytesUsed() > bytes_before ? ctx_.bytesUsed() - bytes_before : 0;
+    s.changed_ = changed;
+    stats_.push_back(std::move(s));
+  }
+  return root;
+}
+
+void PassManager::printReport(std::ostream &os) const {
+  std::ios_base::fmtflags flags = os.flags();
+  os << std::fixed << std::setprecision(3);
+  os << "=== Pass timing ===\n";
+  for (const PassStats &s : stats_) {
+    os << "  " << std::left << std::setw(24) << s.name_ << std::right
+       << std::setw(10) << s.wall_ms_ << " ms  " << std::setw(8)
+       << s.nodes_allocated_ << " nodes  " << std::setw(10)
+       << s.bytes_allocated_ << " bytes  "
+       << (s.changed_ ? "changed" : "unchanged") << "\n";
+  }
+  os << "=== Analyses ===\n";
+  for (const AnalysisManager::AnalysisStats &s : analyses_.stats()) {
+    os << "  " << std::left << std::setw(24) << s.name_ << std::right
+       << std::setw(10) << s.wall_ms_ << " ms  " << std::setw(8) << s.runs_
+       << " runs   " << std::setw(10) << s.hits_ << " hits\n";
+  }
+  os.flags(flags);
+}
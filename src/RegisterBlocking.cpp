@@ -0,0 +1,362 @@
+#include "RegisterBlocking.hpp"
+#include "AffineExpr.hpp"
+#include "IRVisitor.hpp"
+#include "StructuralHash.hpp"
+#include "TilingPass.hpp"
+#include <cctype>
+#include <map>
+#include <string>
+#include <tuple>
+
+namespace {
+
+// Reports whether an expression loads from the tensor named `name`.
+class TensorReader : public RecursiveIRVisitor<TensorReader> {
+public:
+  explicit TensorReader(const std::string &name) : name_(name) {}
+
+  void visitLoad(const Load *load) {
+    found_ |= load->tensor_.name == name_;
+    RecursiveIRVisitor::visitLoad(load);
+  }
+
+  bool found_ = false;
+
+private:
+  const std::string &name_;
+};
+
+// A nest `X[f] = X[f] op y` matched by RegisterBlocker.
+struct ReductionNest {
+  Loop *p_ = nullptr; // Outer loop that indexes X.
+  Loop *q_ = nullptr; // Inner loop that indexes X.
+  Loop *k_ = nullptr; // The loop that does not.
+  IRNode *body_ = nullptr; // The update, innermost.
+  const Store *store_ = nullptr;
+  const IRNode *update_ = nullptr; // y.
+  IRNodeType op_ = IRNodeType::Add;
+  bool accumulator_first_ = true; // X[f] op y rather than y op X[f].
+};
+
+class RegisterBlocker {
+public:
+  RegisterBlocker(IRContext &ctx, unsigned mr, unsigned nr,
+                  const DependenceInfo &deps)
+      : ctx_(ctx), mr_(mr), nr_(nr), deps_(deps) {}
+
+  // Returns the statements replacing `node` (just `node` if nothing changed).
+  std::vector<IRNode *> rewrite(IRNode *node) {
+    if (node && node->getType() == IRNodeType::Block) {
+      std::vector<IRNode *> out = rewriteAll(static_cast<Block *>(node)->body_);
+      if (out == static_cast<Block *>(node)->body_) {
+        return {node};
+      }
+      return out;
+    }
+    if (!node || node->getType() != IRNodeType::Loop) {
+      return {node};
+    }
+    Loop *loop = static_cast<Loop *>(node);
+
+    ReductionNest nest;
+    if (match(loop, nest)) {
+      std::vector<IRNode *> parts = block(nest);
+      if (!parts.empty()) {
+        return parts;
+      }
+    }
+
+    std::vector<IRNode *> body = rewriteAll(loop->body_);
+    if (body == loop->body_) {
+      return {loop};
+    }
+    Loop *copy = static_cast<Loop *>(shallowCopy(ctx_, loop));
+    copy->body_ = std::move(body);
+    return {copy};
+  }
+
+private:
+  std::vector<IRNode *> rewriteAll(const std::vector<IRNode *> &stmts) {
+    std::vector<IRNode *> out;
+    for (IRNode *stmt : stmts) {
+      std::vector<IRNode *> parts = rewrite(stmt);
+      out.insert(out.end(), parts.begin(), parts.end());
+    }
+    return out;
+  }
+
+  // Reports whether `loop` starts a legal 3-loop reduction nest and fills in
+  // `nest` if so.
+  bool match(Loop *loop, ReductionNest &nest) const {
+    std::vector<Loop *> chain{loop};
+    while (chain.size() < 3 && chain.back()->body_.size() == 1 &&
+           chain.back()->body_.front() &&
+           chain.back()->body_.front()->getType() == IRNodeType::Loop) {
+      chain.push_back(static_cast<Loop *>(chain.back()->body_.front()));
+    }
+    if (chain.size() != 3 || chain.back()->body_.size() != 1) {
+      return false;
+    }
+    const IRNode *stmt = chain.back()->body_.front();
+    if (!stmt || stmt->getType() != IRNodeType::Assign) {
+      return false;
+    }
+    const Assign *assign = static_cast<const Assign *>(stmt);
+    nest.body_ = chain.back()->body_.front();
+    if (!assign->target_ || assign->target_->getType() != IRNodeType::Store ||
+        !assign->value_) {
+      return false;
+    }
+    nest.op_ = assign->value_->getType();
+    if (nest.op_ != IRNodeType::Add && nest.op_ != IRNodeType::Mul &&
+        nest.op_ != IRNodeType::Min) {
+      return false;
+    }
+    nest.store_ = static_cast<const Store *>(assign->target_);
+    // Add, Mul and Min share the two-operand layout
+    const Add *value = static_cast<const Add *>(assign->value_);
+    if (isElement(value->operand_one_, nest.store_)) {
+      nest.update_ = value->operand_two_;
+    } else if (isElement(value->operand_two_, nest.store_)) {
+      nest.update_ = value->operand_one_;
+      nest.accumulator_first_ = false;
+    } else {
+      return false;
+    }
+    TensorReader reader(nest.store_->tensor_.name);
+    reader.visit(nest.update_);
+    if (reader.found_) {
+      return false;
+    }
+
+    std::vector<Loop *> indexing;
+    for (Loop *l : chain) {
+      bool used = false;
+      for (const IRNode *index : nest.store_->indices_) {
+        used |= mentions(index, l->index_);
+      }
+      if (used) {
+        indexing.push_back(l);
+      } else if (nest.k_) {
+        return false; // More than one reduction loop.
+      } else {
+        nest.k_ = l;
+      }
+    }
+    if (!nest.k_) {
+      return false;
+    }
+    nest.p_ = indexing[0];
+    nest.q_ = indexing[1];
+
+    for (const Loop *a : chain) {
+      for (const Loop *b : chain) {
+        if (mentions(a->lower_bound_, b->index_) ||
+            mentions(a->upper_bound_, b->index_) ||
+            mentions(a->step_, b->index_)) {
+          return false;
+        }
+      }
+    }
+    // Distinct (r, c) must address distinct elements of X.
+    bool p_only = false;
+    bool q_only = false;
+    for (const IRNode *index : nest.store_->indices_) {
+      std::optional<AffineExpr> sub = toAffine(index);
+      if (!sub) {
+        continue;
+      }
+      const int64_t cp = sub->coefficient(nest.p_->index_);
+      const int64_t cq = sub->coefficient(nest.q_->index_);
+      p_only |= cp != 0 && cq == 0;
+      q_only |= cq != 0 && cp == 0;
+    }
+    if (!p_only || !q_only) {
+      return false;
+    }
+    return deps_.isPermutable({chain[0], chain[1], chain[2]});
+  }
+
+  // True if `node` loads the element `store` writes.
+  bool isElement(const IRNode *node, const Store *store) const {
+    if (!node || node->getType() != IRNodeType::Load) {
+      return false;
+    }
+    const Load *load = static_cast<const Load *>(node);
+    if (load->tensor_.name != store->tensor_.name ||
+        load->indices_.size() != store->indices_.size()) {
+      return false;
+    }
+    for (size_t d = 0; d < load->indices_.size(); ++d) {
+      if (!structurallyEqual(ctx_, load->indices_[d], store->indices_[d])) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  std::vector<IRNode *> block(const ReductionNest &nest) {
+    std::optional<int64_t> sp = constantStep(nest.p_);
+    std::optional<int64_t> sq = constantStep(nest.q_);
+    if (!sp || !sq) {
+      return {};
+    }
+    IRNode *end_p = alignedEnd(ctx_, nest.p_->lower_bound_,
+                               nest.p_->upper_bound_, *sp * mr_);
+    IRNode *end_q = alignedEnd(ctx_, nest.q_->lower_bound_,
+                               nest.q_->upper_bound_, *sq * nr_);
+    if (sameBound(end_p, nest.p_->lower_bound_) ||
+        sameBound(end_q, nest.q_->lower_bound_)) {
+      return {}; // Not even one whole block.
+    }
+
+    std::vector<IRNode *> loads;
+    std::vector<IRNode *> updates;
+    std::vector<IRNode *> stores;
+    IRNode *p = ctx_.makeVariable(nest.p_->index_);
+    IRNode *q = ctx_.makeVariable(nest.q_->index_);
+    for (unsigned r = 0; r < mr_; ++r) {
+      IRNode *row = simplifyExpr(ctx_, ctx_.makeAdd(p, intConst(r * *sp)));
+      for (unsigned c = 0; c < nr_; ++c) {
+        IRNode *col = simplifyExpr(ctx_, ctx_.makeAdd(q, intConst(c * *sq)));
+        auto at = [&](const IRNode *node) {
+          return substituteIndex(
+              ctx_, substituteIndex(ctx_, node, nest.p_->index_, row),
+              nest.q_->index_, col);
+        };
+        IRNode *acc =
+            ctx_.makeVariable(accumulator(nest.store_->tensor_.name, r, c));
+        Store *element = static_cast<Store *>(at(nest.store_));
+        loads.push_back(ctx_.create<Assign>(
+            acc, ctx_.create<Load>(element->tensor_, element->indices_)));
+        IRNode *y = at(nest.update_);
+        updates.push_back(ctx_.create<Assign>(
+            acc, nest.accumulator_first_ ? combine(nest.op_, acc, y)
+                                         : combine(nest.op_, y, acc)));
+        stores.push_back(ctx_.create<Assign>(element, acc));
+      }
+    }
+
+    Loop *k = static_cast<Loop *>(shallowCopy(ctx_, nest.k_));
+    k->body_ = std::move(updates);
+    Loop *cols = ctx_.create<Loop>(nest.q_->index_, nest.q_->lower_bound_,
+                                   end_q, intConst(*sq * nr_));
+    cols->body_ = std::move(loads);
+    cols->body_.push_back(k);
+    cols->body_.insert(cols->body_.end(), stores.begin(), stores.end());
+    Loop *rows = ctx_.create<Loop>(nest.p_->index_, nest.p_->lower_bound_,
+                                   end_p, intConst(*sp * mr_));
+    rows->body_ = {cols};
+
+    std::vector<IRNode *> parts{rows};
+    if (!sameBound(end_q, nest.q_->upper_bound_)) {
+      parts.push_back(remainder(nest, nest.p_->lower_bound_, end_p, end_q,
+                                nest.q_->upper_bound_));
+    }
+    if (!sameBound(end_p, nest.p_->upper_bound_)) {
+      parts.push_back(remainder(nest, end_p, nest.p_->upper_bound_,
+                                nest.q_->lower_bound_, nest.q_->upper_bound_));
+    }
+    return parts;
+  }
+
+  // The original nest, in p, q, k order, over part of the p x q rectangle.
+  Loop *remainder(const ReductionNest &nest, IRNode *p_lb, IRNode *p_ub,
+                  IRNode *q_lb, IRNode *q_ub) {
+    Loop *k = static_cast<Loop *>(shallowCopy(ctx_, nest.k_));
+    k->body_ = {nest.body_};
+    Loop *q = ctx_.create<Loop>(nest.q_->index_, q_lb, q_ub, nest.q_->step_);
+    q->body_ = {k};
+    Loop *p = ctx_.create<Loop>(nest.p_->index_, p_lb, p_ub, nest.p_->step_);
+    p->body_ = {q};
+    return p;
+  }
+
+  // One accumulator per block position and tensor, shared by every nest
+  // this pass blocks (the nests run one after another), e.g. c_1_2.
+  Symbol accumulator(const std::string &tensor, unsigned r, unsigned c) {
+    auto key = std::make_tuple(tensor, r, c);
+    auto it = accumulators_.find(key);
+    if (it != accumulators_.end()) {
+      return it->second;
+    }
+    std::string hint;
+    for (char ch : tensor) {
+      hint += static_cast<char>(std::tolower(static_cast<unsigned char>(ch)));
+    }
+    hint += "_" + std::to_string(r) + "_" + std::to_string(c);
+    return accumulators_[key] = ctx_.symbols().fresh(hint);
+  }
+
+  IRNode *combine(IRNodeType op, IRNode *one, IRNode *two) {
+    switch (op) {
+    case IRNodeType::Mul:
+      return ctx_.makeMul(one, two);
+    case IRNodeType::Min:
+      return ctx_.makeMin(one, two);
+    default:
+      return ctx_.makeAdd(one, two);
+    }
+  }
+
+  static std::optional<int64_t> constantStep(const Loop *loop) {
+    std::optional<AffineExpr> step = toAffine(loop->step_);
+    if (!step || !step->isConstant() || step->constant() <= 0) {
+      return std::nullopt;
+    }
+    return step->constant();
+  }
+
+  static bool sameBound(const IRNode *a, const IRNode *b) {
+    std::optional<AffineExpr> a_affine = toAffine(a);
+    std::optional<AffineExpr> b_affine = toAffine(b);
+    return a_affine && b_affine && *a_affine == *b_affine;
+  }
+
+  IRNode *intConst(int64_t value) {
+    return ctx_.makeConst(ConstValue(static_cast<int>(value)), DType::Int32);
+  }
+
+  IRContext &ctx_;
+  unsigned mr_;
+  unsigned nr_;
+  const DependenceInfo &deps_;
+  std::map<std::tuple<std::string, unsigned, unsigned>, Symbol> accumulators_;
+};
+
+} // namespace
+
+/**
+ * @brief Register blocking (see RegisterBlocking.hpp).
+ *
+ * @param ctx The context that owns the input and will own the result
+ * @param root The root of the IR, typically after tiling
+ * @param mr Block rows (iterations of the outer indexing loop)
+ * @param nr Block columns (iterations of the inner indexing loop)
+ * @param deps Dependences of `root`, used to reject illegal blocks
+ * @return The new root; the remainder nests share their bodies with the
+ * input.
+ */
+IRNode *registerBlock(IRContext &ctx, IRNode *root, unsigned mr, unsigned nr,
+                      const DependenceInfo &deps) {
+  if (mr * nr < 2) {
+    return root;
+  }
+  std::vector<IRNode *> parts =
+      RegisterBlocker(ctx, mr, nr, deps).rewrite(root);
+  if (parts.size() == 1) {
+    return parts.front();
+  }
+  return ctx.create<Block>(std::move(parts));
+}
+
+bool RegisterBlockingPass::run(IRContext &ctx, IRNode *&root,
+                               AnalysisManager &am) {
+  IRNode *result =
+      registerBlock(ctx, root, mr_, nr_, am.get<DependenceAnalysis>(root));
+  if (result == root) {
+    return false;
+  }
+  root = result;
+  return true;
+}
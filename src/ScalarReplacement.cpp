@@ -0,0 +1,222 @@
+#include "ScalarReplacement.hpp"
+#include "IRVisitor.hpp"
+#include "StructuralHash.hpp"
+#include "TilingPass.hpp"
+#include <cctype>
+#include <map>
+#include <string>
+
+namespace {
+
+bool sameIndices(const IRContext &ctx, const std::vector<IRNode *> &a,
+                 const std::vector<IRNode *> &b) {
+  if (a.size() != b.size()) {
+    return false;
+  }
+  for (size_t d = 0; d < a.size(); ++d) {
+    if (!structurallyEqual(ctx, a[d], b[d])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Checks that every access to one tensor addresses the same element, and
+// whether one of them is a load.
+class ElementChecker : public RecursiveIRVisitor<ElementChecker> {
+public:
+  ElementChecker(const IRContext &ctx, const Store *element)
+      : ctx_(ctx), element_(element) {}
+
+  void visitLoad(const Load *load) {
+    if (load->tensor_.name == element_->tensor_.name) {
+      same_ &= sameIndices(ctx_, load->indices_, element_->indices_);
+      loaded_ = true;
+    }
+    RecursiveIRVisitor::visitLoad(load);
+  }
+
+  void visitStore(const Store *store) {
+    if (store->tensor_.name == element_->tensor_.name) {
+      same_ &= sameIndices(ctx_, store->indices_, element_->indices_);
+    }
+    RecursiveIRVisitor::visitStore(store);
+  }
+
+  bool qualifies() const { return same_ && loaded_; }
+
+private:
+  const IRContext &ctx_;
+  const Store *element_;
+  bool same_ = true;
+  bool loaded_ = false;
+};
+
+// Replaces the loads and stores of one element by a local.
+class ElementReplacer : public IRRewriter<ElementReplacer> {
+public:
+  ElementReplacer(IRContext &ctx, const Store *element, IRNode *local)
+      : IRRewriter(ctx), element_(element), local_(local) {}
+
+  IRNode *visitLoad(const Load *node) {
+    return matches(node->tensor_, node->indices_) ? local_
+                                                  : IRRewriter::visitLoad(node);
+  }
+
+  IRNode *visitStore(const Store *node) {
+    return matches(node->tensor_, node->indices_)
+               ? local_
+               : IRRewriter::visitStore(node);
+  }
+
+private:
+  bool matches(const Tensor &tensor, const std::vector<IRNode *> &indices) {
+    return tensor.name == element_->tensor_.name &&
+           sameIndices(ctx_, indices, element_->indices_);
+  }
+
+  const Store *element_;
+  IRNode *local_;
+};
+
+class ScalarReplacer {
+public:
+  explicit ScalarReplacer(IRContext &ctx) : ctx_(ctx) {}
+
+  // Returns the statements replacing `node` (just `node` if nothing changed).
+  std::vector<IRNode *> rewrite(IRNode *node) {
+    if (node && node->getType() == IRNodeType::Block) {
+      std::vector<IRNode *> out = rewriteAll(static_cast<Block *>(node)->body_);
+      if (out == static_cast<Block *>(node)->body_) {
+        return {node};
+      }
+      return out;
+    }
+    if (!node || node->getType() != IRNodeType::Loop) {
+      return {node};
+    }
+    Loop *loop = static_cast<Loop *>(node);
+    if (innermost(loop)) {
+      return replace(loop);
+    }
+
+    std::vector<IRNode *> body = rewriteAll(loop->body_);
+    if (body == loop->body_) {
+      return {loop};
+    }
+    Loop *copy = static_cast<Loop *>(shallowCopy(ctx_, loop));
+    copy->body_ = std::move(body);
+    return {copy};
+  }
+
+private:
+  std::vector<IRNode *> rewriteAll(const std::vector<IRNode *> &stmts) {
+    std::vector<IRNode *> out;
+    for (IRNode *stmt : stmts) {
+      std::vector<IRNode *> parts = rewrite(stmt);
+      out.insert(out.end(), parts.begin(), parts.end());
+    }
+    return out;
+  }
+
+  static bool innermost(const Loop *loop) {
+    for (const IRNode *stmt : loop->body_) {
+      if (!stmt || stmt->getType() == IRNodeType::Loop ||
+          stmt->getType() == IRNodeType::Block) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  std::vector<IRNode *> replace(Loop *loop) {
+    std::vector<IRNode *> before;
+    std::vector<IRNode *> after;
+    std::vector<IRNode *> body = loop->body_;
+    for (const IRNode *stmt : loop->body_) {
+      if (stmt->getType() != IRNodeType::Assign) {
+        continue;
+      }
+      const IRNode *target = static_cast<const Assign *>(stmt)->target_;
+      if (!target || target->getType() != IRNodeType::Store) {
+        continue;
+      }
+      const Store *element = static_cast<const Store *>(target);
+      bool invariant = true;
+      for (const IRNode *index : element->indices_) {
+        invariant &= !mentions(index, loop->index_);
+      }
+      if (!invariant || !qualifies(body, element)) {
+        continue;
+      }
+      IRNode *local = ctx_.makeVariable(localFor(element->tensor_.name));
+      before.push_back(ctx_.create<Assign>(
+          local, ctx_.create<Load>(element->tensor_, element->indices_)));
+      after.push_back(ctx_.create<Assign>(
+          ctx_.create<Store>(element->tensor_, element->indices_), local));
+      ElementReplacer replacer(ctx_, element, local);
+      for (IRNode *&s : body) {
+        s = replacer.rewrite(s);
+      }
+    }
+    if (before.empty()) {
+      return {loop};
+    }
+    Loop *copy = static_cast<Loop *>(shallowCopy(ctx_, loop));
+    copy->body_ = std::move(body);
+    before.push_back(copy);
+    before.insert(before.end(), after.begin(), after.end());
+    return before;
+  }
+
+  bool qualifies(const std::vector<IRNode *> &body, const Store *element) {
+    ElementChecker checker(ctx_, element);
+    for (const IRNode *stmt : body) {
+      checker.visit(stmt);
+    }
+    return checker.qualifies();
+  }
+
+  // One local per tensor, named after it (e.g. c for C).
+  Symbol localFor(const std::string &tensor) {
+    auto it = locals_.find(tensor);
+    if (it != locals_.end()) {
+      return it->second;
+    }
+    std::string hint;
+    for (char ch : tensor) {
+      hint += static_cast<char>(std::tolower(static_cast<unsigned char>(ch)));
+    }
+    return locals_[tensor] = ctx_.symbols().fresh(hint);
+  }
+
+  IRContext &ctx_;
+  std::map<std::string, Symbol> locals_;
+};
+
+} // namespace
+
+/**
+ * @brief Scalar replacement (see ScalarReplacement.hpp).
+ *
+ * @param ctx The context that owns the input and will own the result
+ * @param root The root of the IR
+ * @return The new root; unchanged statements are shared with the input.
+ */
+IRNode *scalarReplace(IRContext &ctx, IRNode *root) {
+  std::vector<IRNode *> parts = ScalarReplacer(ctx).rewrite(root);
+  if (parts.size() == 1) {
+    return parts.front();
+  }
+  return ctx.create<Block>(std::move(parts));
+}
+
+bool ScalarReplacementPass::run(IRContext &ctx, IRNode *&root,
+                                AnalysisManager &) {
+  IRNode *result = scalarReplace(ctx, root);
+  if (result == root) {
+    return false;
+  }
+  root = result;
+  return true;
+}
@@ -0,0 +1,261 @@
+#include "StructuralHash.hpp"
+#include <cstring>
+
+// --- Hash mixing (fixed constants so results are stable across builds) ---
+
+namespace {
+
+uint64_t mix(uint64_t h) {
+  // splitmix64 finalizer
+  h ^= h >> 30;
+  h *= 0xbf58476d1ce4e5b9ULL;
+  h ^= h >> 27;
+  h *= 0x94d049bb133111ebULL;
+  h ^= h >> 31;
+  return h;
+}
+
+uint64_t combine(uint64_t seed, uint64_t value) {
+  return mix(seed ^
+             (value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2)));
+}
+
+// FNV-1a over the bytes of a string.
+uint64_t hashString(const std::string &s) {
+  uint64_t h = 0xcbf29ce484222325ULL;
+  for (unsigned char c : s) {
+    h ^= c;
+    h *= 0x100000001b3ULL;
+  }
+  return h;
+}
+
+uint64_t hashConstValue(const ConstValue &value) {
+  uint64_t bits = std::visit(
+      [](auto arg) -> uint64_t {
+        uint64_t out = 0;
+        std::memcpy(&out, &arg, sizeof(arg));
+        return out;
+      },
+      value);
+  return combine(value.index(), bits);
+}
+
+uint64_t hashTensor(const Tensor &t) {
+  uint64_t h = combine(hashString(t.name), static_cast<uint64_t>(t.dtype_));
+  for (size_t extent : t.extents_) {
+    h = combine(h, extent);
+  }
+  // The layout changes the generated addressing, so it is part of the key.
+  const TensorLayout &layout = t.layout_;
+  for (const std::vector<size_t> *v :
+       {&layout.strides_, &layout.block_, &layout.block_strides_}) {
+    h = combine(h, v->size());
+    for (size_t x : *v) {
+      h = combine(h, x);
+    }
+  }
+  h = combine(h, layout.alignment_);
+  // A kernel-local buffer is never the global tensor of the same shape.
+  return combine(h, t.local_);
+}
+
+uint64_t hashChildren(const IRContext &ctx, uint64_t h,
+                      const std::vector<IRNode *> &children) {
+  h = combine(h, children.size());
+  for (const IRNode *child : children) {
+    h = combine(h, structuralHash(ctx, child));
+  }
+  return h;
+}
+
+uint64_t computeHash(const IRContext &ctx, const IRNode *node) {
+  uint64_t h = mix(static_cast<uint64_t>(node->getType()) + 1);
+
+  switch (node->getType()) {
+  case IRNodeType::Const: {
+    const Const *c = static_cast<const Const *>(node);
+    h = combine(h, static_cast<uint64_t>(c->dtype_));
+    return combine(h, hashConstValue(c->value_));
+  }
+  case IRNodeType::Variable: {
+    const Variable *v = static_cast<const Variable *>(node);
+    return combine(h, hashString(ctx.name(v->symbol_)));
+  }
+  case IRNodeType::Add:
+  case IRNodeType::Mul:
+  case IRNodeType::Min:
+  case IRNodeType::Div: {
+    // Add, Mul, Min and Div share the two-operand layout
+    const Add *b = static_cast<const Add *>(node);
+    h = combine(h, structuralHash(ctx, b->operand_one_));
+    return combine(h, structuralHash(ctx, b->operand_two_));
+  }
+  case IRNodeType::Load: {
+    const Load *l = static_cast<const Load *>(node);
+    return hashChildren(ctx, combine(h, hashTensor(l->tensor_)), l->indices_);
+  }
+  case IRNodeType::Store: {
+    const Store *s = static_cast<const Store *>(node);
+    return hashChildren(ctx, combine(h, hashTensor(s->tensor_)), s->indices_);
+  }
+  case IRNodeType::Assign: {
+    const Assign *a = static_cast<const Assign *>(node);
+    h = combine(h, structuralHash(ctx, a->target_));
+    return combine(h, structuralHash(ctx, a->value_));
+  }
+  case IRNodeType::Loop: {
+    const Loop *l = static_cast<const Loop *>(node);
+    h = combine(h, hashString(ctx.name(l->index_)));
+    h = combine(h, structuralHash(ctx, l->lower_bound_));
+    h = combine(h, structuralHash(ctx, l->upper_bound_));
+    h = combine(h, structuralHash(ctx, l->step_));
+    return hashChildren(ctx, h, l->body_);
+  }
+  case IRNodeType::Block:
+    return hashChildren(ctx, h, static_cast<const Block *>(node)->body_);
+  case IRNodeType::RecursiveNest: {
+    const RecursiveNest *r = static_cast<const RecursiveNest *>(node);
+    h = combine(h, r->base_sizes_.size());
+    for (int64_t size : r->base_sizes_) {
+      h = combine(h, static_cast<uint64_t>(size));
+    }
+    return combine(h, structuralHash(ctx, r->band_));
+  }
+  case IRNodeType::CurveNest: {
+    const CurveNest *c = static_cast<const CurveNest *>(node);
+    h = combine(h, static_cast<uint64_t>(c->curve_));
+    return combine(h, structuralHash(ctx, c->band_));
+  }
+  default:
+    return h;
+  }
+}
+
+bool sameTensor(const Tensor &a, const Tensor &b) {
+  return &a == &b || (a.name == b.name && a.dtype_ == b.dtype_ &&
+                      a.extents_ == b.extents_ && a.layout_ == b.layout_ &&
+                      a.local_ == b.local_);
+}
+
+bool equalImpl(const IRContext &ctx_a, const IRNode *a, const IRContext &ctx_b,
+               const IRNode *b);
+
+bool equalVectors(const IRContext &ctx_a, const std::vector<IRNode *> &a,
+                  const IRContext &ctx_b, const std::vector<IRNode *> &b) {
+  if (a.size() != b.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < a.size(); ++i) {
+    if (!equalImpl(ctx_a, a[i], ctx_b, b[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool equalImpl(const IRContext &ctx_a, const IRNode *a, const IRContext &ctx_b,
+               const IRNode *b) {
+  const bool same_ctx = &ctx_a == &ctx_b;
+  if (a == b && same_ctx) {
+    return true;
+  }
+  if (!a || !b || a->getType() != b->getType()) {
+    return false;
+  }
+  // Cached hashes make unequal subtrees cheap to reject.
+  if (structuralHash(ctx_a, a) != structuralHash(ctx_b, b)) {
+    return false;
+  }
+
+  auto same_symbol = [&](Symbol x, Symbol y) {
+    return same_ctx ? x == y : ctx_a.name(x) == ctx_b.name(y);
+  };
+
+  switch (a->getType()) {
+  case IRNodeType::Const: {
+    const Const *ca = static_cast<const Const *>(a);
+    const Const *cb = static_cast<const Const *>(b);
+    return ca->dtype_ == cb->dtype_ && ca->value_ == cb->value_;
+  }
+  case IRNodeType::Variable:
+    return same_symbol(static_cast<const Variable *>(a)->symbol_,
+                       static_cast<const Variable *>(b)->symbol_);
+  case IRNodeType::Add:
+  case IRNodeType::Mul:
+  case IRNodeType::Min:
+  case IRNodeType::Div: {
+    const Add *ba = static_cast<const Add *>(a);
+    const Add *bb = static_cast<const Add *>(b);
+    return equalImpl(ctx_a, ba->operand_one_, ctx_b, bb->operand_one_) &&
+           equalImpl(ctx_a, ba->operand_two_, ctx_b, bb->operand_two_);
+  }
+  case IRNodeType::Load: {
+    const Load *la = static_cast<const Load *>(a);
+    const Load *lb = static_cast<const Load *>(b);
+    return sameTensor(la->tensor_, lb->tensor_) &&
+           equalVectors(ctx_a, la->indices_, ctx_b, lb->indices_);
+  }
+  case IRNodeType::Store: {
+    const Store *sa = static_cast<const Store *>(a);
+    const Store *sb = static_cast<const Store *>(b);
+    return sameTensor(sa->tensor_, sb->tensor_) &&
+           equalVectors(ctx_a, sa->indices_, ctx_b, sb->indices_);
+  }
+  case IRNodeType::Assign: {
+    const Assign *aa = static_cast<const Assign *>(a);
+    const Assign *ab = static_cast<const Assign *>(b);
+    return equalImpl(ctx_a, aa->target_, ctx_b, ab->target_) &&
+           equalImpl(ctx_a, aa->value_, ctx_b, ab->value_);
+  }
+  case IRNodeType::Loop: {
+    const Loop *la = static_cast<const Loop *>(a);
+    const Loop *lb = static_cast<const Loop *>(b);
+    return same_symbol(la->index_, lb->index_) &&
+           equalImpl(ctx_a, la->lower_bound_, ctx_b, lb->lower_bound_) &&
+           equalImpl(ctx_a, la->upper_bound_, ctx_b, lb->upper_bound_) &&
+           equalImpl(ctx_a, la->step_, ctx_b, lb->step_) &&
+           equalVectors(ctx_a, la->body_, ctx_b, lb->body_);
+  }
+  case IRNodeType::Block:
+    return equalVectors(ctx_a, static_cast<const Block *>(a)->body_, ctx_b,
+                        static_cast<const Block *>(b)->body_);
+  case IRNodeType::RecursiveNest: {
+    const RecursiveNest *ra = static_cast<const RecursiveNest *>(a);
+    const RecursiveNest *rb = static_cast<const RecursiveNest *>(b);
+    return ra->base_sizes_ == rb->base_sizes_ &&
+           equalImpl(ctx_a, ra->band_, ctx_b, rb->band_);
+  }
+  case IRNodeType::CurveNest: {
+    const CurveNest *ca = static_cast<const CurveNest *>(a);
+    const CurveNest *cb = static_cast<const CurveNest *>(b);
+    return ca->curve_ == cb->curve_ &&
+           equalImpl(ctx_a, ca->band_, ctx_b, cb->band_);
+  }
+  default:
+    return false;
+  }
+}
+
+} // namespace
+
+uint64_t structuralHash(const IRContext &ctx, const IRNode *node) {
+  if (!node) {
+    return 0x6e756c6cULL; // "null"
+  }
+  if (node->structural_hash_ == 0) {
+    uint64_t h = computeHash(ctx, node);
+    // 0 is reserved for "not computed"
+    node->structural_hash_ = h ? h : 1;
+  }
+  return node->structural_hash_;
+}
+
+bool structurallyEqual(const IRContext &ctx, const IRNode *a, const IRNode *b) {
+  return equalImpl(ctx, a, ctx, b);
+}
+
+bool structurallyEqual(const IRContext &ctx_a, const IRNode *a,
+                       const IRContext &ctx_b, const IRNode *b) {
+  return equalImpl(ctx_a, a, ctx_b, b);
+}
@@ -0,0 +1,35 @@
+#include "SymbolTable.hpp"
+
+Symbol SymbolTable::intern(const std::string &name) {
+  auto [it, inserted] =
+      ids_.try_emplace(name, static_cast<Symbol>(names_.size()));
+  if (inserted) {
+    names_.push_back(name);
+  }
+  return it->second;
+}
+
+Symbol SymbolTable::fresh(const std::string &hint) {
+  std::string candidate = hint;
+  // Resume from the last suffix handed out for this hint, so generating many
+  // fresh names from one hint stays linear.
+  unsigned &suffix = next_suffix_[hint];
+  while (ids_.count(candidate)) {
+    candidate = hint + std::to_string(++suffix);
+  }
+  return intern(candidate);
+}
+
+std::optional<Symbol> SymbolTable::lookup(const std::string &name) const {
+  auto it = ids_.find(name);
+  if (it == ids_.end()) {
+    return std::nullopt;
+  }
+  return it->second;
+}
+
+void SymbolTable::clear() {
+  names_.clear();
+  ids_.clear();
+  next_suffix_.clear();
+}
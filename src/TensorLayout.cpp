@@ -0,0 +1,110 @@
+#include "TensorLayout.hpp"
+#include <stdexcept>
+
+namespace {
+
+// Row-major strides for `extents`, with the innermost row padded to `pitch`.
+std::vector<size_t> rowMajorStrides(const std::vector<size_t> &extents,
+                                    size_t pitch, size_t &size) {
+  std::vector<size_t> strides(extents.size());
+  size_t current_stride = 1;
+  for (size_t d = extents.size(); d-- > 0;) {
+    strides[d] = current_stride;
+    size_t extent = extents[d];
+    if (d + 1 == extents.size() && pitch) {
+      if (pitch < extent) {
+        throw std::invalid_argument("pitch must not be smaller than the row");
+      }
+      extent = pitch;
+    }
+    current_stride *= extent;
+  }
+  size = current_stride;
+  return strides;
+}
+
+} // namespace
+
+TensorLayout TensorLayout::rowMajor(const std::vector<size_t> &extents,
+                                    size_t pitch, size_t alignment) {
+  TensorLayout layout;
+  layout.strides_ = rowMajorStrides(extents, pitch, layout.size_);
+  layout.alignment_ = alignment;
+  return layout;
+}
+
+TensorLayout TensorLayout::columnMajor(const std::vector<size_t> &extents,
+                                       size_t pitch, size_t alignment) {
+  // Column-major is row-major over the reversed dimensions.
+  std::vector<size_t> reversed(extents.rbegin(), extents.rend());
+  TensorLayout layout;
+  std::vector<size_t> strides = rowMajorStrides(reversed, pitch, layout.size_);
+  layout.strides_.assign(strides.rbegin(), strides.rend());
+  layout.alignment_ = alignment;
+  return layout;
+}
+
+TensorLayout TensorLayout::strided(const std::vector<size_t> &extents,
+                                   const std::vector<size_t> &strides,
+                                   size_t alignment) {
+  if (extents.size() != strides.size()) {
+    throw std::invalid_argument("strides must match the size of extents");
+  }
+  TensorLayout layout;
+  layout.strides_ = strides;
+  layout.alignment_ = alignment;
+  // The span is one past the offset of the last element.
+  layout.size_ = 1;
+  for (size_t d = 0; d < extents.size(); ++d) {
+    if (extents[d] == 0) {
+      layout.size_ = 0;
+      break;
+    }
+    layout.size_ += (extents[d] - 1) * strides[d];
+  }
+  return layout;
+}
+
+TensorLayout TensorLayout::blocked(const std::vector<size_t> &extents,
+                                   const std::vector<size_t> &block,
+                                   size_t alignment) {
+  if (extents.size() != block.size()) {
+    throw std::invalid_argument("block must match the size of extents");
+  }
+  std::vector<size_t> num_blocks(extents.size());
+  for (size_t d = 0; d < extents.size(); ++d) {
+    if (block[d] == 0) {
+      throw std::invalid_argument("block extents must be positive");
+    }
+    num_blocks[d] = (extents[d] + block[d] - 1) / block[d];
+  }
+
+  TensorLayout layout;
+  size_t block_size = 0;
+  layout.strides_ = rowMajorStrides(block, 0, block_size);
+  size_t total_blocks = 0;
+  layout.block_strides_ = rowMajorStrides(num_blocks, 0, total_blocks);
+  for (size_t &stride : layout.block_strides_) {
+    stride *= block_size;
+  }
+  layout.block_ = block;
+  layout.size_ = total_blocks * block_size;
+  layout.alignment_ = alignment;
+  return layout;
+}
+
+size_t TensorLayout::offset(const std::vector<size_t> &index) const {
+  if (index.size() != dims()) {
+    throw std::invalid_argument("index rank does not match the layout");
+  }
+  size_t off = 0;
+  for (size_t d = 0; d < index.size(); ++d) {
+    if (isBlocked()) {
+      off += (index[d] / block_[d]) * block_strides_[d] +
+             (index[d] % block_[d]) * strides_[d];
+    } else {
+      off += index[d] * strides_[d];
+    }
+  }
+  return off;
+}
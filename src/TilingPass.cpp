@@ -1,147 +1,784 @@
 #include "TilingPass.hpp"
 #include "IR.hpp"
+#include "IRContext.hpp"
+#include "AffineExpr.hpp"
+#include "CacheModel.hpp"
+#include "DependenceAnalysis.hpp"
+#include "IRVisitor.hpp"
+#include "LoopAnalysis.hpp"
+#include "StructuralHash.hpp"
+#include <algorithm>
+#include <functional>
 #include <iostream>
-#include <memory>
+
+namespace {
+
+// Rebuilds every node of a subtree (see IRRewriter::copyAll).
+class DeepCopier : public IRRewriter<DeepCopier> {
+public:
+  using IRRewriter::IRRewriter;
+  bool copyAll() const { return true; }
+};
+
+// Copies exactly one node; its children are shared with the original.
+class ShallowCopier : public IRVisitor<ShallowCopier, IRNode *> {
+public:
+  explicit ShallowCopier(IRContext &ctx) : ctx_(ctx) {}
+
+  IRNode *visitConst(const Const *n) { return ctx_.create<Const>(*n); }
+  IRNode *visitVariable(const Variable *n) {
+    return ctx_.create<Variable>(*n);
+  }
+  IRNode *visitMin(const Min *n) { return ctx_.create<Min>(*n); }
+  IRNode *visitDiv(const Div *n) { return ctx_.create<Div>(*n); }
+  IRNode *visitAdd(const Add *n) { return ctx_.create<Add>(*n); }
+  IRNode *visitMul(const Mul *n) { return ctx_.create<Mul>(*n); }
+  IRNode *visitLoad(const Load *n) { return ctx_.create<Load>(*n); }
+  IRNode *visitStore(const Store *n) { return ctx_.create<Store>(*n); }
+  IRNode *visitAssign(const Assign *n) { return ctx_.create<Assign>(*n); }
+  IRNode *visitLoop(const Loop *n) { return ctx_.create<Loop>(*n); }
+  IRNode *visitBlock(const Block *n) { return ctx_.create<Block>(*n); }
+  IRNode *visitRecursiveNest(const RecursiveNest *n) {
+    return ctx_.create<RecursiveNest>(*n);
+  }
+  IRNode *visitCurveNest(const CurveNest *n) {
+    return ctx_.create<CurveNest>(*n);
+  }
+
+  IRNode *visitNode(const IRNode *) {
+    std::cerr << "Error: Unknown IRNodeType encountered during shallow copy.\n";
+    return nullptr;
+  }
+
+private:
+  IRContext &ctx_;
+};
+
+// Tile size for `loop`: the block extent of a blocked tensor dimension that
+// the loop index addresses directly, so that every tile covers whole storage
+// blocks. Falls back to `fallback` for unblocked layouts.
+int64_t tileSizeFor(const Loop *loop, const AccessInfo &accesses,
+                    int64_t fallback) {
+  for (const MemoryAccess &access : accesses.accesses_) {
+    const TensorLayout &layout = access.tensor_->layout_;
+    if (!layout.isBlocked()) {
+      continue;
+    }
+    for (size_t d = 0; d < access.indices_->size(); ++d) {
+      const IRNode *index = (*access.indices_)[d];
+      if (index && index->getType() == IRNodeType::Variable &&
+          static_cast<const Variable *>(index)->symbol_ == loop->index_) {
+        return static_cast<int64_t>(layout.block_[d]);
+      }
+    }
+  }
+  return fallback;
+}
+
+// Empty if the outermost `depth` loops of the perfect band at `root` may be
+// tiled (and reordered), otherwise the reason they may not.
+std::string tilingLegality(const IRContext &ctx, const IRNode *root,
+                           size_t depth, const DependenceInfo &deps) {
+  std::vector<const Loop *> band;
+  const IRNode *node = root;
+  while (band.size() < depth && node && node->getType() == IRNodeType::Loop) {
+    const Loop *loop = static_cast<const Loop *>(node);
+    band.push_back(loop);
+    node = loop->body_.size() == 1 ? loop->body_.front() : nullptr;
+  }
+  if (deps.isTilable(band)) {
+    return "";
+  }
+  std::string names;
+  for (const Loop *loop : band) {
+    names += (names.empty() ? "'" : ", '") + ctx.name(loop->index_) + "'";
+  }
+  return "loops " + names +
+         " are not fully permutable; tiling would reverse a dependence";
+}
+
+// --- Full/partial tile splitting ---
+
+// A known fact `bound_ <= limit_` inside the full-tile path of a split loop.
+struct UpperBoundFact {
+  const IRNode *bound_;
+  const IRNode *limit_;
+};
+
+// If `loop` is a point loop of tile index `tile` with tile size `size`, i.e.
+// `for p = tile to min(tile + size, limit)`, returns `limit`.
+const IRNode *pointLoopLimit(const Loop *loop, Symbol tile, int64_t size) {
+  const IRNode *lb = loop->lower_bound_;
+  const IRNode *ub = loop->upper_bound_;
+  if (!lb || lb->getType() != IRNodeType::Variable ||
+      static_cast<const Variable *>(lb)->symbol_ != tile || !ub ||
+      ub->getType() != IRNodeType::Min) {
+    return nullptr;
+  }
+  const Min *min = static_cast<const Min *>(ub);
+  std::optional<AffineExpr> end = toAffine(min->operand_one_);
+  if (!end || *end != AffineExpr::symbol(tile) + AffineExpr(size) ||
+      mentions(min->operand_two_, tile)) {
+    return nullptr;
+  }
+  return min->operand_two_;
+}
+
+// Rewrites the point loops of one tile loop to their full-tile form,
+// `for p = tile to tile + size`, provided the tile loop's own upper bound
+// guarantees `tile + size <= limit` for full tiles.
+class FullTileRewriter : public IRRewriter<FullTileRewriter> {
+public:
+  FullTileRewriter(IRContext &ctx, const Loop *tile_loop, int64_t size,
+                   const std::vector<UpperBoundFact> &facts)
+      : IRRewriter(ctx), tile_loop_(tile_loop), size_(size), facts_(facts) {}
+
+  IRNode *visitLoop(const Loop *loop) {
+    const IRNode *limit = pointLoopLimit(loop, tile_loop_->index_, size_);
+    if (!limit || !bounded(limit)) {
+      return IRRewriter::visitLoop(loop);
+    }
+    const Min *min = static_cast<const Min *>(loop->upper_bound_);
+    facts_out_.push_back({min->operand_one_, limit});
+    Loop *full = ctx_.create<Loop>(loop->index_, loop->lower_bound_,
+                                   min->operand_one_, loop->step_);
+    rewriteAll(loop->body_, full->body_);
+    return full;
+  }
+
+  // Expressions contain no loops.
+  IRNode *visitAssign(const Assign *node) { return self(node); }
+
+  // Facts established by the rewritten point loops: tile + size <= limit.
+  std::vector<UpperBoundFact> facts_out_;
+
+private:
+  // True if the tile loop's upper bound is known to be <= limit.
+  bool bounded(const IRNode *limit) const {
+    const IRNode *ub = tile_loop_->upper_bound_;
+    if (structurallyEqual(ctx_, ub, limit)) {
+      return true;
+    }
+    if (ub && ub->getType() == IRNodeType::Min) {
+      const Min *min = static_cast<const Min *>(ub);
+      if (structurallyEqual(ctx_, min->operand_one_, limit) ||
+          structurallyEqual(ctx_, min->operand_two_, limit)) {
+        return true;
+      }
+    }
+    for (const UpperBoundFact &fact : facts_) {
+      if (structurallyEqual(ctx_, ub, fact.bound_) &&
+          structurallyEqual(ctx_, limit, fact.limit_)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  const Loop *tile_loop_;
+  int64_t size_;
+  const std::vector<UpperBoundFact> &facts_;
+};
+
+class FullTileSplitter {
+public:
+  explicit FullTileSplitter(IRContext &ctx) : ctx_(ctx) {}
+
+  // Returns the statements replacing `node` (just `node` if nothing split).
+  std::vector<IRNode *> split(IRNode *node) {
+    if (node && node->getType() == IRNodeType::Block) {
+      std::vector<IRNode *> out;
+      for (IRNode *child : static_cast<Block *>(node)->body_) {
+        std::vector<IRNode *> parts = split(child);
+        out.insert(out.end(), parts.begin(), parts.end());
+      }
+      return out;
+    }
+    if (!node || node->getType() != IRNodeType::Loop) {
+      return {node};
+    }
+    Loop *loop = static_cast<Loop *>(node);
+
+    std::optional<AffineExpr> step = toAffine(loop->step_);
+    if (step && step->isConstant() && step->constant() > 1) {
+      FullTileRewriter rewriter(ctx_, loop, step->constant(), facts_);
+      std::vector<IRNode *> full_body;
+      for (IRNode *child : loop->body_) {
+        full_body.push_back(rewriter.rewrite(child));
+      }
+      if (!rewriter.facts_out_.empty()) {
+        return splitTileLoop(loop, step->constant(), full_body,
+                             rewriter.facts_out_);
+      }
+    }
+
+    std::vector<IRNode *> body = splitAll(loop->body_);
+    if (body == loop->body_) {
+      return {loop};
+    }
+    Loop *copy = static_cast<Loop *>(shallowCopy(ctx_, loop));
+    copy->body_ = std::move(body);
+    return {copy};
+  }
+
+private:
+  std::vector<IRNode *> splitAll(const std::vector<IRNode *> &stmts) {
+    std::vector<IRNode *> out;
+    for (IRNode *stmt : stmts) {
+      std::vector<IRNode *> parts = split(stmt);
+      out.insert(out.end(), parts.begin(), parts.end());
+    }
+    return out;
+  }
+
+  // for t = lb to ub step S  ->  for t = lb to E step S   (full tiles)
+  //                              for t = E to ub step S    (remainder)
+  // with E = lb + (ub - lb) / S * S. The remainder runs at most once.
+  std::vector<IRNode *>
+  splitTileLoop(Loop *loop, int64_t size,
+                const std::vector<IRNode *> &full_body,
+                const std::vector<UpperBoundFact> &facts) {
+    IRNode *lb = loop->lower_bound_;
+    IRNode *ub = loop->upper_bound_;
+    std::optional<AffineExpr> lb_affine = toAffine(lb);
+    std::optional<AffineExpr> ub_affine = toAffine(ub);
+    IRNode *end = alignedEnd(ctx_, lb, ub, size);
+
+    // Drop a part that is known to be empty (e.g. constant bounds).
+    std::optional<AffineExpr> end_affine = toAffine(end);
+    if (end_affine && lb_affine && *end_affine == *lb_affine) {
+      return {loop};
+    }
+    const bool has_rest =
+        !(end_affine && ub_affine && *end_affine == *ub_affine);
+
+    // Inner tile loops of the full path may rely on the new facts.
+    const size_t saved = facts_.size();
+    facts_.insert(facts_.end(), facts.begin(), facts.end());
+    Loop *full = ctx_.create<Loop>(loop->index_, lb, end, loop->step_);
+    full->body_ = splitAll(full_body);
+    facts_.resize(saved);
+
+    if (!has_rest) {
+      return {full};
+    }
+    Loop *rest = ctx_.create<Loop>(loop->index_, end, ub, loop->step_);
+    rest->body_ = loop->body_;
+    return {full, rest};
+  }
+
+  IRContext &ctx_;
+  std::vector<UpperBoundFact> facts_;
+};
+
+} // namespace
 
 /**
- * @brief Helper function to deep copy a vector of IRNode unique pointers.
- * @param original_nodes The vector to copy from.
- * @return A new vector containing deep copies of the original nodes.
+ * @brief Performs a deep copy of the given IRNode and its entire subtree.
+ *
+ * @param ctx The context that will own the copied nodes.
+ * @param nd A pointer to the IRNode to copy. Can be nullptr.
+ * @return A pointer to the newly created, identical IRNode subtree.
  */
-std::vector<std::unique_ptr<IRNode>>
-deepCopyVector(const std::vector<std::unique_ptr<IRNode>> &original_nodes) {
-  std::vector<std::unique_ptr<IRNode>> new_nodes;
-  new_nodes.reserve(original_nodes.size());
-  for (const auto &node : original_nodes) {
-    new_nodes.push_back(deepCopy(node.get()));
-  }
-  return new_nodes;
+IRNode *deepCopy(IRContext &ctx, const IRNode *nd) {
+  return DeepCopier(ctx).rewrite(nd);
 }
 
 /**
- * @brief Performs a deep copy of the given IRNode and its entire subtree.
+ * @brief Copies a single node, sharing all of its children with the original.
+ * This is the building block for persistent transforms, which rebuild only the
+ * spine from the root to the nodes they change.
  *
+ * @param ctx The context that will own the copy.
  * @param nd A pointer to the IRNode to copy. Can be nullptr.
- * @return A unique pointer to the newly created, identical IRNode subtree.
+ * @return A pointer to the new node.
  */
-std::unique_ptr<IRNode> deepCopy(const IRNode *nd) {
-  if (!nd) {
-    return nullptr;
+IRNode *shallowCopy(IRContext &ctx, const IRNode *nd) {
+  IRNode *copy = ShallowCopier(ctx).visit(nd);
+  // The copy is about to be edited, so it must not inherit the cached hash.
+  if (copy) {
+    copy->invalidateHash();
   }
+  return copy;
+}
 
-  // Use the virtual method getType() to determine the concrete class
-  // and then static_cast to access its members for copying.
-  switch (nd->getType()) {
-  case IRNodeType::Const: {
-    const Const *c = static_cast<const Const *>(nd);
-    return std::make_unique<Const>(c->value_, c->dtype_);
-  }
-  case IRNodeType::Variable: {
-    const Variable *v = static_cast<const Variable *>(nd);
-    return std::make_unique<Variable>(v->name_);
-  }
-  case IRNodeType::Min: {
-    const Min *m = static_cast<const Min *>(nd);
-    return std::make_unique<Min>(deepCopy(m->operand_one_.get()),
-                                 deepCopy(m->operand_two_.get()));
-  }
-  case IRNodeType::Add: {
-    const Add *a = static_cast<const Add *>(nd);
-    return std::make_unique<Add>(deepCopy(a->operand_one_.get()),
-                                 deepCopy(a->operand_two_.get()));
-  }
-  case IRNodeType::Mul: {
-    const Mul *m = static_cast<const Mul *>(nd);
-    return std::make_unique<Mul>(deepCopy(m->operand_one_.get()),
-                                 deepCopy(m->operand_two_.get()));
-  }
-  case IRNodeType::Load: {
-    const Load *l = static_cast<const Load *>(nd);
-    // The Tensor reference is shallow-copied
-    // The indices vector must be deep-copied
-    return std::make_unique<Load>(l->tensor_, deepCopyVector(l->indices_));
-  }
-  case IRNodeType::Store: {
-    const Store *s = static_cast<const Store *>(nd);
-    // The Tensor reference is shallow-copied
-    // The indices vector must be deep-copied
-    return std::make_unique<Store>(s->tensor_, deepCopyVector(s->indices_));
-  }
-  case IRNodeType::Assign: {
-    const Assign *a = static_cast<const Assign *>(nd);
-    return std::make_unique<Assign>(deepCopy(a->target_.get()),
-                                    deepCopy(a->value_.get()));
-  }
-  case IRNodeType::Loop: {
-    const Loop *l = static_cast<const Loop *>(nd);
-
-    // Deep copy all children unique pointers
-    auto new_lb = deepCopy(l->lower_bound_.get());
-    auto new_ub = deepCopy(l->upper_bound_.get());
-    auto new_step = deepCopy(l->step_.get());
-
-    // Create the new Loop node
-    auto new_loop = std::make_unique<Loop>(
-        l->index_, std::move(new_lb), std::move(new_ub), std::move(new_step));
-
-    // Deep copy the body vector and assign it to the new Loop node
-    new_loop->body_ = deepCopyVector(l->body_);
-
-    return new_loop;
-  }
-  default:
-    // This should ideally never be reached if all IRNodeType are handled
-    std::cerr << "Error: Unknown IRNodeType encountered during deep copy.\n";
-    return nullptr;
+/**
+ * @brief Tiles a perfect band at several levels (see TilingPass.hpp).
+ *
+ * The nest is built inside out: first the point loops, then the tile loops of
+ * each level from the finest to the coarsest. A loop's range at every level
+ * is [t, min(t + S, E)), where t and S are the index and size of the
+ * nearest enclosing level that tiles the same loop and E is the end of that
+ * level's own tile loop. E reduces to the original upper bound whenever
+ * every size divides the next coarser size of the same loop; otherwise it
+ * also ends at the coarser tile, so no iteration runs in two tiles.
+ *
+ * @param ctx The context that owns the input and will own the tiled IR
+ * @param root Pointer to the outermost loop of the band
+ * @param levels Tiling levels, coarsest first
+ * @param point_order Order of the point loops, outermost first (empty: band
+ * order)
+ * @return The tiled root, or the unchanged root and a diagnostic. Only loop
+ * headers (and CurveNests) are new; bounds and the innermost body are shared
+ * with the input.
+ */
+TilingResult tileBand(IRContext &ctx, IRNode *root,
+                      const std::vector<TileLevel> &levels,
+                      const std::vector<size_t> &point_order) {
+  TilingResult result;
+  result.root_ = root;
+  auto fail = [&result](std::string message) {
+    result.diagnostic_ = "tileBand: " + std::move(message);
+    return result;
+  };
+
+  if (!root || root->getType() != IRNodeType::Loop) {
+    return fail("root is not a loop");
+  }
+  size_t depth = point_order.size();
+  for (const TileLevel &level : levels) {
+    depth = std::max({depth, level.sizes_.size(), level.order_.size()});
   }
+  if (depth == 0) {
+    return fail("no tile sizes given");
+  }
+
+  // Collect the band: each loop must be the only statement of its parent.
+  std::vector<Loop *> band{static_cast<Loop *>(root)};
+  while (band.size() < depth) {
+    const Loop *outer = band.back();
+    if (outer->body_.size() != 1 || !outer->body_.front() ||
+        outer->body_.front()->getType() != IRNodeType::Loop) {
+      return fail("loop '" + ctx.name(outer->index_) +
+                  "' is not perfectly nested; the band has depth " +
+                  std::to_string(band.size()) + " but " +
+                  std::to_string(depth) + " loops are tiled");
+    }
+    band.push_back(static_cast<Loop *>(outer->body_.front()));
+  }
+
+  // Orders must be permutations of the band.
+  auto check_order = [depth](const std::vector<size_t> &order) {
+    std::vector<bool> seen(depth, false);
+    for (size_t d : order) {
+      if (d >= depth || seen[d]) {
+        return false;
+      }
+      seen[d] = true;
+    }
+    return order.empty() || order.size() == depth;
+  };
+  if (!check_order(point_order)) {
+    return fail("point loop order is not a permutation of the band");
+  }
+  for (const TileLevel &level : levels) {
+    if (!check_order(level.order_)) {
+      return fail("loop order of level '" + level.name_ +
+                  "' is not a permutation of the band");
+    }
+  }
+
+  auto size_of = [](const TileLevel &level, size_t d) -> int64_t {
+    return d < level.sizes_.size() ? level.sizes_[d] : 0;
+  };
+  for (const TileLevel &level : levels) {
+    size_t tiled = 0;
+    for (size_t d = 0; d < depth; ++d) {
+      tiled += size_of(level, d) > 1;
+    }
+    if (level.curve_ != CurveOrder::RowMajor && tiled < 2) {
+      return fail("level '" + level.name_ +
+                  "' needs two tile loops to visit along a curve");
+    }
+  }
+
+  for (size_t d = 0; d < depth; ++d) {
+    const Loop *loop = band[d];
+    const std::string &name = ctx.name(loop->index_);
+    // Tiling assumes a rectangular iteration space.
+    for (size_t outer = 0; outer < d; ++outer) {
+      Symbol index = band[outer]->index_;
+      if (mentions(loop->lower_bound_, index) ||
+          mentions(loop->upper_bound_, index) ||
+          mentions(loop->step_, index)) {
+        return fail("bounds of loop '" + name + "' depend on outer loop '" +
+                    ctx.name(index) + "'");
+      }
+    }
+    bool tiled = false;
+    for (const TileLevel &level : levels) {
+      if (size_of(level, d) < 0) {
+        return fail("negative tile size for loop '" + name + "'");
+      }
+      tiled |= size_of(level, d) > 1;
+    }
+    if (!tiled) {
+      continue;
+    }
+    std::optional<AffineExpr> step = toAffine(loop->step_);
+    if (!step || !step->isConstant() || step->constant() <= 0) {
+      return fail("loop '" + name + "' does not have a positive constant step");
+    }
+    for (const TileLevel &level : levels) {
+      int64_t size = size_of(level, d);
+      if (size > 1 && size % step->constant() != 0) {
+        return fail("tile size " + std::to_string(size) + " of loop '" +
+                    name + "' is not a multiple of its step");
+      }
+    }
+  }
+
+  // Per loop and level: the tile index and size (nullptr if untiled there).
+  struct Tile {
+    Symbol index = 0;
+    IRNode *var = nullptr;
+    IRNode *size = nullptr;
+  };
+  std::vector<std::vector<Tile>> tiles(levels.size(),
+                                       std::vector<Tile>(depth));
+  for (size_t l = 0; l < levels.size(); ++l) {
+    for (size_t d = 0; d < depth; ++d) {
+      int64_t size = size_of(levels[l], d);
+      if (size <= 1) {
+        continue;
+      }
+      // Tile indices are fresh symbols named after the point loops (i -> ii,
+      // or i_L2 for a named level), so they never collide with a name
+      // already used in the program.
+      const std::string &name = ctx.name(band[d]->index_);
+      Tile &tile = tiles[l][d];
+      tile.index = ctx.symbols().fresh(
+          levels[l].name_.empty() ? name + name : name + "_" + levels[l].name_);
+      tile.var = ctx.makeVariable(tile.index);
+      tile.size = ctx.makeConst(ConstValue(static_cast<int>(size)),
+                                DType::Int32);
+    }
+  }
+
+  // Nearest level above l that tiles loop d, or levels.size() if none.
+  auto enclosing = [&](size_t l, size_t d) {
+    for (size_t outer = l; outer-- > 0;) {
+      if (tiles[outer][d].var) {
+        return outer;
+      }
+    }
+    return levels.size();
+  };
+
+  // Range of loop d at level l (levels.size() means the point loops): it
+  // starts at the tile index t of the nearest enclosing level o that tiles
+  // d, and ends at t + S. If o's size S divides the size of the level p
+  // that encloses o, o's tiles never cross the end of a p tile and clipping
+  // to the end of p's tile loop suffices. Otherwise the last o tile of each
+  // p tile would reach into the next one, so the range is clipped to the end
+  // of o's tile loop, which stops at the p tile:
+  //
+  //   for i_L2 = 0 to N step 48
+  //     for i_L1 = i_L2 to MIN(i_L2 + 48, N) step 32
+  //       for i = i_L1 to MIN(i_L1 + 32, MIN(i_L2 + 48, N))
+  std::function<std::pair<IRNode *, IRNode *>(size_t, size_t)> range =
+      [&](size_t l, size_t d) -> std::pair<IRNode *, IRNode *> {
+    const size_t o = enclosing(l, d);
+    if (o == levels.size()) {
+      return {band[d]->lower_bound_, band[d]->upper_bound_};
+    }
+    const Tile &tile = tiles[o][d];
+    const size_t p = enclosing(o, d);
+    const bool divides = p != levels.size() &&
+                         size_of(levels[p], d) % size_of(levels[o], d) == 0;
+    IRNode *end = divides ? range(p, d).second : range(o, d).second;
+    return {tile.var, ctx.makeMin(ctx.makeAdd(tile.var, tile.size), end)};
+  };
+
+  auto band_order = [depth](const std::vector<size_t> &order) {
+    std::vector<size_t> out = order;
+    if (out.empty()) {
+      for (size_t d = 0; d < depth; ++d) {
+        out.push_back(d);
+      }
+    }
+    return out;
+  };
+
+  // Point loops, innermost first. The innermost takes over the original
+  // innermost body; every other one only gets its inner loop as body.
+  IRNode *inner = nullptr;
+  std::vector<size_t> order = band_order(point_order);
+  for (size_t p = depth; p-- > 0;) {
+    const size_t d = order[p];
+    auto [lb, ub] = range(levels.size(), d);
+    Loop *point = ctx.create<Loop>(band[d]->index_, lb, ub, band[d]->step_);
+    point->body_ = inner ? std::vector<IRNode *>{inner} : band.back()->body_;
+    inner = point;
+  }
+
+  // Tile loops of each level, finest level innermost.
+  for (size_t l = levels.size(); l-- > 0;) {
+    order = band_order(levels[l].order_);
+    for (size_t p = depth; p-- > 0;) {
+      const size_t d = order[p];
+      const Tile &tile = tiles[l][d];
+      if (!tile.var) {
+        continue;
+      }
+      auto [lb, ub] = range(l, d);
+      Loop *loop = ctx.create<Loop>(tile.index, lb, ub, tile.size);
+      loop->body_.push_back(inner);
+      inner = loop;
+    }
+    if (levels[l].curve_ != CurveOrder::RowMajor) {
+      inner = ctx.create<CurveNest>(inner, levels[l].curve_);
+    }
+  }
+
+  result.root_ = inner;
+  result.ok_ = true;
+  return result;
+}
+
+TilingResult tileBand(IRContext &ctx, IRNode *root,
+                      const std::vector<int64_t> &tile_sizes) {
+  return tileBand(ctx, root, {TileLevel{"", tile_sizes, {}}});
+}
+
+/**
+ * @brief Default tile sizes (see TilingPass.hpp).
+ *
+ * The cache-model search and the access analysis cost far more than tiling
+ * itself, so the result is memoized in the context per band and cache level.
+ * The memo key starts from the band's structural hash, which covers loop
+ * bounds, bodies and every tensor's extents and layout, i.e. everything the
+ * sizes depend on; a hit only counts if the stored band is structurally
+ * equal, so hash collisions cannot hand out another kernel's sizes.
+ *
+ * @param ctx The context owning the band
+ * @param root The outermost loop of the band
+ * @param depth Number of band loops to size
+ * @return One size per band loop (fewer if the band is shallower).
+ */
+std::vector<int64_t> defaultTileSizes(const IRContext &ctx, const IRNode *root,
+                                      size_t depth) {
+  const CacheTopology &host = CacheTopology::host();
+  const CacheLevel *l1 = host.level(1);
+  const CacheLevel &cache = l1 ? *l1 : host.levels_.front();
+
+  uint64_t key = structuralHash(ctx, root);
+  for (uint64_t part : {uint64_t{depth}, uint64_t{cache.size_},
+                        uint64_t{cache.line_size_},
+                        uint64_t{cache.associativity_}}) {
+    key = (key ^ part) * 0x100000001b3ULL;
+  }
+  for (const IRContext::MemoEntry *entry : ctx.memoized(key)) {
+    if (structurallyEqual(ctx, entry->subtree, root)) {
+      return entry->value;
+    }
+  }
+
+  std::vector<int64_t> model = selectTileSizes(ctx, root, depth, cache);
+
+  const AccessInfo accesses = AccessAnalysis::run(ctx, root);
+  std::vector<int64_t> sizes;
+  const IRNode *node = root;
+  while (sizes.size() < model.size() && node &&
+         node->getType() == IRNodeType::Loop) {
+    const Loop *loop = static_cast<const Loop *>(node);
+    sizes.push_back(tileSizeFor(loop, accesses, model[sizes.size()]));
+    node = loop->body_.size() == 1 ? loop->body_.front() : nullptr;
+  }
+  ctx.memoize(key, root, sizes);
+  return sizes;
+}
+
+/**
+ * @brief Cache-oblivious tiling (see TilingPass.hpp).
+ *
+ * Only the RecursiveNest is new; the band itself is shared with the input,
+ * since the base case runs it unchanged over narrowed bounds.
+ *
+ * @param ctx The context that owns the input and will own the result
+ * @param root Pointer to the outermost loop of the band
+ * @param base_sizes Base-case size per band loop, outermost first
+ * @return The RecursiveNest, or the unchanged root and a diagnostic.
+ */
+TilingResult recursiveTileBand(IRContext &ctx, IRNode *root,
+                               const std::vector<int64_t> &base_sizes) {
+  TilingResult result;
+  result.root_ = root;
+  auto fail = [&result](std::string message) {
+    result.diagnostic_ = "recursiveTileBand: " + std::move(message);
+    return result;
+  };
+
+  if (!root || root->getType() != IRNodeType::Loop) {
+    return fail("root is not a loop");
+  }
+  if (base_sizes.empty()) {
+    return fail("no base sizes given");
+  }
+  std::vector<const Loop *> band{static_cast<const Loop *>(root)};
+  while (band.size() < base_sizes.size()) {
+    const Loop *outer = band.back();
+    if (outer->body_.size() != 1 || !outer->body_.front() ||
+        outer->body_.front()->getType() != IRNodeType::Loop) {
+      return fail("loop '" + ctx.name(outer->index_) +
+                  "' is not perfectly nested; the band has depth " +
+                  std::to_string(band.size()) + " but " +
+                  std::to_string(base_sizes.size()) + " loops are tiled");
+    }
+    band.push_back(static_cast<const Loop *>(outer->body_.front()));
+  }
+
+  for (size_t d = 0; d < band.size(); ++d) {
+    const Loop *loop = band[d];
+    const std::string &name = ctx.name(loop->index_);
+    // The base case narrows every loop to a box of the iteration space.
+    for (size_t outer = 0; outer < d; ++outer) {
+      Symbol index = band[outer]->index_;
+      if (mentions(loop->lower_bound_, index) ||
+          mentions(loop->upper_bound_, index) ||
+          mentions(loop->step_, index)) {
+        return fail("bounds of loop '" + name + "' depend on outer loop '" +
+                    ctx.name(index) + "'");
+      }
+    }
+    std::optional<AffineExpr> step = toAffine(loop->step_);
+    if (!step || !step->isConstant() || step->constant() <= 0) {
+      return fail("loop '" + name + "' does not have a positive constant step");
+    }
+    if (base_sizes[d] <= 0 || base_sizes[d] % step->constant() != 0) {
+      return fail("base size " + std::to_string(base_sizes[d]) +
+                  " of loop '" + name +
+                  "' is not a positive multiple of its step");
+    }
+  }
+
+  result.root_ = ctx.create<RecursiveNest>(root, base_sizes);
+  result.ok_ = true;
+  return result;
 }
 
 /**
  * @brief Performs 2D loop tiling (i, j) -> (ii, jj, i, j) on a nested loop
- * * @param nd Pointer to the root IRNode (expected to be the outer loop)
- * @return A unique pointer to the newly created, tiled IR subtree
- * WARNING: PROGRAM WILL CRASH IF IR IS NOT STRUCTURED AS 2 NESTED LOOPS
+ *
+ * @param ctx The context that owns the input and will own the tiled IR
+ * @param nd Pointer to the root IRNode (expected to be the outer loop)
+ * @param mode Fixed tile sizes or recursive bisection
+ * @param curve Order of the fixed-size tiles
+ * @return A pointer to the newly created, tiled IR subtree. Only the two loop
+ * headers (or the RecursiveNest) are new; bounds and the loop body are shared
+ * with the input.
+ */
+IRNode *tilingPass(IRContext &ctx, IRNode *nd, TilingMode mode,
+                   CurveOrder curve) {
+  std::string illegal =
+      tilingLegality(ctx, nd, 2, DependenceAnalysis::run(ctx, nd));
+  if (!illegal.empty()) {
+    throw std::invalid_argument("tilingPass: " + illegal);
+  }
+  TilingResult tiled;
+  if (mode == TilingMode::Recursive) {
+    tiled =
+        recursiveTileBand(ctx, nd, {kRecursiveBaseSize, kRecursiveBaseSize});
+  } else {
+    std::vector<int64_t> sizes = defaultTileSizes(ctx, nd, 2);
+    if (curve != CurveOrder::RowMajor) {
+      // The model leaves loops that fit whole untiled, but a curve needs a
+      // tile loop on both sides.
+      sizes.resize(2, 0);
+      for (int64_t &size : sizes) {
+        if (size <= 1) {
+          size = kCurveTileSize;
+        }
+      }
+    }
+    tiled = tileBand(ctx, nd, {TileLevel{"", sizes, {}, curve}});
+  }
+  if (!tiled) {
+    throw std::invalid_argument(tiled.diagnostic_);
+  }
+  return tiled.root_;
+}
+
+/**
+ * @brief Index-set splitting of tiled loops (see TilingPass.hpp).
+ *
+ * Tile loops are split outermost first. Only the full-tile path is split
+ * further, so a band of n tiled loops produces n + 1 copies of the point
+ * nest: one fast path whose point loops all have constant trip counts, and
+ * one remainder per tiled loop.
+ *
+ * @param ctx The context that owns the input and will own the result
+ * @param root The root of the tiled IR
+ * @return The new root: the input itself if no tile loop was found, a Block
+ * if the root loop itself was split. The innermost bodies are shared.
  */
-std::unique_ptr<IRNode> tilingPass(IRNode *nd) {
-  Loop *og_loop_i = static_cast<Loop *>(nd);
-  Loop *og_loop_j = static_cast<Loop *>(og_loop_i->body_.front().get());
-
-  std::unique_ptr<IRNode> cpy = deepCopy(nd);
-
-  Loop *loop_i = static_cast<Loop *>(cpy.get());
-  Loop *loop_j = static_cast<Loop *>(loop_i->body_.front().get());
-
-  std::unique_ptr<IRNode> var_ii = std::make_unique<Variable>("ii");
-  std::unique_ptr<IRNode> var_jj = std::make_unique<Variable>("jj");
-  std::unique_ptr<IRNode> const_t =
-      std::make_unique<Const>(ConstValue(73), DType::Int32);
-
-  std::unique_ptr<IRNode> add_ii_t = std::make_unique<Add>(
-      std::move(deepCopy(var_ii.get())), std::move(deepCopy(const_t.get())));
-  std::unique_ptr<IRNode> add_jj_t = std::make_unique<Add>(
-      std::move(deepCopy(var_jj.get())), std::move(deepCopy(const_t.get())));
-
-  std::unique_ptr<IRNode> loop_i_upper = std::make_unique<Min>(
-      std::move(add_ii_t), std::move(deepCopy(og_loop_i->upper_bound_.get())));
-  std::unique_ptr<IRNode> loop_j_upper = std::make_unique<Min>(
-      std::move(add_jj_t), std::move(deepCopy(og_loop_j->upper_bound_.get())));
-
-  loop_i->lower_bound_ = std::move(deepCopy(var_ii.get()));
-  loop_j->lower_bound_ = std::move(deepCopy(var_jj.get()));
-  loop_i->upper_bound_ = std::move(loop_i_upper);
-  loop_j->upper_bound_ = std::move(loop_j_upper);
-
-  std::unique_ptr<IRNode> loop_jj = std::make_unique<Loop>(
-      "jj", std::move(deepCopy(og_loop_j->lower_bound_.get())),
-      std::move(deepCopy(og_loop_j->upper_bound_.get())),
-      std::move(deepCopy(const_t.get())));
-  std::unique_ptr<IRNode> loop_ii = std::make_unique<Loop>(
-      "ii", std::move(deepCopy(og_loop_i->lower_bound_.get())),
-      std::move(deepCopy(og_loop_i->upper_bound_.get())),
-      std::move(deepCopy(const_t.get())));
-
-  static_cast<Loop *>(loop_jj.get())->body_.push_back(std::move(cpy));
-  static_cast<Loop *>(loop_ii.get())->body_.push_back(std::move(loop_jj));
-
-  return loop_ii;
-}
\ No newline at end of file
+IRNode *splitFullTiles(IRContext &ctx, IRNode *root) {
+  std::vector<IRNode *> parts = FullTileSplitter(ctx).split(root);
+  if (parts.size() == 1) {
+    return parts.front();
+  }
+  return ctx.create<Block>(std::move(parts));
+}
+
+bool FullTileSplitPass::run(IRContext &ctx, IRNode *&root,
+                            AnalysisManager &) {
+  IRNode *split = splitFullTiles(ctx, root);
+  if (split == root) {
+    return false;
+  }
+  root = split;
+  return true;
+}
+
+bool LoopTilingPass::run(IRContext &ctx, IRNode *&root, AnalysisManager &am) {
+  std::vector<TileLevel> levels = levels_;
+  if (mode_ == TilingMode::Recursive) {
+    if (levels.size() > 1 || !point_order_.empty()) {
+      diagnostic_ = "tile: recursive tiling takes one set of base sizes";
+      return false;
+    }
+    std::vector<int64_t> sizes =
+        levels.empty() ? std::vector<int64_t>(2, kRecursiveBaseSize)
+                       : levels.front().sizes_;
+    std::string illegal = tilingLegality(ctx, root, sizes.size(),
+                                         am.get<DependenceAnalysis>(root));
+    if (!illegal.empty()) {
+      diagnostic_ = "tile: " + illegal;
+      return false;
+    }
+    TilingResult tiled = recursiveTileBand(ctx, root, sizes);
+    diagnostic_ = tiled.diagnostic_;
+    if (!tiled) {
+      return false;
+    }
+    root = tiled.root_;
+    return true;
+  }
+  if (levels.empty()) {
+    // Cheap rejection through the cached loop-nest shape.
+    const LoopNestInfo &nest = am.get<LoopNestAnalysis>(root);
+    if (nest.bands_.empty() || nest.bands_.front().outermost() != root ||
+        nest.bands_.front().depth() < 2) {
+      diagnostic_ = "tile: root does not start a band of depth 2";
+      return false;
+    }
+    levels.push_back({"", defaultTileSizes(ctx, root, 2), {}});
+  }
+  size_t depth = point_order_.size();
+  for (const TileLevel &level : levels) {
+    depth = std::max({depth, level.sizes_.size(), level.order_.size()});
+  }
+  std::string illegal =
+      tilingLegality(ctx, root, depth, am.get<DependenceAnalysis>(root));
+  if (!illegal.empty()) {
+    diagnostic_ = "tile: " + illegal;
+    return false;
+  }
+  TilingResult tiled = tileBand(ctx, root, levels, point_order_);
+  diagnostic_ = tiled.diagnostic_;
+  if (!tiled) {
+    return false;
+  }
+  root = tiled.root_;
+  return true;
+}
@@ -0,0 +1,367 @@
+#include "TypeInference.hpp"
+#include "IRVisitor.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+#include <set>
+
+namespace {
+
+int typeRank(DType dtype) {
+  switch (dtype) {
+  case DType::Int32:
+    return 0;
+  case DType::Int64:
+    return 1;
+  case DType::Float32:
+    return 2;
+  case DType::Float64:
+    return 3;
+  }
+  return 0;
+}
+
+// Collects the variables that are assignment targets.
+class LocalCollector : public RecursiveIRVisitor<LocalCollector> {
+public:
+  explicit LocalCollector(KernelTypes &types) : types_(types) {}
+
+  void visitAssign(const Assign *assign) {
+    if (assign->target_ &&
+        assign->target_->getType() == IRNodeType::Variable) {
+      Symbol sym = static_cast<const Variable *>(assign->target_)->symbol_;
+      if (!types_.localType(sym)) {
+        types_.locals_.emplace_back(sym, types_.index_type_);
+      }
+    }
+    RecursiveIRVisitor::visitAssign(assign);
+  }
+
+private:
+  KernelTypes &types_;
+};
+
+// Collects tensors, free symbols and the largest integer constant.
+class KernelScanner : public RecursiveIRVisitor<KernelScanner> {
+public:
+  explicit KernelScanner(KernelTypes &types) : types_(types) {}
+
+  void visitLoop(const Loop *loop) {
+    // Bounds are evaluated outside the loop's own scope.
+    visit(loop->lower_bound_);
+    visit(loop->upper_bound_);
+    visit(loop->step_);
+    bound_.push_back(loop->index_);
+    for (const IRNode *child : loop->body_) {
+      visit(child);
+    }
+    bound_.pop_back();
+  }
+
+  void visitVariable(const Variable *var) {
+    Symbol sym = var->symbol_;
+    if (std::find(bound_.begin(), bound_.end(), sym) == bound_.end() &&
+        !types_.localType(sym) &&
+        std::find(types_.params_.begin(), types_.params_.end(), sym) ==
+            types_.params_.end()) {
+      types_.params_.push_back(sym);
+    }
+  }
+
+  void visitConst(const Const *c) {
+    if (const int *v = std::get_if<int>(&c->value_)) {
+      max_const_ = std::max<uint64_t>(max_const_, std::llabs(*v));
+    } else if (const long long *v = std::get_if<long long>(&c->value_)) {
+      max_const_ = std::max<uint64_t>(max_const_, std::llabs(*v));
+    }
+  }
+
+  void visitLoad(const Load *load) {
+    use(load->tensor_);
+    RecursiveIRVisitor::visitLoad(load);
+  }
+
+  void visitStore(const Store *store) {
+    use(store->tensor_);
+    RecursiveIRVisitor::visitStore(store);
+  }
+
+  uint64_t maxConst() const { return max_const_; }
+
+private:
+  void use(const Tensor &t) {
+    if (std::find(types_.tensors_.begin(), types_.tensors_.end(), &t) ==
+        types_.tensors_.end()) {
+      types_.tensors_.push_back(&t);
+    }
+  }
+
+  KernelTypes &types_;
+  std::vector<Symbol> bound_;
+  uint64_t max_const_ = 0;
+};
+
+// Assigns a type to every value expression. Index expressions are not
+// recorded; KernelTypes::typeOf() reports index_type_ for them.
+class ValueTyper : public RecursiveIRVisitor<ValueTyper> {
+public:
+  explicit ValueTyper(KernelTypes &types) : types_(types) {}
+
+  void visitAssign(const Assign *assign) {
+    visit(assign->target_);
+    DType t = typeValue(assign->value_);
+    if (assign->target_ &&
+        assign->target_->getType() == IRNodeType::Variable) {
+      Symbol sym = static_cast<const Variable *>(assign->target_)->symbol_;
+      for (auto &[local, dtype] : types_.locals_) {
+        if (local == sym) {
+          // The first assignment decides; later ones can only widen.
+          dtype = assigned_.insert(sym).second ? t : promoteTypes(dtype, t);
+        }
+      }
+    }
+  }
+
+  // Loads inside index expressions (indirect accesses) are values too.
+  void visitLoad(const Load *load) {
+    types_.types_[load] = load->tensor_.dtype_;
+    RecursiveIRVisitor::visitLoad(load);
+  }
+
+private:
+  DType typeValue(const IRNode *node) {
+    if (!node) {
+      return types_.index_type_;
+    }
+    DType t = types_.index_type_;
+    switch (node->getType()) {
+    case IRNodeType::Const:
+      t = static_cast<const Const *>(node)->dtype_;
+      break;
+    case IRNodeType::Load:
+      visit(node); // Also types loads nested in the indices.
+      t = static_cast<const Load *>(node)->tensor_.dtype_;
+      break;
+    case IRNodeType::Variable:
+      t = types_.localType(static_cast<const Variable *>(node)->symbol_)
+              .value_or(types_.index_type_);
+      break;
+    case IRNodeType::Add:
+    case IRNodeType::Mul:
+    case IRNodeType::Min:
+    case IRNodeType::Div: {
+      // Add, Mul, Min and Div share the two-operand layout
+      const Add *b = static_cast<const Add *>(node);
+      t = promoteTypes(typeValue(b->operand_one_),
+                       typeValue(b->operand_two_));
+      break;
+    }
+    default:
+      break;
+    }
+    types_.types_[node] = t;
+    return t;
+  }
+
+  KernelTypes &types_;
+  std::set<Symbol> assigned_;
+};
+
+ConstValue castConst(const ConstValue &value, DType dtype) {
+  return std::visit(
+      [dtype](auto v) -> ConstValue {
+        switch (dtype) {
+        case DType::Int32:
+          return static_cast<int>(v);
+        case DType::Int64:
+          return static_cast<long long>(v);
+        case DType::Float32:
+          return static_cast<float>(v);
+        case DType::Float64:
+          return static_cast<double>(v);
+        }
+        return v;
+      },
+      value);
+}
+
+// Rebuilds constants whose dtype disagrees with the type expected at their
+// position.
+class ConstRetyper : public IRRewriter<ConstRetyper> {
+public:
+  ConstRetyper(IRContext &ctx, const KernelTypes &types)
+      : IRRewriter(ctx), types_(types), expected_(types.index_type_) {}
+
+  IRNode *visitConst(const Const *c) {
+    if (c->dtype_ == expected_) {
+      return self(c);
+    }
+    return ctx_.makeConst(castConst(c->value_, expected_), expected_);
+  }
+
+  IRNode *visitAdd(const Add *node) {
+    Scope scope(*this, expectedFor(node));
+    return IRRewriter::visitAdd(node);
+  }
+
+  IRNode *visitMul(const Mul *node) {
+    Scope scope(*this, expectedFor(node));
+    return IRRewriter::visitMul(node);
+  }
+
+  IRNode *visitMin(const Min *node) {
+    Scope scope(*this, expectedFor(node));
+    return IRRewriter::visitMin(node);
+  }
+
+  IRNode *visitDiv(const Div *node) {
+    Scope scope(*this, expectedFor(node));
+    return IRRewriter::visitDiv(node);
+  }
+
+  IRNode *visitLoad(const Load *node) {
+    Scope scope(*this, types_.index_type_, /*in_value=*/false);
+    return IRRewriter::visitLoad(node);
+  }
+
+  IRNode *visitStore(const Store *node) {
+    Scope scope(*this, types_.index_type_, /*in_value=*/false);
+    return IRRewriter::visitStore(node);
+  }
+
+  IRNode *visitLoop(const Loop *node) {
+    Scope scope(*this, types_.index_type_, /*in_value=*/false);
+    return IRRewriter::visitLoop(node);
+  }
+
+  IRNode *visitAssign(const Assign *node) {
+    IRNode *target = rewrite(node->target_);
+    IRNode *value = nullptr;
+    {
+      // A constant assigned directly takes the target's type.
+      DType type = types_.typeOf(node->value_);
+      if (node->target_ && node->target_->getType() == IRNodeType::Store) {
+        type = static_cast<const Store *>(node->target_)->tensor_.dtype_;
+      } else if (node->target_ &&
+                 node->target_->getType() == IRNodeType::Variable) {
+        type = types_.localType(
+                        static_cast<const Variable *>(node->target_)->symbol_)
+                   .value_or(type);
+      }
+      Scope scope(*this, type, /*in_value=*/true);
+      value = rewrite(node->value_);
+    }
+    if (unchanged(node->target_, target) && unchanged(node->value_, value)) {
+      return self(node);
+    }
+    return ctx_.create<Assign>(target, value);
+  }
+
+private:
+  // Saves and restores the expected type around a subtree.
+  struct Scope {
+    Scope(ConstRetyper &r, DType expected, bool in_value)
+        : r_(r), saved_(r.expected_), saved_in_value_(r.in_value_) {
+      r_.expected_ = expected;
+      r_.in_value_ = in_value;
+    }
+    Scope(ConstRetyper &r, DType expected)
+        : Scope(r, expected, r.in_value_) {}
+    ~Scope() {
+      r_.expected_ = saved_;
+      r_.in_value_ = saved_in_value_;
+    }
+    ConstRetyper &r_;
+    DType saved_;
+    bool saved_in_value_;
+  };
+
+  // Operands of a value expression take its promoted type; index
+  // arithmetic always uses the index type.
+  DType expectedFor(const IRNode *node) const {
+    return in_value_ ? types_.typeOf(node) : types_.index_type_;
+  }
+
+  const KernelTypes &types_;
+  DType expected_;
+  bool in_value_ = false;
+};
+
+} // namespace
+
+DType promoteTypes(DType a, DType b) {
+  return typeRank(a) >= typeRank(b) ? a : b;
+}
+
+const char *cTypeName(DType dtype) {
+  switch (dtype) {
+  case DType::Float32:
+    return "float";
+  case DType::Float64:
+    return "double";
+  case DType::Int32:
+    return "int";
+  case DType::Int64:
+    return "long long";
+  }
+  return "void";
+}
+
+size_t dtypeSize(DType dtype) {
+  switch (dtype) {
+  case DType::Float32:
+  case DType::Int32:
+    return 4;
+  case DType::Float64:
+  case DType::Int64:
+    return 8;
+  }
+  return 0;
+}
+
+/**
+ * @brief Infers the index type, the value type of every value expression, the
+ * accessed tensors, the free size parameters and the scalar locals of a
+ * kernel.
+ *
+ * @param root The kernel root (usually the outermost Loop).
+ * @return The inferred types.
+ */
+KernelTypes TypeAnalysis::run(const IRContext &ctx, const IRNode *root) {
+  KernelTypes types;
+  LocalCollector(types).visit(root);
+  KernelScanner scanner(types);
+  scanner.visit(root);
+
+  // Sorted by name, so every schedule of a program has the same signature.
+  std::sort(types.tensors_.begin(), types.tensors_.end(),
+            [](const Tensor *a, const Tensor *b) { return a->name < b->name; });
+  std::sort(types.params_.begin(), types.params_.end(),
+            [&ctx](Symbol a, Symbol b) { return ctx.name(a) < ctx.name(b); });
+
+  // Every offset is below the largest layout size; tile bounds such as
+  // ii + T may overshoot it by at most the largest constant.
+  uint64_t max_index = scanner.maxConst();
+  for (const Tensor *t : types.tensors_) {
+    max_index = std::max<uint64_t>(max_index, t->layout_.size_ +
+                                                  scanner.maxConst());
+  }
+  types.index_type_ =
+      max_index <= static_cast<uint64_t>(std::numeric_limits<int>::max())
+          ? DType::Int32
+          : DType::Int64;
+
+  ValueTyper(types).visit(root);
+  return types;
+}
+
+bool TypeInferencePass::run(IRContext &ctx, IRNode *&root,
+                            AnalysisManager &am) {
+  const KernelTypes &types = am.get<TypeAnalysis>(root);
+  IRNode *result = ConstRetyper(ctx, types).rewrite(root);
+  if (result == root) {
+    return false;
+  }
+  root = result;
+  return true;
+}
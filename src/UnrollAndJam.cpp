@@ -0,0 +1,184 @@
+#include "UnrollAndJam.hpp"
+#include "AffineExpr.hpp"
+#include "IRVisitor.hpp"
+#include "TilingPass.hpp"
+#include <numeric>
+
+namespace {
+
+class UnrollJammer {
+public:
+  UnrollJammer(IRContext &ctx, unsigned factor, const DependenceInfo &deps,
+               const std::string &index)
+      : ctx_(ctx), factor_(factor), deps_(deps), index_(index) {}
+
+  // Returns the statements replacing `node` (just `node` if nothing changed).
+  std::vector<IRNode *> rewrite(IRNode *node) {
+    if (node && node->getType() == IRNodeType::Block) {
+      std::vector<IRNode *> out = rewriteAll(static_cast<Block *>(node)->body_);
+      if (out == static_cast<Block *>(node)->body_) {
+        return {node};
+      }
+      return out;
+    }
+    if (!node || node->getType() != IRNodeType::Loop) {
+      return {node};
+    }
+    Loop *loop = static_cast<Loop *>(node);
+
+    std::vector<Loop *> chain;
+    if (selected(loop, chain)) {
+      std::vector<IRNode *> parts = jam(loop, chain);
+      if (!parts.empty()) {
+        return parts;
+      }
+    }
+
+    std::vector<IRNode *> body = rewriteAll(loop->body_);
+    if (body == loop->body_) {
+      return {loop};
+    }
+    Loop *copy = static_cast<Loop *>(shallowCopy(ctx_, loop));
+    copy->body_ = std::move(body);
+    return {copy};
+  }
+
+private:
+  std::vector<IRNode *> rewriteAll(const std::vector<IRNode *> &stmts) {
+    std::vector<IRNode *> out;
+    for (IRNode *stmt : stmts) {
+      std::vector<IRNode *> parts = rewrite(stmt);
+      out.insert(out.end(), parts.begin(), parts.end());
+    }
+    return out;
+  }
+
+  // Collects the perfect chain of loops below `loop` into `chain` and
+  // reports whether `loop` is one to unroll. The innermost loop's body must
+  // be straight-line code.
+  bool selected(const Loop *loop, std::vector<Loop *> &chain) const {
+    const Loop *inner = loop;
+    while (inner->body_.size() == 1 && inner->body_.front() &&
+           inner->body_.front()->getType() == IRNodeType::Loop) {
+      inner = static_cast<const Loop *>(inner->body_.front());
+      chain.push_back(const_cast<Loop *>(inner));
+    }
+    for (const IRNode *stmt : inner->body_) {
+      if (!stmt || stmt->getType() == IRNodeType::Loop ||
+          stmt->getType() == IRNodeType::Block) {
+        return false;
+      }
+    }
+    return index_.empty() ? chain.size() == 1
+                          : ctx_.name(loop->index_) == index_;
+  }
+
+  std::vector<IRNode *> jam(Loop *loop, const std::vector<Loop *> &chain) {
+    std::optional<AffineExpr> step = toAffine(loop->step_);
+    if (!step || !step->isConstant() || step->constant() <= 0) {
+      return {};
+    }
+    for (const Loop *inner : chain) {
+      if (mentions(inner->lower_bound_, loop->index_) ||
+          mentions(inner->upper_bound_, loop->index_) ||
+          mentions(inner->step_, loop->index_)) {
+        return {};
+      }
+    }
+    // Jamming runs `loop` innermost within each iteration of the chain.
+    std::vector<const Loop *> band{loop};
+    band.insert(band.end(), chain.begin(), chain.end());
+    std::vector<size_t> order(band.size());
+    std::iota(order.begin(), order.end(), 1);
+    order.back() = 0;
+    if (!deps_.isLegalOrder(band, order)) {
+      return {};
+    }
+
+    const int64_t s = step->constant();
+    const int64_t chunk = s * static_cast<int64_t>(factor_);
+    IRNode *lb = loop->lower_bound_;
+    IRNode *ub = loop->upper_bound_;
+    IRNode *end = alignedEnd(ctx_, lb, ub, chunk);
+    std::optional<AffineExpr> lb_affine = toAffine(lb);
+    std::optional<AffineExpr> ub_affine = toAffine(ub);
+    std::optional<AffineExpr> end_affine = toAffine(end);
+    if (end_affine && lb_affine && *end_affine == *lb_affine) {
+      return {}; // Fewer iterations than the factor.
+    }
+
+    // The copies of the innermost body, one per unrolled iteration.
+    const Loop *innermost = chain.empty() ? loop : chain.back();
+    std::vector<IRNode *> body;
+    IRNode *index = ctx_.makeVariable(loop->index_);
+    for (unsigned c = 0; c < factor_; ++c) {
+      IRNode *shifted =
+          simplifyExpr(ctx_, ctx_.makeAdd(index, intConst(c * s)));
+      for (IRNode *stmt : innermost->body_) {
+        body.push_back(c == 0 ? stmt
+                              : substituteIndex(ctx_, stmt, loop->index_,
+                                                shifted));
+      }
+    }
+    for (size_t p = chain.size(); p-- > 0;) {
+      Loop *copy = static_cast<Loop *>(shallowCopy(ctx_, chain[p]));
+      copy->body_ = std::move(body);
+      body = {copy};
+    }
+
+    Loop *main = ctx_.create<Loop>(loop->index_, lb, end, intConst(chunk));
+    main->body_ = std::move(body);
+    if (end_affine && ub_affine && *end_affine == *ub_affine) {
+      return {main};
+    }
+    Loop *epilogue = ctx_.create<Loop>(loop->index_, end, ub, loop->step_);
+    epilogue->body_ = loop->body_;
+    return {main, epilogue};
+  }
+
+  IRNode *intConst(int64_t value) {
+    return ctx_.makeConst(ConstValue(static_cast<int>(value)), DType::Int32);
+  }
+
+  IRContext &ctx_;
+  unsigned factor_;
+  const DependenceInfo &deps_;
+  const std::string &index_;
+};
+
+} // namespace
+
+/**
+ * @brief Unroll-and-jam (see UnrollAndJam.hpp).
+ *
+ * @param ctx The context that owns the input and will own the result
+ * @param root The root of the IR, typically after tiling
+ * @param factor Number of iterations of each selected loop run together
+ * @param deps Dependences of `root`, used to reject illegal jams
+ * @param index Index of the loops to unroll (empty: the outer loop of every
+ * innermost 2D nest)
+ * @return The new root; the epilogues share their bodies with the input.
+ */
+IRNode *unrollAndJam(IRContext &ctx, IRNode *root, unsigned factor,
+                     const DependenceInfo &deps, const std::string &index) {
+  if (factor < 2) {
+    return root;
+  }
+  std::vector<IRNode *> parts =
+      UnrollJammer(ctx, factor, deps, index).rewrite(root);
+  if (parts.size() == 1) {
+    return parts.front();
+  }
+  return ctx.create<Block>(std::move(parts));
+}
+
+bool UnrollAndJamPass::run(IRContext &ctx, IRNode *&root,
+                           AnalysisManager &am) {
+  IRNode *result = unrollAndJam(ctx, root, factor_,
+                                am.get<DependenceAnalysis>(root), index_);
+  if (result == root) {
+    return false;
+  }
+  root = result;
+  return true;
+}
@@ -1,7 +1,15 @@
 #include "CodeGenerator.hpp" // Now including the code generation functions
+#include "DependenceAnalysis.hpp"
 #include "IR.hpp"
 #include "IRBuilder.hpp"
+#include "IRContext.hpp"
+#include "LoopInterchange.hpp"
+#include "OperandPacking.hpp"
+#include "PassManager.hpp"
+#include "RegisterBlocking.hpp"
+#include "ScalarReplacement.hpp"
 #include "TilingPass.hpp"
+#include "TypeInference.hpp"
 #include <iostream>
 
 int main() {
@@ -15,18 +23,24 @@ int main() {
 
   std::cout << "--- TEST 2: Matrix Addition (2D, Simple Add) ---" << std::endl;
   try {
-    std::unique_ptr<IRNode> add_ir_root = buildUntiledIR(add_program);
-    std::unique_ptr<IRNode> tiled_add_ir_root = tilingPass(add_ir_root.get());
+    IRContext ctx(/*hash_consing=*/true);
+    IRNode *add_ir_root = buildUntiledIR(ctx, add_program);
+
+    PassManager pm(ctx);
+    pm.add<LoopInterchangePass>();
+    pm.add<LoopTilingPass>();
+    pm.add<TypeInferencePass>();
+    IRNode *tiled_add_ir_root = pm.run(add_ir_root);
 
     std::cout << "----------------------UNTILED-----------------------"
               << std::endl;
-    printIR(add_ir_root.get(), 0);
+    printIR(ctx, add_ir_root, 0);
     std::cout << "----------------------END UNTILED-----------------------"
               << std::endl;
 
     std::cout << "----------------------TILED-----------------------"
               << std::endl;
-    printIR(tiled_add_ir_root.get(), 0);
+    printIR(ctx, tiled_add_ir_root, 0);
     std::cout << "----------------------END TILED-----------------------"
               << std::endl;
 
@@ -36,7 +50,8 @@ int main() {
     // NOTE: We need a new function or modified logic in CodeGenerator
     // to handle the naming for 'add' vs 'transpose'.
     // For now, we'll call a single function and rely on the IR structure.
-    generateCodeFiles(add_ir_root.get(), tiled_add_ir_root.get(), "add");
+    generateCodeFiles(ctx, add_ir_root, tiled_add_ir_root, "add");
+    pm.printReport(std::cerr);
 
   } catch (const std::exception &e) {
     std::cerr << "IR Construction Error (Add): " << e.what() << std::endl;
@@ -52,32 +67,41 @@ int main() {
         BODY: C[i, j] = A[j, i]
     )";
 
-  std::unique_ptr<IRNode> transpose_ir_root = nullptr;
-  std::unique_ptr<IRNode> tiled_transpose_ir_root = nullptr;
+  IRContext transpose_ctx(/*hash_consing=*/true);
+  IRNode *transpose_ir_root = nullptr;
+  IRNode *tiled_transpose_ir_root = nullptr;
 
   std::cout << "--- TEST 3: Matrix Transposition (2D, Index Swap) ---"
             << std::endl;
   try {
-    transpose_ir_root = buildUntiledIR(transpose_program);
-    tiled_transpose_ir_root = tilingPass(transpose_ir_root.get());
+    transpose_ir_root = buildUntiledIR(transpose_ctx, transpose_program);
+
+    PassManager pm(transpose_ctx);
+    pm.add<LoopInterchangePass>();
+    // Transpose reads A by column; recursive halving keeps both the C and
+    // the A block cache-resident at every level without picking a tile size.
+    pm.add<LoopTilingPass>(TilingMode::Recursive);
+    pm.add<TypeInferencePass>();
+    tiled_transpose_ir_root = pm.run(transpose_ir_root);
 
     std::cout << "----------------------UNTILED-----------------------"
               << std::endl;
-    printIR(transpose_ir_root.get(), 0);
+    printIR(transpose_ctx, transpose_ir_root, 0);
     std::cout << "----------------------END UNTILED-----------------------"
               << std::endl;
 
     std::cout << "----------------------TILED-----------------------"
               << std::endl;
-    printIR(tiled_transpose_ir_root.get(), 0);
+    printIR(transpose_ctx, tiled_transpose_ir_root, 0);
     std::cout << "----------------------END TILED-----------------------"
               << std::endl;
 
     // Call the code generator with the Transpose IRs (Untiled and Tiled)
     std::cout
         << "\n>>> Calling generateCodeFiles for Transpose Kernels... <<<\n";
-    generateCodeFiles(transpose_ir_root.get(), tiled_transpose_ir_root.get(),
+    generateCodeFiles(transpose_ctx, transpose_ir_root, tiled_transpose_ir_root,
                       "transpose");
+    pm.printReport(std::cerr);
 
   } catch (const std::exception &e) {
     std::cerr << "IR Construction Error (Transpose): " << e.what() << std::endl;
@@ -86,5 +110,95 @@ int main() {
             << std::endl
             << std::endl;
 
+  // ----------------------------------------------------------------------------
+
+  // --- TEST 4: Matrix Multiplication (3D Loop Nest, Per-Loop Tile Sizes) ---
+  const std::string matmul_program = R"(
+        LOOPS: i=0:N:1, j=0:M:1, k=0:K:1
+        BODY: C[i, j] = C[i, j] + (A[i, k] * B[k, j])
+    )";
+
+  std::cout << "--- TEST 4: Matrix Multiplication (3D, Tiled 32x32x32) ---"
+            << std::endl;
+  try {
+    IRContext matmul_ctx(/*hash_consing=*/true);
+    IRNode *matmul_ir_root = buildUntiledIR(matmul_ctx, matmul_program);
+
+    PassManager pm(matmul_ctx);
+    // i, k, j: the innermost loop walks C and B with unit stride.
+    pm.add<LoopInterchangePass>();
+    LoopTilingPass &tiling =
+        pm.add<LoopTilingPass>(std::vector<int64_t>{32, 32, 32});
+    // Copy each A and B tile into a panel buffer for the 4x4 block below.
+    pm.add<OperandPackingPass>(4, 4);
+    // Full tiles get constant trip counts; boundary tiles keep the min.
+    pm.add<FullTileSplitPass>();
+    // A 4x4 block of C stays in registers across each k tile.
+    pm.add<RegisterBlockingPass>(4, 4);
+    // Block remainders still update C[i, j] on every k; keep it in a local.
+    pm.add<ScalarReplacementPass>();
+    pm.add<TypeInferencePass>();
+    IRNode *tiled_matmul_ir_root = pm.run(matmul_ir_root);
+    if (!tiling.diagnostic().empty()) {
+      std::cerr << tiling.diagnostic() << std::endl;
+    }
+
+    // The accumulation into C[i, j] is carried by k only, so the band stays
+    // fully permutable and tiling is legal.
+    std::cout << "Dependences:" << std::endl;
+    pm.analyses()
+        .get<DependenceAnalysis>(matmul_ir_root)
+        .print(matmul_ctx, std::cout);
+
+    std::cout << "----------------------TILED-----------------------"
+              << std::endl;
+    printIR(matmul_ctx, tiled_matmul_ir_root, 0);
+    std::cout << "----------------------END TILED-----------------------"
+              << std::endl;
+
+    std::cout << "\n>>> Calling generateCodeFiles for Matmul Kernels... <<<\n";
+    generateCodeFiles(matmul_ctx, matmul_ir_root, tiled_matmul_ir_root,
+                      "matmul");
+    pm.printReport(std::cerr);
+
+  } catch (const std::exception &e) {
+    std::cerr << "IR Construction Error (Matmul): " << e.what() << std::endl;
+  }
+  std::cout << "-----------------------------------------------------"
+            << std::endl
+            << std::endl;
+
+  // ----------------------------------------------------------------------------
+
+  // --- TEST 5: Matrix Addition, Tiles Visited Along a Hilbert Curve ---
+  std::cout << "--- TEST 5: Matrix Addition (2D, Hilbert Tile Order) ---"
+            << std::endl;
+  try {
+    IRContext curve_ctx(/*hash_consing=*/true);
+    IRNode *curve_ir_root = buildUntiledIR(curve_ctx, add_program);
+    // Consecutive tiles share an edge, so the C and A rows of one tile are
+    // still cached when the next one starts.
+    IRNode *tiled_curve_ir_root = tilingPass(
+        curve_ctx, curve_ir_root, TilingMode::Fixed, CurveOrder::Hilbert);
+
+    std::cout << "----------------------TILED-----------------------"
+              << std::endl;
+    printIR(curve_ctx, tiled_curve_ir_root, 0);
+    std::cout << "----------------------END TILED-----------------------"
+              << std::endl;
+
+    std::cout << "\n>>> Calling generateCodeFiles for Hilbert Addition "
+                 "Kernels... <<<\n";
+    generateCodeFiles(curve_ctx, curve_ir_root, tiled_curve_ir_root,
+                      "add_hilbert");
+
+  } catch (const std::exception &e) {
+    std::cerr << "IR Construction Error (Hilbert Add): " << e.what()
+              << std::endl;
+  }
+  std::cout << "-----------------------------------------------------"
+            << std::endl
+            << std::endl;
+
   return 0;
 }
\ No newline at end of file